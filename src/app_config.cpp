@@ -0,0 +1,152 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <stdlib.h>
+#endif
+
+#include "app_config.h"
+#include "led_animator.h"
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const ModeEntry MODES[] = {
+    { "Off",        "off",        LED_MODE_OFF,           -1             },
+    { "Steady",     "steady",     LED_MODE_ON,            -1             },
+    { "Fast Blink", "fast-blink", LED_MODE_BLINK_FAST,    -1             },
+    { "Slow Blink", "slow-blink", LED_MODE_BLINK_SLOW,    -1             },
+    { "Charging",   "charging",   LED_MODE_BLINK_CHARGE,  -1             },
+    { "Fade Slow",  "fade-slow",  LED_MODE_FADE_SLOW,     -1             },
+    { "Fade Fast",  "fade-fast",  LED_MODE_FADE_FAST,     -1             },
+    { "Fade In",    "fade-in",    LED_MODE_RAMP_TO_LEVEL, -1             },
+    { "Breathe",    "breathe",    LED_MODE_ON,            ANIM_BREATHE   },
+    { "Heartbeat",  "heartbeat",  LED_MODE_ON,            ANIM_HEARTBEAT },
+    { "Custom",     "custom",     LED_MODE_ON,            ANIM_CUSTOM    },
+};
+const int MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+const int DEFAULT_MODE = 1;
+const int FIRST_HOST_MODE = 8;
+
+const char *DEFAULT_ANIM_CURVE = "0:0,0.5:1";
+
+static_assert(CONFIG_MAX_DEVICES == XBOX_MAX_DEVICES, "known device list must fit the session");
+
+int FindMode(const char *name)
+{
+    for (int i = 0; i < MODE_COUNT; i++) {
+        if (strcmp(MODES[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Next to the executable on Windows, the XDG config dir elsewhere. */
+void DefaultConfigPath(char *out, size_t out_len)
+{
+#ifdef _WIN32
+    char exe[MAX_PATH];
+    DWORD n = GetModuleFileNameA(nullptr, exe, MAX_PATH);
+    while (n > 0 && exe[n - 1] != '\\' && exe[n - 1] != '/')
+        n--;
+    exe[n] = '\0';
+    snprintf(out, out_len, "%sxbledctl.ini", exe);
+#else
+    const char *xdg = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg)
+        snprintf(out, out_len, "%s/xbledctl.ini", xdg);
+    else
+        snprintf(out, out_len, "%s/.config/xbledctl.ini", home ? home : ".");
+#endif
+}
+
+bool SaveConfig(const char *path, const AppConfig &cfg)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f,
+        "[xbledctl]\nbrightness=%d\nmode=%d\nstart_with_windows=%d\nminimize_to_tray=%d\nlive_preview=%d\n"
+        "anim_period_ms=%d\nanim_rate_hz=%d\nanim_realtime=%d\nanim_curve=%s\n",
+        cfg.brightness, cfg.mode_idx, cfg.start_with_windows ? 1 : 0, cfg.minimize_to_tray ? 1 : 0,
+        cfg.live_preview ? 1 : 0, cfg.anim_period_ms, cfg.anim_rate_hz, cfg.anim_realtime ? 1 : 0,
+        cfg.anim_curve);
+    if (cfg.known_device_count > 0) {
+        fprintf(f, "devices=");
+        for (int i = 0; i < cfg.known_device_count; i++)
+            fprintf(f, "%s%llx", i ? "," : "", (unsigned long long)cfg.known_devices[i]);
+        fprintf(f, "\n");
+    }
+    return fclose(f) == 0;
+}
+
+/* A devices= line holds up to 16 hex digits and a comma per ID. */
+static const size_t CONFIG_LINE_MAX = 512;
+static_assert(CONFIG_LINE_MAX >= sizeof("devices=") + CONFIG_MAX_DEVICES * 17 + 1,
+              "devices= line does not fit");
+
+void LoadConfig(const char *path, AppConfig *cfg)
+{
+    cfg->brightness = LED_BRIGHTNESS_DEFAULT;
+    cfg->mode_idx = DEFAULT_MODE;
+    cfg->start_with_windows = true;
+    cfg->minimize_to_tray = true;
+    cfg->live_preview = true;
+    cfg->anim_period_ms = 3000;
+    cfg->anim_rate_hz = 50;
+    cfg->anim_realtime = false;
+    snprintf(cfg->anim_curve, sizeof(cfg->anim_curve), "%s", DEFAULT_ANIM_CURVE);
+    cfg->known_device_count = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[CONFIG_LINE_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        int val;
+        if (sscanf(line, "brightness=%d", &val) == 1)
+            cfg->brightness = (val >= 0 && val <= LED_BRIGHTNESS_MAX) ? val : LED_BRIGHTNESS_DEFAULT;
+        else if (sscanf(line, "mode=%d", &val) == 1)
+            cfg->mode_idx = (val >= 0 && val < MODE_COUNT) ? val : DEFAULT_MODE;
+        else if (sscanf(line, "start_with_windows=%d", &val) == 1)
+            cfg->start_with_windows = (val != 0);
+        else if (sscanf(line, "minimize_to_tray=%d", &val) == 1)
+            cfg->minimize_to_tray = (val != 0);
+        else if (sscanf(line, "live_preview=%d", &val) == 1)
+            cfg->live_preview = (val != 0);
+        else if (sscanf(line, "anim_period_ms=%d", &val) == 1)
+            cfg->anim_period_ms = (val >= 100 && val <= 60000) ? val : 3000;
+        else if (sscanf(line, "anim_rate_hz=%d", &val) == 1)
+            cfg->anim_rate_hz = (val >= 1 && val <= (int)LedAnimator::MAX_RATE_HZ) ? val : 50;
+        else if (sscanf(line, "anim_realtime=%d", &val) == 1)
+            cfg->anim_realtime = (val != 0);
+        else if (strncmp(line, "anim_curve=", 11) == 0) {
+            std::vector<AnimKey> keys;
+            const char *curve = line + 11;
+            line[strcspn(line, "\r\n")] = '\0';
+            size_t len = strlen(curve);
+            /* A curve cut short would still parse, just not as saved. */
+            if (len < sizeof(cfg->anim_curve) && LedAnimator::ParseCurve(curve, &keys))
+                memcpy(cfg->anim_curve, curve, len + 1);
+        } else if (strncmp(line, "devices=", 8) == 0) {
+            const char *p = line + 8;
+            cfg->known_device_count = 0;
+            while (*p && cfg->known_device_count < CONFIG_MAX_DEVICES) {
+                char *end = nullptr;
+                unsigned long long id = strtoull(p, &end, 16);
+                if (end == p || !id)
+                    break;
+                cfg->known_devices[cfg->known_device_count++] = id;
+                p = *end == ',' ? end + 1 : end;
+            }
+        }
+    }
+    fclose(f);
+}
@@ -0,0 +1,47 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define CONFIG_MAX_DEVICES 16
+
+/* Settings persisted in xbledctl.ini, shared by the app and the CLI. */
+struct AppConfig {
+    int  brightness;
+    int  mode_idx;
+    bool start_with_windows;
+    bool minimize_to_tray;
+    bool live_preview;
+    int  anim_period_ms;
+    int  anim_rate_hz;
+    bool anim_realtime;
+    char anim_curve[128];
+
+    /* Controllers that last took a write; the app writes to them straight
+       away on the next start instead of enumerating first. */
+    uint64_t known_devices[CONFIG_MAX_DEVICES];
+    int      known_device_count;
+};
+
+struct ModeEntry {
+    const char *label;
+    const char *name;    /* command-line spelling */
+    uint8_t     value;
+    int         anim;
+};
+
+/* Entries with anim >= 0 are animated by the host; the firmware only ever
+   sees steady writes for them. */
+extern const ModeEntry MODES[];
+extern const int       MODE_COUNT;
+extern const int       DEFAULT_MODE;   /* Steady */
+extern const int       FIRST_HOST_MODE;
+extern const char     *DEFAULT_ANIM_CURVE;
+
+int  FindMode(const char *name);
+void DefaultConfigPath(char *out, size_t out_len);
+void LoadConfig(const char *path, AppConfig *cfg);
+bool SaveConfig(const char *path, const AppConfig &cfg);
+
+#endif /* APP_CONFIG_H */
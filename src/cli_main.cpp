@@ -0,0 +1,344 @@
+/*
+ * xbledctl-cli: sets the LED from a script without any UI.
+ *
+ *   xbledctl-cli --set-brightness 20 --mode steady --device all
+ *
+ * --device takes "all" or a comma-separated list of IDs from --list; the
+ * writes to all targets are in flight together. Listed IDs are waited for
+ * until they have all announced, for at most --wait ms (default 500).
+ * With neither --set-brightness nor --mode the saved settings are applied.
+ * --status prints the table published by a running xbledctl or xbledctld
+ * from shared memory, without touching the controller.
+ * Exit status: 0 applied, 1 a write failed, 2 bad arguments, 3 no controller.
+ */
+#include "app_config.h"
+#include "gip_loopback.h"
+#include "status_page.h"
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const int EXIT_WRITE_FAILED = 1;
+static const int EXIT_USAGE        = 2;
+static const int EXIT_NO_DEVICE    = 3;
+
+static const uint32_t ALL_DEVICES_WAIT_MS = 200;   /* at most, for all / --list */
+static const uint32_t ANNOUNCE_IDLE_MS    = 25;
+static const uint32_t REQUESTED_WAIT_MS   = 500;
+
+static XboxController g_ctrl;
+static bool           g_quiet = false;
+
+struct CliOptions {
+    int                       brightness = -1;
+    int                       mode_idx = -1;
+    bool                      all = false;
+    std::vector<uint64_t>     device_ids;
+    bool                      list = false;
+    bool                      status = false;
+    bool                      save = false;
+    bool                      simulate = false;
+    int                       wait_ms = -1;
+    const char               *config = nullptr;
+    const char               *sysfs = nullptr;
+    std::vector<const char *> raw;
+};
+
+static void Usage()
+{
+    fprintf(stderr,
+        "usage: xbledctl-cli [--set-brightness 0-%d] [--mode NAME] [--device all|ID[,ID...]]\n"
+        "                    [--list] [--status] [--save] [--config PATH] [--wait MS] [--quiet]\n"
+        "                    [--simulate]"
+#ifdef __linux__
+        " [--sysfs ROOT] [--raw DEVICE]..."
+#endif
+        "\nmodes:", LED_BRIGHTNESS_MAX);
+    for (int i = 0; i < FIRST_HOST_MODE; i++)
+        fprintf(stderr, " %s", MODES[i].name);
+    fprintf(stderr, "\n");
+}
+
+static void Phase(const char *name, uint64_t start)
+{
+    if (!g_quiet)
+        fprintf(stderr, "%-8s %8.3f ms\n", name, (xbox_time_ns() - start) / 1e6);
+}
+
+static bool ParseArgs(int argc, char **argv, CliOptions *o)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        char *end = nullptr;
+
+        if (strcmp(a, "--list") == 0) {
+            o->list = true;
+        } else if (strcmp(a, "--status") == 0) {
+            o->status = true;
+        } else if (strcmp(a, "--save") == 0) {
+            o->save = true;
+        } else if (strcmp(a, "--quiet") == 0) {
+            g_quiet = true;
+        } else if (strcmp(a, "--simulate") == 0) {
+            o->simulate = true;
+        } else if (!v) {
+            fprintf(stderr, "%s needs a value\n", a);
+            return false;
+        } else if (strcmp(a, "--set-brightness") == 0) {
+            o->brightness = (int)strtol(v, &end, 10);
+            if (*end || o->brightness < 0 || o->brightness > LED_BRIGHTNESS_MAX) {
+                fprintf(stderr, "brightness must be 0-%d\n", LED_BRIGHTNESS_MAX);
+                return false;
+            }
+            i++;
+        } else if (strcmp(a, "--mode") == 0) {
+            o->mode_idx = FindMode(v);
+            if (o->mode_idx < 0) {
+                fprintf(stderr, "unknown mode '%s'\n", v);
+                return false;
+            }
+            if (MODES[o->mode_idx].anim >= 0) {
+                fprintf(stderr, "'%s' is animated by the app and cannot be set from the CLI\n", v);
+                return false;
+            }
+            i++;
+        } else if (strcmp(a, "--device") == 0) {
+            if (strcmp(v, "all") == 0) {
+                o->all = true;
+            } else {
+                for (const char *p = v; ; p = end + 1) {
+                    uint64_t id = strtoull(p, &end, 16);
+                    if (end == p || (*end && *end != ',') || !id ||
+                        o->device_ids.size() == XBOX_MAX_DEVICES) {
+                        fprintf(stderr, "device must be 'all' or hex ids from --list\n");
+                        return false;
+                    }
+                    o->device_ids.push_back(id);
+                    if (!*end)
+                        break;
+                }
+            }
+            i++;
+        } else if (strcmp(a, "--wait") == 0) {
+            o->wait_ms = (int)strtol(v, &end, 10);
+            if (*end || o->wait_ms < 0) {
+                fprintf(stderr, "wait must be a number of milliseconds\n");
+                return false;
+            }
+            i++;
+        } else if (strcmp(a, "--config") == 0) {
+            o->config = v;
+            i++;
+#ifdef __linux__
+        } else if (strcmp(a, "--sysfs") == 0) {
+            o->sysfs = v;
+            i++;
+        } else if (strcmp(a, "--raw") == 0) {
+            o->raw.push_back(v);
+            i++;
+#endif
+        } else {
+            fprintf(stderr, "unknown option %s\n", a);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int PrintStatus()
+{
+    std::string err;
+    StatusReader reader;
+    StatusSnapshot snap;
+    if (!reader.Open(StatusPageDefaultName().c_str(), &err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return EXIT_NO_DEVICE;
+    }
+    if (!reader.Snapshot(&snap) || !snap.writer_pid) {
+        fprintf(stderr, "no running publisher\n");
+        return EXIT_NO_DEVICE;
+    }
+    for (uint32_t i = 0; i < snap.count; i++) {
+        const StatusDevice &d = snap.devices[i];
+        printf("%016llx %s mode=0x%02x brightness=%u\n", (unsigned long long)d.device_id,
+               d.present ? "present" : "absent", d.mode, d.brightness);
+    }
+    return 0;
+}
+
+static bool AllPresent(const std::vector<uint64_t> &ids)
+{
+    for (uint64_t id : ids) {
+        bool present = false;
+        for (int i = 0; i < g_ctrl.device_count && !present; i++)
+            present = g_ctrl.devices[i].device_id == id && g_ctrl.devices[i].state == XBOX_DEV_PRESENT;
+        if (!present)
+            return false;
+    }
+    return true;
+}
+
+static bool InitController(const CliOptions &o)
+{
+    if (o.simulate) {
+        GipTransport t = gip_loopback_create(nullptr);
+        gip_loopback_add_device(t, 0x7E5700000001ull);
+        xbox_init_with_transport(&g_ctrl, t);
+        return true;
+    }
+#ifdef __linux__
+    if (!o.raw.empty()) {
+        std::vector<int> fds;
+        for (const char *path : o.raw) {
+            int fd = open(path, O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                fprintf(stderr, "cannot open %s\n", path);
+                for (int opened : fds)
+                    close(opened);
+                return false;
+            }
+            fds.push_back(fd);
+        }
+        xbox_init_with_transport(&g_ctrl, gip_transport_uring_create(fds.data(), (int)fds.size()));
+        return true;
+    }
+    if (o.sysfs) {
+        xbox_init_with_transport(&g_ctrl, gip_transport_xone_create(o.sysfs));
+        return true;
+    }
+#endif
+    xbox_init(&g_ctrl);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t t_start = xbox_time_ns();
+    CliOptions o;
+    if (!ParseArgs(argc, argv, &o)) {
+        Usage();
+        return EXIT_USAGE;
+    }
+    if (o.status)
+        return PrintStatus();
+
+    uint64_t t = xbox_time_ns();
+    char config_path[512];
+    if (o.config)
+        snprintf(config_path, sizeof(config_path), "%s", o.config);
+    else
+        DefaultConfigPath(config_path, sizeof(config_path));
+    AppConfig cfg;
+    LoadConfig(config_path, &cfg);
+    if (o.brightness >= 0)
+        cfg.brightness = o.brightness;
+    if (o.mode_idx >= 0)
+        cfg.mode_idx = o.mode_idx;
+    if (MODES[cfg.mode_idx].anim >= 0) {
+        fprintf(stderr, "saved mode '%s' is animated by the app; pass --mode\n", MODES[cfg.mode_idx].name);
+        return EXIT_USAGE;
+    }
+    Phase("config", t);
+
+    t = xbox_time_ns();
+    if (!InitController(o))
+        return EXIT_USAGE;
+    bool found = xbox_open(&g_ctrl);
+    int wait_ms = o.wait_ms >= 0 ? o.wait_ms : (o.all || o.list) ? (int)ALL_DEVICES_WAIT_MS : 0;
+    if (found && !o.device_ids.empty()) {
+        /* xbox_open() is back on the first announce; the ones asked for
+           may still be on their way. */
+        uint32_t limit_ms = o.wait_ms >= 0 ? (uint32_t)o.wait_ms : REQUESTED_WAIT_MS;
+        uint64_t until = xbox_time_ns() + (uint64_t)limit_ms * 1000000ull;
+        for (uint64_t now = xbox_time_ns(); now < until && g_ctrl.open && !AllPresent(o.device_ids);
+             now = xbox_time_ns())
+            xbox_pump(&g_ctrl, (uint32_t)((until - now + 999999) / 1000000));
+    } else if (found && wait_ms > 0) {
+        /* More controllers may still be announcing after the first. They
+           answer the reenumerate in a burst, so unless --wait asks for the
+           full time, stop once no new one has come for ANNOUNCE_IDLE_MS. */
+        const uint64_t idle_ns = (uint64_t)ANNOUNCE_IDLE_MS * 1000000ull;
+        bool full = o.wait_ms >= 0;
+        uint64_t until = xbox_time_ns() + (uint64_t)wait_ms * 1000000ull;
+        uint64_t quiet_at = xbox_time_ns() + idle_ns;
+        for (uint64_t now = xbox_time_ns(); now < until && (full || now < quiet_at) && g_ctrl.open;
+             now = xbox_time_ns()) {
+            uint64_t stop = full || until < quiet_at ? until : quiet_at;
+            if (xbox_pump(&g_ctrl, (uint32_t)((stop - now + 999999) / 1000000)) & XBOX_EVENT_ARRIVED)
+                quiet_at = xbox_time_ns() + idle_ns;
+        }
+    }
+    Phase("open", t);
+    if (!found) {
+        fprintf(stderr, "%s\n", g_ctrl.error);
+        xbox_cleanup(&g_ctrl);
+        return EXIT_NO_DEVICE;
+    }
+
+    std::vector<uint64_t> targets;
+    for (int i = 0; i < g_ctrl.device_count; i++) {
+        const XboxDevice &dev = g_ctrl.devices[i];
+        if (dev.state != XBOX_DEV_PRESENT)
+            continue;
+        if (o.list)
+            printf("%016llx\n", (unsigned long long)dev.device_id);
+        if (o.all || (o.device_ids.empty() && targets.empty()))
+            targets.push_back(dev.device_id);
+    }
+    if (o.list) {
+        xbox_cleanup(&g_ctrl);
+        return 0;
+    }
+    if (!o.device_ids.empty())
+        targets = o.device_ids;
+
+    int present = 0;
+    bool was_present[XBOX_MAX_DEVICES] = {};
+    for (size_t i = 0; i < targets.size(); i++) {
+        for (int j = 0; j < g_ctrl.device_count && !was_present[i]; j++) {
+            was_present[i] = g_ctrl.devices[j].device_id == targets[i] &&
+                             g_ctrl.devices[j].state == XBOX_DEV_PRESENT;
+        }
+        present += was_present[i];
+    }
+    if (!present) {
+        fprintf(stderr, "no controller found\n");
+        xbox_cleanup(&g_ctrl);
+        return EXIT_NO_DEVICE;
+    }
+
+    t = xbox_time_ns();
+    int bright = cfg.mode_idx == 0 ? 0 : cfg.brightness;
+    XboxLedResult results[XBOX_MAX_DEVICES];
+    int n = xbox_set_led_many(&g_ctrl, targets.data(), (int)targets.size(),
+                              MODES[cfg.mode_idx].value, (uint8_t)bright, results);
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        if (results[i].ok)
+            continue;
+        fprintf(stderr, "%016llx: %s\n", (unsigned long long)results[i].device_id,
+                was_present[i] ? g_ctrl.error : "not found");
+        failed++;
+    }
+    Phase("apply", t);
+
+    if (!failed && o.save && !SaveConfig(config_path, cfg))
+        fprintf(stderr, "cannot write %s\n", config_path);
+
+    xbox_cleanup(&g_ctrl);
+    Phase("total", t_start);
+    return failed ? EXIT_WRITE_FAILED : 0;
+}
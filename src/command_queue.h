@@ -0,0 +1,229 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "mpsc_ring.h"
+
+enum WorkerCmd { CMD_NONE, CMD_REFRESH, CMD_APPLY, CMD_RESCAN, CMD_HOTPLUG };
+
+struct WorkerCommand {
+    WorkerCmd type;
+    uint64_t  device_id;
+    int       mode_idx;
+    int       brightness;
+    bool      preview;
+    bool      automatic;   /* issued by the app (auto-apply), not the user */
+    uint64_t  t_ns;        /* CMD_HOTPLUG: when Windows reported a controller interface, or 0 */
+};
+
+struct CommandQueueStats {
+    uint64_t posted;
+    uint64_t coalesced;
+    uint64_t executed;
+    uint64_t dropped;      /* previews that found the ring full, commands that found the overflow full */
+    uint64_t overflowed;   /* commands that found the ring full and went to the overflow list */
+};
+
+/*
+ * Latest-wins channel between the UI, tray and animation threads and the
+ * worker. Producers push into a bounded lock-free ring; the worker drains
+ * the ring into its own pending list, where at most one command is kept
+ * per (device, type, preview). Posting again replaces the older one and
+ * moves it to the back, so the worker always ends on the newest requested
+ * state and a stream of previews never swallows a committed apply.
+ *
+ * Post never waits. When the ring is full a preview is dropped (a newer
+ * one will follow) and any other command goes to a short overflow list
+ * under a lock, coalesced the same way. Until the worker has taken that
+ * list, later commands follow it there so they stay in order; a command
+ * that finds it full with no older one to replace is refused.
+ */
+class CommandQueue {
+public:
+    static constexpr size_t RING_SIZE = 256;
+    static constexpr size_t OVERFLOW_SIZE = 64;
+
+    explicit CommandQueue(std::function<void()> wake) : m_wake(std::move(wake)) {}
+
+    /* Any thread. Returns false if the command was dropped or the queue
+       is closed. */
+    bool Post(const WorkerCommand &cmd)
+    {
+        if (m_closed.load(std::memory_order_acquire))
+            return false;
+        m_posted.fetch_add(1, std::memory_order_relaxed);
+        if (!cmd.preview)
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        bool queued = !m_has_overflow.load(std::memory_order_acquire) && m_ring.Push(cmd);
+        if (!queued) {
+            if (cmd.preview) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (!Overflow(cmd)) {
+                m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        Wake();
+        return true;
+    }
+
+    /* Worker side. The queue counts as busy from the post of a non-preview
+       command until the Take() after it. */
+    bool Take(WorkerCommand *out)
+    {
+        if (m_running_committed) {
+            m_running_committed = false;
+            m_outstanding.fetch_sub(1, std::memory_order_release);
+        }
+        Drain();
+        if (m_pending.empty())
+            return false;
+        *out = m_pending.front();
+        m_pending.erase(m_pending.begin());
+        m_running_committed = !out->preview;
+        m_executed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /* Worker side. */
+    bool HasPending(WorkerCmd type, uint64_t device_id)
+    {
+        Drain();
+        for (const WorkerCommand &c : m_pending) {
+            if (c.type == type && c.device_id == device_id)
+                return true;
+        }
+        return false;
+    }
+
+    bool Busy() const
+    {
+        return m_outstanding.load(std::memory_order_acquire) > 0;
+    }
+
+    /* Cooperative shutdown: later posts are refused and the worker sees
+       Closed() the next time it wakes. */
+    void Close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_wake_armed.store(false, std::memory_order_relaxed);
+        Wake();
+    }
+
+    bool Closed() const
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+    CommandQueueStats Stats() const
+    {
+        CommandQueueStats s;
+        s.posted = m_posted.load(std::memory_order_relaxed);
+        s.coalesced = m_coalesced.load(std::memory_order_relaxed);
+        s.executed = m_executed.load(std::memory_order_relaxed);
+        s.dropped = m_dropped.load(std::memory_order_relaxed);
+        s.overflowed = m_overflowed.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    /* One wake per drain: the worker re-arms before it looks at the ring,
+       so a push it does not see is always followed by a wake. */
+    void Wake()
+    {
+        if (m_wake && !m_wake_armed.exchange(true, std::memory_order_acq_rel))
+            m_wake();
+    }
+
+    static bool SameSlot(const WorkerCommand &a, const WorkerCommand &b)
+    {
+        return a.type == b.type && a.device_id == b.device_id && a.preview == b.preview;
+    }
+
+    /* Producer side, ring full. */
+    bool Overflow(const WorkerCommand &cmd)
+    {
+        std::lock_guard<std::mutex> lock(m_overflow_mu);
+        m_overflowed.fetch_add(1, std::memory_order_relaxed);
+        for (WorkerCommand &o : m_overflow) {
+            if (SameSlot(o, cmd)) {
+                o = cmd;
+                m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        if (m_overflow.size() >= OVERFLOW_SIZE)
+            return false;
+        m_overflow.push_back(cmd);
+        m_has_overflow.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void Merge(const WorkerCommand &cmd)
+    {
+        for (size_t i = 0; i < m_pending.size(); i++) {
+            if (SameSlot(m_pending[i], cmd)) {
+                if (!cmd.preview)
+                    m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+                m_pending.erase(m_pending.begin() + (std::ptrdiff_t)i);
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+        m_pending.push_back(cmd);
+    }
+
+    /* Everything in the ring was posted before whatever is in the
+       overflow list, so the ring goes first. */
+    void Drain()
+    {
+        m_wake_armed.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        WorkerCommand cmd;
+        while (m_ring.Pop(&cmd))
+            Merge(cmd);
+        if (!m_has_overflow.load(std::memory_order_acquire))
+            return;
+        std::vector<WorkerCommand> overflow;
+        {
+            std::lock_guard<std::mutex> lock(m_overflow_mu);
+            overflow.swap(m_overflow);
+            m_has_overflow.store(false, std::memory_order_release);
+        }
+        for (const WorkerCommand &o : overflow)
+            Merge(o);
+    }
+
+    std::function<void()>             m_wake;
+    MpscRing<WorkerCommand, RING_SIZE> m_ring;
+
+    alignas(64) std::atomic<uint32_t> m_outstanding{0};
+    std::atomic<bool>                 m_closed{false};
+    std::atomic<bool>                 m_wake_armed{false};
+    std::atomic<uint64_t>             m_posted{0};
+    std::atomic<uint64_t>             m_dropped{0};
+    std::atomic<uint64_t>             m_overflowed{0};
+
+    /* Only touched when the ring is full. */
+    std::mutex                        m_overflow_mu;
+    std::vector<WorkerCommand>        m_overflow;
+    std::atomic<bool>                 m_has_overflow{false};
+
+    /* Worker thread only, apart from the counters. */
+    alignas(64) std::vector<WorkerCommand> m_pending;
+    bool                              m_running_committed = false;
+    std::atomic<uint64_t>             m_coalesced{0};
+    std::atomic<uint64_t>             m_executed{0};
+};
+
+#endif /* COMMAND_QUEUE_H */
@@ -0,0 +1,304 @@
+/*
+ * xbledctld: keeps the controller session open and serves LED requests
+ * from other processes over a local socket or named pipe, using the
+ * protocol in ipc_protocol.h.
+ *
+ *   xbledctld [--socket NAME] [--simulate N] [--reconnect-concurrency N] [--verbose]
+ *
+ * The device table is also published to the shared status page (see
+ * status_page.h). Runs in the foreground until SIGINT/SIGTERM (Ctrl+C on
+ * Windows) and then prints request and write counters to stderr.
+ */
+#include "gip_loopback.h"
+#include "ipc_server.h"
+#include "led_service.h"
+#include "status_page.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+static const uint64_t SIMULATED_DEVICE_BASE = 0x7E5700000001ull;
+
+struct DaemonOptions {
+    std::string               socket;
+    int                       simulate = 0;
+    int                       reconnect_concurrency = ReconnectScheduler::DEFAULT_CONCURRENCY;
+    bool                      verbose = false;
+    const char               *sysfs = nullptr;
+    std::vector<const char *> raw;
+};
+
+static void Usage()
+{
+    fprintf(stderr,
+        "usage: xbledctld [--socket NAME] [--simulate N] [--reconnect-concurrency N] [--verbose]"
+#ifdef __linux__
+        " [--sysfs ROOT] [--raw DEVICE]..."
+#endif
+        "\n");
+}
+
+static bool ParseArgs(int argc, char **argv, DaemonOptions *o)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        char *end = nullptr;
+
+        if (strcmp(a, "--verbose") == 0) {
+            o->verbose = true;
+        } else if (!v) {
+            fprintf(stderr, "%s needs a value\n", a);
+            return false;
+        } else if (strcmp(a, "--socket") == 0) {
+            o->socket = v;
+            i++;
+        } else if (strcmp(a, "--simulate") == 0) {
+            o->simulate = (int)strtol(v, &end, 10);
+            if (*end || o->simulate < 1 || o->simulate > XBOX_MAX_DEVICES) {
+                fprintf(stderr, "--simulate takes 1-%d controllers\n", XBOX_MAX_DEVICES);
+                return false;
+            }
+            i++;
+        } else if (strcmp(a, "--reconnect-concurrency") == 0) {
+            o->reconnect_concurrency = (int)strtol(v, &end, 10);
+            if (*end || o->reconnect_concurrency < 1 ||
+                o->reconnect_concurrency > XBOX_BATCH_WINDOW_MAX) {
+                fprintf(stderr, "--reconnect-concurrency takes 1-%d\n", XBOX_BATCH_WINDOW_MAX);
+                return false;
+            }
+            i++;
+#ifdef __linux__
+        } else if (strcmp(a, "--sysfs") == 0) {
+            o->sysfs = v;
+            i++;
+        } else if (strcmp(a, "--raw") == 0) {
+            o->raw.push_back(v);
+            i++;
+#endif
+        } else {
+            fprintf(stderr, "unknown option %s\n", a);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool CreateTransport(const DaemonOptions &o, GipTransport *out)
+{
+    if (o.simulate) {
+        *out = gip_loopback_create(nullptr);
+        for (int i = 0; i < o.simulate; i++)
+            gip_loopback_add_device(*out, SIMULATED_DEVICE_BASE + (uint64_t)i);
+        return true;
+    }
+#ifdef _WIN32
+    *out = gip_transport_win32_create();
+    return true;
+#else
+#ifdef __linux__
+    if (!o.raw.empty()) {
+        std::vector<int> fds;
+        for (const char *path : o.raw) {
+            int fd = open(path, O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                fprintf(stderr, "cannot open %s\n", path);
+                for (int opened : fds)
+                    close(opened);
+                return false;
+            }
+            fds.push_back(fd);
+        }
+        *out = gip_transport_uring_create(fds.data(), (int)fds.size());
+        return true;
+    }
+    *out = gip_transport_xone_create(o.sysfs);
+    return true;
+#else
+    fprintf(stderr, "no controller transport on this platform; use --simulate\n");
+    return false;
+#endif
+#endif
+}
+
+/* --verbose: one line per bus event, formatted on this thread rather than
+   the worker's. */
+class EventLog {
+public:
+    explicit EventLog(EventBus *bus) : m_bus(bus)
+    {
+        m_sub = bus->Subscribe(BUS_MASK_ALL, [this] {
+            {
+                std::lock_guard<std::mutex> lock(m_mu);
+                m_ready = true;
+            }
+            m_cv.notify_one();
+        });
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    ~EventLog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+private:
+    void Run()
+    {
+        static const char *const NAMES[BUS_EVENT_TYPES] = {
+            "arrived", "left", "queued", "sent", "failed", "latency", "hotplug"
+        };
+        uint64_t t0 = xbox_time_ns();
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mu);
+                m_cv.wait(lock, [this] { return m_ready || m_stop; });
+                if (m_stop)
+                    return;
+                m_ready = false;
+            }
+            BusEvent ev;
+            while (m_bus->Poll(m_sub, &ev)) {
+                fprintf(stderr, "%10.3f %-8s %016llx", (ev.t_ns - t0) / 1e6, NAMES[ev.type],
+                        (unsigned long long)ev.device_id);
+                if (ev.type == BUS_LATENCY || ev.type == BUS_HOTPLUG)
+                    fprintf(stderr, " %.3f ms\n", ev.latency_ns / 1e6);
+                else if (ev.type == BUS_CMD_FAILED)
+                    fprintf(stderr, " error %u\n", ev.error);
+                else
+                    fprintf(stderr, " mode 0x%02x brightness %u\n", ev.mode, ev.brightness);
+            }
+        }
+    }
+
+    EventBus               *m_bus;
+    int                     m_sub;
+    std::thread             m_thread;
+    std::mutex              m_mu;
+    std::condition_variable m_cv;
+    bool                    m_ready = false;
+    bool                    m_stop = false;
+};
+
+static void PrintReconnects(const ReconnectStats &r)
+{
+    if (!r.storms)
+        return;
+    fprintf(stderr, "reconnects %llu applied, %llu failed in %llu storms; "
+                    "last %u controllers in %.1f ms, slowest %.1f ms\ntime to apply:",
+            (unsigned long long)r.applied, (unsigned long long)r.failed,
+            (unsigned long long)r.storms, r.last_storm_devices, r.last_storm_ns / 1e6,
+            r.max_storm_ns / 1e6);
+    for (int b = 0; b < RECONNECT_HIST_BUCKETS; b++) {
+        if (!r.apply_hist[b])
+            continue;
+        if (b == RECONNECT_HIST_BUCKETS - 1)
+            fprintf(stderr, " >=%ums:%u", 1u << (b - 1), r.apply_hist[b]);
+        else
+            fprintf(stderr, " <%ums:%u", 1u << b, r.apply_hist[b]);
+    }
+    fprintf(stderr, "\n");
+}
+
+#ifdef _WIN32
+static HANDLE g_stop_event;
+
+static BOOL WINAPI OnConsoleCtrl(DWORD /*type*/)
+{
+    SetEvent(g_stop_event);
+    return TRUE;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    DaemonOptions o;
+    if (!ParseArgs(argc, argv, &o)) {
+        Usage();
+        return 2;
+    }
+    if (o.socket.empty())
+        o.socket = IpcDefaultName();
+
+#ifndef _WIN32
+    /* Every thread inherits the mask, so only sigwait below sees them. */
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+#endif
+
+    GipTransport transport;
+    if (!CreateTransport(o, &transport))
+        return 1;
+    StatusPublisher status;
+    LedService      service(transport);
+    IpcServer       server(&service);
+    service.SetReconnectConcurrency(o.reconnect_concurrency);
+
+    std::string err;
+    if (status.Create(StatusPageDefaultName().c_str(), &err))
+        service.SetStatusPublisher(&status);
+    else
+        fprintf(stderr, "status page not published: %s\n", err.c_str());
+
+    if (!server.Start(o.socket, &err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+    std::unique_ptr<EventLog> log;
+    if (o.verbose)
+        log.reset(new EventLog(&service.Bus()));
+    service.Start();
+    fprintf(stderr, "listening on %s\n", o.socket.c_str());
+
+#ifdef _WIN32
+    g_stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+    WaitForSingleObject(g_stop_event, INFINITE);
+#else
+    int sig = 0;
+    sigwait(&stop_signals, &sig);
+#endif
+
+    server.Stop();
+    service.Stop();
+    log.reset();
+
+    IpcServerStats is = server.Stats();
+    LedServiceStats ls = service.Stats();
+    fprintf(stderr,
+            "connections %llu, requests %llu (%llu bad), events %llu (%llu dropped)\n"
+            "batches %llu, writes %llu, coalesced %llu, failed %llu, rejected %llu\n"
+            "frames sent %llu, suppressed %llu (already showing the value)\n",
+            (unsigned long long)is.connections, (unsigned long long)is.requests,
+            (unsigned long long)is.bad_requests, (unsigned long long)is.events,
+            (unsigned long long)is.dropped_events, (unsigned long long)ls.batches,
+            (unsigned long long)ls.writes, (unsigned long long)ls.coalesced,
+            (unsigned long long)ls.failed, (unsigned long long)ls.rejected,
+            (unsigned long long)ls.frames,
+            (unsigned long long)ls.suppressed);
+    PrintReconnects(ls.reconnect);
+    return 0;
+}
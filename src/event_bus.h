@@ -0,0 +1,124 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "mpsc_ring.h"
+
+enum BusEventType : uint8_t {
+    BUS_DEVICE_ARRIVED,
+    BUS_DEVICE_LEFT,
+    BUS_CMD_QUEUED,
+    BUS_CMD_SENT,
+    BUS_CMD_FAILED,
+    BUS_LATENCY,
+    BUS_HOTPLUG,          /* a new controller got its LED; latency_ns from plug-in */
+    BUS_EVENT_TYPES
+};
+
+#define BUS_MASK(type) (1u << (type))
+#define BUS_MASK_ALL   ((1u << BUS_EVENT_TYPES) - 1)
+
+#define BUS_FLAG_PREVIEW 0x01   /* intermediate value (slider drag, animation frame) */
+#define BUS_FLAG_AUTO    0x02   /* issued by the app, not the user */
+
+#define BUS_NO_MODE 0xFF
+
+/* Plain data only: producers never format strings, consumers do. */
+struct BusEvent {
+    BusEventType type;
+    uint8_t      cmd;         /* publisher's command kind, 0 if none */
+    uint8_t      flags;
+    uint8_t      present;     /* publisher's view of the session after the event */
+    uint8_t      mode;        /* raw LED mode */
+    uint8_t      mode_idx;    /* MODES index, or BUS_NO_MODE */
+    uint8_t      brightness;
+    uint8_t      error;       /* XBOX_ERR_* for BUS_CMD_FAILED */
+    uint64_t     device_id;
+    uint64_t     t_ns;
+    uint64_t     latency_ns;  /* BUS_LATENCY, BUS_HOTPLUG */
+};
+
+/*
+ * Fan-out of BusEvents to independent subscribers. Every subscriber has
+ * its own ring, so a slow one only loses its own events (counted in
+ * Dropped) and Publish never blocks or takes a lock. The notify callback
+ * runs on the publishing thread at most once until the subscriber has
+ * polled its ring empty again, so it can be a PostMessage or SetEvent.
+ */
+class EventBus {
+public:
+    static constexpr int    MAX_SUBSCRIBERS = 8;
+    static constexpr size_t RING_SIZE = 256;
+
+    using Notify = std::function<void()>;
+
+    /* Returns -1 when every slot is taken. Subscriptions last as long as
+       the bus. */
+    int Subscribe(uint32_t mask, Notify notify = nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_sub_mu);
+        int id = m_count.load(std::memory_order_relaxed);
+        if (id == MAX_SUBSCRIBERS)
+            return -1;
+        m_subs[id].reset(new Subscriber);
+        m_subs[id]->mask = mask;
+        m_subs[id]->notify = std::move(notify);
+        m_count.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    void Publish(const BusEvent &ev)
+    {
+        int n = m_count.load(std::memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            Subscriber &s = *m_subs[i];
+            if (!(s.mask & BUS_MASK(ev.type)))
+                continue;
+            if (!s.ring.Push(ev)) {
+                s.dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (s.notify && !s.notified.exchange(true, std::memory_order_acq_rel))
+                s.notify();
+        }
+    }
+
+    /* One consumer thread per subscription. */
+    bool Poll(int id, BusEvent *out)
+    {
+        if (id < 0)
+            return false;
+        Subscriber &s = *m_subs[id];
+        if (s.ring.Pop(out))
+            return true;
+        /* Re-arm, then look again for anything pushed in between. */
+        s.notified.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return s.ring.Pop(out);
+    }
+
+    uint64_t Dropped(int id) const
+    {
+        return id < 0 ? 0 : m_subs[id]->dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Subscriber {
+        uint32_t                        mask = 0;
+        Notify                          notify;
+        std::atomic<bool>               notified{false};
+        std::atomic<uint64_t>           dropped{0};
+        MpscRing<BusEvent, RING_SIZE>   ring;
+    };
+
+    std::unique_ptr<Subscriber> m_subs[MAX_SUBSCRIBERS];
+    std::atomic<int>            m_count{0};
+    std::mutex                  m_sub_mu;
+};
+
+#endif /* EVENT_BUS_H */
@@ -0,0 +1,94 @@
+#include "gip_decode.h"
+#include "gip_protocol.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void gip_decoder_init(GipDecoder *d, const void *buf, uint32_t len)
+{
+    d->buf = (const uint8_t *)buf;
+    d->len = len;
+    d->off = 0;
+}
+
+bool gip_decode_next(GipDecoder *d, GipMsg *msg)
+{
+    if (d->len - d->off < sizeof(GipHeader))
+        return false;
+
+    const uint8_t *h = d->buf + d->off;
+    uint32_t avail = d->len - d->off - (uint32_t)sizeof(GipHeader);
+    uint32_t claimed = le32(h + offsetof(GipHeader, length));
+
+    memcpy(&msg->device_id, h + offsetof(GipHeader, deviceId), sizeof(msg->device_id));
+    msg->command = h[offsetof(GipHeader, commandId)];
+    msg->flags = h[offsetof(GipHeader, clientFlags)];
+    msg->sequence = h[offsetof(GipHeader, sequence)];
+    msg->payload = h + sizeof(GipHeader);
+    msg->truncated = claimed > avail;
+    msg->length = msg->truncated ? avail : claimed;
+
+    d->off = msg->truncated ? d->len : d->off + (uint32_t)sizeof(GipHeader) + claimed;
+    return true;
+}
+
+/* Payload: MAC, two bytes of padding, then VID/PID. Acknowledge frames
+   may be shorter; whatever is missing reads as zero. */
+bool gip_msg_announce(const GipMsg *msg, GipAnnounce *out)
+{
+    if (msg->command != GIP_CMD_ACKNOWLEDGE && msg->command != GIP_CMD_ANNOUNCE)
+        return false;
+    memset(out, 0, sizeof(*out));
+    if (msg->length >= 6)
+        memcpy(out->mac, msg->payload, 6);
+    if (msg->length >= 12) {
+        out->vendor_id = le16(msg->payload + 8);
+        out->product_id = le16(msg->payload + 10);
+    }
+    return true;
+}
+
+bool gip_msg_status(const GipMsg *msg, GipStatus *out)
+{
+    if (msg->command != GIP_CMD_STATUS || msg->length < 1)
+        return false;
+    uint8_t b = msg->payload[0];
+    out->battery_level = b & 0x03;
+    out->battery_type = (b >> 2) & 0x03;
+    out->charging = (b >> 4) & 0x03;
+    out->connected = (b & GIP_STATUS_CONNECTED) != 0;
+    return true;
+}
+
+bool gip_msg_guide(const GipMsg *msg, GipGuide *out)
+{
+    if (msg->command != GIP_CMD_GUIDE || msg->length < 1)
+        return false;
+    out->pressed = (msg->payload[0] & 0x01) != 0;
+    return true;
+}
+
+bool gip_msg_input(const GipMsg *msg, GipInput *out)
+{
+    if (msg->command != GIP_CMD_INPUT || msg->length < 14)
+        return false;
+    const uint8_t *p = msg->payload;
+    out->buttons = le16(p);
+    out->left_trigger = le16(p + 2);
+    out->right_trigger = le16(p + 4);
+    out->left_x = (int16_t)le16(p + 6);
+    out->left_y = (int16_t)le16(p + 8);
+    out->right_x = (int16_t)le16(p + 10);
+    out->right_y = (int16_t)le16(p + 12);
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef GIP_DECODE_H
+#define GIP_DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Walks the framed messages in a read buffer in place. Views point into
+ * the caller's buffer and stay valid only as long as it does.
+ */
+typedef struct {
+    uint64_t       device_id;
+    uint8_t        command;
+    uint8_t        flags;
+    uint8_t        sequence;
+    uint32_t       length;     /* bytes available at payload */
+    bool           truncated;  /* header claimed more than the buffer held */
+    const uint8_t *payload;
+} GipMsg;
+
+typedef struct {
+    const uint8_t *buf;
+    uint32_t       len;
+    uint32_t       off;
+} GipDecoder;
+
+typedef struct {
+    uint8_t  mac[6];
+    uint16_t vendor_id;
+    uint16_t product_id;
+} GipAnnounce;
+
+#define GIP_BATTERY_WIRED    0
+#define GIP_BATTERY_STANDARD 1
+#define GIP_BATTERY_KIT      2
+
+typedef struct {
+    bool    connected;
+    uint8_t battery_type;   /* GIP_BATTERY_* */
+    uint8_t battery_level;  /* 0 (critical) .. 3 (full) */
+    uint8_t charging;
+} GipStatus;
+
+typedef struct {
+    bool pressed;
+} GipGuide;
+
+typedef struct {
+    uint16_t buttons;
+    uint16_t left_trigger;
+    uint16_t right_trigger;
+    int16_t  left_x;
+    int16_t  left_y;
+    int16_t  right_x;
+    int16_t  right_y;
+} GipInput;
+
+void gip_decoder_init(GipDecoder *d, const void *buf, uint32_t len);
+
+/* False once no complete header is left. A truncated message is still
+   returned (with truncated set) and ends the walk. */
+bool gip_decode_next(GipDecoder *d, GipMsg *msg);
+
+/* Typed views; each checks the command id and payload length first. */
+bool gip_msg_announce(const GipMsg *msg, GipAnnounce *out);
+bool gip_msg_status(const GipMsg *msg, GipStatus *out);
+bool gip_msg_guide(const GipMsg *msg, GipGuide *out);
+bool gip_msg_input(const GipMsg *msg, GipInput *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
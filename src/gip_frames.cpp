@@ -0,0 +1,9 @@
+#include "gip_frames.h"
+#include "gip_frames.hpp"
+
+static_assert(gip::LED_FRAME_LEN == GIP_LED_FRAME_LEN, "GIP_LED_FRAME_LEN out of date");
+
+uint32_t gip_led_frame(uint8_t *out, uint64_t device_id, uint8_t seq, uint8_t mode, uint8_t brightness)
+{
+    return (uint32_t)gip::write_led(out, device_id, seq, mode, brightness);
+}
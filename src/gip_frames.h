@@ -0,0 +1,22 @@
+#ifndef GIP_FRAMES_H
+#define GIP_FRAMES_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Modes with a pre-encoded frame for every brightness level. */
+#define GIP_LED_MODE_COUNT 16
+#define GIP_LED_FRAME_LEN  23
+
+/* C entry point to the compile-time table in gip_frames.hpp. Clamps the
+   brightness and returns the frame length; out needs GIP_LED_FRAME_LEN. */
+uint32_t gip_led_frame(uint8_t *out, uint64_t device_id, uint8_t seq, uint8_t mode, uint8_t brightness);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef GIP_FRAMES_HPP
+#define GIP_FRAMES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "gip_frames.h"
+
+extern "C" {
+#include "gip_protocol.h"
+#include "xbox_led.h"
+}
+
+/*
+ * LED frames encoded at compile time. Every (mode, brightness) pair for
+ * modes 0..GIP_LED_MODE_COUNT-1 is a complete frame in .rodata; sending one
+ * is a copy plus patching the device id and sequence byte.
+ */
+namespace gip {
+
+static_assert(sizeof(GipHeader) == 20, "GipHeader must stay 20 bytes");
+static_assert(offsetof(GipHeader, deviceId) == 0, "GipHeader layout");
+static_assert(offsetof(GipHeader, commandId) == 8, "GipHeader layout");
+static_assert(offsetof(GipHeader, clientFlags) == 9, "GipHeader layout");
+static_assert(offsetof(GipHeader, sequence) == 10, "GipHeader layout");
+static_assert(offsetof(GipHeader, length) == 12, "GipHeader layout");
+static_assert(offsetof(GipHeader, unknown2) == 16, "GipHeader layout");
+
+constexpr std::size_t LED_PAYLOAD_LEN = 3;
+constexpr std::size_t LED_FRAME_LEN = sizeof(GipHeader) + LED_PAYLOAD_LEN;
+constexpr std::size_t LED_MODE_COUNT = GIP_LED_MODE_COUNT;
+constexpr std::size_t LED_LEVELS = LED_BRIGHTNESS_MAX + 1;
+
+using LedFrame = std::array<uint8_t, LED_FRAME_LEN>;
+
+/* Header fields are little-endian on the wire, as on every host we build for. */
+constexpr LedFrame encode_led(uint8_t mode, uint8_t brightness)
+{
+    LedFrame f{};
+    f[offsetof(GipHeader, commandId)] = GIP_CMD_LED;
+    f[offsetof(GipHeader, clientFlags)] = GIP_OPT_INTERNAL;
+    f[offsetof(GipHeader, length)] = (uint8_t)LED_PAYLOAD_LEN;
+    f[sizeof(GipHeader) + 1] = mode;
+    f[sizeof(GipHeader) + 2] = brightness;
+    return f;
+}
+
+struct LedFrameTable {
+    LedFrame frames[LED_MODE_COUNT][LED_LEVELS];
+};
+
+constexpr LedFrameTable build_led_table()
+{
+    LedFrameTable t{};
+    for (std::size_t m = 0; m < LED_MODE_COUNT; m++) {
+        for (std::size_t b = 0; b < LED_LEVELS; b++)
+            t.frames[m][b] = encode_led((uint8_t)m, (uint8_t)b);
+    }
+    return t;
+}
+
+inline constexpr LedFrameTable LED_TABLE = build_led_table();
+
+static_assert(LED_TABLE.frames[LED_MODE_ON][20][8] == GIP_CMD_LED, "LED table encoding");
+static_assert(LED_TABLE.frames[LED_MODE_ON][20][21] == LED_MODE_ON, "LED table encoding");
+static_assert(LED_TABLE.frames[LED_MODE_ON][20][22] == 20, "LED table encoding");
+
+/* Writes a ready-to-send frame into out and returns its length. */
+inline std::size_t write_led(uint8_t *out, uint64_t device_id, uint8_t seq, uint8_t mode, uint8_t brightness)
+{
+    if (brightness > LED_BRIGHTNESS_MAX)
+        brightness = LED_BRIGHTNESS_MAX;
+    if (mode < LED_MODE_COUNT)
+        std::memcpy(out, LED_TABLE.frames[mode][brightness].data(), LED_FRAME_LEN);
+    else
+        std::memcpy(out, encode_led(mode, brightness).data(), LED_FRAME_LEN);
+    std::memcpy(out + offsetof(GipHeader, deviceId), &device_id, sizeof(device_id));
+    out[offsetof(GipHeader, sequence)] = seq;
+    return LED_FRAME_LEN;
+}
+
+} // namespace gip
+
+#endif /* GIP_FRAMES_HPP */
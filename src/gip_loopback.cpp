@@ -0,0 +1,438 @@
+#include "gip_loopback.h"
+
+extern "C" {
+#include "gip_protocol.h"
+#include "xbox_led.h"
+}
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const uint32_t LOOPBACK_ERR_INVALID = 87;
+
+struct Frame {
+    std::vector<uint8_t> data;
+    Clock::time_point    ready;
+};
+
+struct Request {
+    void             *user;
+    uint8_t          *buf;
+    uint32_t          len;
+    uint8_t           kind;
+    uint8_t           status;
+    uint32_t          error;
+    uint32_t          bytes;
+    Clock::time_point ready;
+    bool              stalled;
+};
+
+struct LedState {
+    uint8_t mode;
+    uint8_t brightness;
+};
+
+struct Loopback {
+    GipLoopbackConfig          cfg;
+    std::mutex                 mu;
+    std::condition_variable    cv;
+    bool                       open = false;
+    bool                       woken = false;
+    std::deque<Frame>          inbound;
+    std::deque<Request>        reads;
+    std::vector<Request>       done;
+    std::map<uint64_t, LedState> devices;
+    GipLoopbackStats           stats = {};
+    uint64_t                   ack_requests = 0;
+};
+
+std::chrono::microseconds us(uint32_t v)
+{
+    return std::chrono::microseconds(v);
+}
+
+std::vector<uint8_t> make_frame(uint64_t device_id, uint8_t cmd, const uint8_t *payload, uint32_t len,
+                                uint8_t seq = 0)
+{
+    std::vector<uint8_t> f(sizeof(GipHeader) + len);
+    GipHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.deviceId = device_id;
+    hdr.commandId = cmd;
+    hdr.clientFlags = GIP_OPT_INTERNAL;
+    hdr.sequence = seq;
+    hdr.length = len;
+    memcpy(f.data(), &hdr, sizeof(hdr));
+    if (len)
+        memcpy(f.data() + sizeof(hdr), payload, len);
+    return f;
+}
+
+/* Announce payload: MAC, padding, VID/PID of a Series X|S pad. */
+std::vector<uint8_t> announce_frame(uint64_t device_id)
+{
+    uint8_t payload[28] = {};
+    memcpy(payload, &device_id, 6);
+    payload[8] = 0x5E; payload[9] = 0x04;
+    payload[10] = 0x12; payload[11] = 0x0B;
+    return make_frame(device_id, GIP_CMD_ANNOUNCE, payload, sizeof(payload));
+}
+
+std::vector<uint8_t> disconnect_frame(uint64_t device_id)
+{
+    uint8_t payload[4] = {};
+    return make_frame(device_id, GIP_CMD_STATUS, payload, sizeof(payload));
+}
+
+/* Ack payload: acked command, its flags and length, then bytes remaining. */
+std::vector<uint8_t> ack_frame(const GipHeader &acked)
+{
+    uint8_t payload[9] = {};
+    payload[1] = acked.commandId;
+    payload[2] = acked.clientFlags;
+    payload[3] = (uint8_t)acked.length;
+    payload[4] = (uint8_t)(acked.length >> 8);
+    return make_frame(acked.deviceId, GIP_CMD_ACKNOWLEDGE, payload, sizeof(payload), acked.sequence);
+}
+
+void queue_inbound(Loopback *lb, std::vector<uint8_t> data, uint32_t latency_us)
+{
+    /* Posted reads absorb frames as they arrive; only the excess counts
+       against the limit. */
+    if (lb->cfg.inbound_limit && lb->inbound.size() >= lb->reads.size() + lb->cfg.inbound_limit) {
+        lb->stats.dropped_frames++;
+        return;
+    }
+    lb->inbound.push_back({ std::move(data), Clock::now() + us(latency_us) });
+    lb->cv.notify_all();
+}
+
+/* Hand ready inbound frames to posted reads, oldest first. */
+void match_reads(Loopback *lb, Clock::time_point now)
+{
+    while (!lb->reads.empty() && !lb->inbound.empty() && lb->inbound.front().ready <= now) {
+        Request r = lb->reads.front();
+        lb->reads.pop_front();
+        Frame &f = lb->inbound.front();
+        uint32_t n = (uint32_t)f.data.size() < r.len ? (uint32_t)f.data.size() : r.len;
+        memcpy(r.buf, f.data.data(), n);
+        lb->inbound.pop_front();
+
+        r.bytes = n;
+        r.status = GIP_IO_OK;
+        r.ready = now;
+        lb->done.push_back(r);
+        lb->stats.reads++;
+    }
+}
+
+void apply_write(Loopback *lb, const uint8_t *buf, uint32_t len, Request *r)
+{
+    r->bytes = len;
+    r->status = GIP_IO_OK;
+
+    GipHeader hdr;
+    if (len < sizeof(hdr)) {
+        r->status = GIP_IO_FAILED;
+        r->error = LOOPBACK_ERR_INVALID;
+        return;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    auto it = lb->devices.find(hdr.deviceId);
+    if (it == lb->devices.end() || sizeof(hdr) + hdr.length > len) {
+        r->status = GIP_IO_FAILED;
+        r->error = LOOPBACK_ERR_INVALID;
+        return;
+    }
+    if (hdr.commandId == GIP_CMD_LED && hdr.length >= 3) {
+        it->second.mode = buf[sizeof(hdr) + 1];
+        it->second.brightness = buf[sizeof(hdr) + 2];
+    }
+    if (hdr.clientFlags & GIP_OPT_ACKNOWLEDGE) {
+        uint64_t n = ++lb->ack_requests;
+        if (lb->cfg.drop_ack_every && n % lb->cfg.drop_ack_every == 0) {
+            lb->stats.dropped_acks++;
+        } else {
+            lb->stats.acks++;
+            queue_inbound(lb, ack_frame(hdr), lb->cfg.write_latency_us + lb->cfg.read_latency_us);
+        }
+    }
+}
+
+Loopback *from(GipTransport t);
+
+bool lb_open(void *self, uint32_t *err)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (lb->cfg.fail_open) {
+        *err = lb->cfg.fail_error ? lb->cfg.fail_error : 2;
+        return false;
+    }
+    lb->open = true;
+    lb->stats.opens++;
+    return true;
+}
+
+bool lb_ioctl(void *self, uint32_t code)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->open || code != GIP_REENUMERATE)
+        return false;
+    lb->stats.ioctls++;
+    for (const auto &d : lb->devices)
+        queue_inbound(lb, announce_frame(d.first), lb->cfg.announce_latency_us);
+    return true;
+}
+
+size_t inflight(const Loopback *lb)
+{
+    return lb->reads.size() + lb->done.size();
+}
+
+bool lb_read(void *self, void *buf, uint32_t len, void *user)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->open || inflight(lb) >= GIP_MAX_INFLIGHT)
+        return false;
+    Request r = {};
+    r.user = user;
+    r.buf = (uint8_t *)buf;
+    r.len = len;
+    r.kind = GIP_IO_READ;
+    lb->reads.push_back(r);
+    lb->cv.notify_all();
+    return true;
+}
+
+bool lb_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->open || inflight(lb) >= GIP_MAX_INFLIGHT)
+        return false;
+
+    uint64_t n = ++lb->stats.writes;
+    Request r = {};
+    r.user = user;
+    r.kind = GIP_IO_WRITE;
+    r.ready = Clock::now() + us(lb->cfg.write_latency_us);
+
+    if (lb->cfg.stall_write_every && n % lb->cfg.stall_write_every == 0) {
+        r.stalled = true;
+        lb->stats.stalled_writes++;
+    } else if (lb->cfg.fail_write_every && n % lb->cfg.fail_write_every == 0) {
+        r.status = GIP_IO_FAILED;
+        r.error = lb->cfg.fail_error ? lb->cfg.fail_error : 31;
+    } else {
+        apply_write(lb, (const uint8_t *)buf, len, &r);
+    }
+    if (r.status != GIP_IO_OK)
+        lb->stats.failed_writes++;
+
+    lb->done.push_back(r);
+    lb->cv.notify_all();
+    return true;
+}
+
+int lb_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    Loopback *lb = (Loopback *)self;
+    std::unique_lock<std::mutex> lock(lb->mu);
+    Clock::time_point deadline = timeout_ms == GIP_WAIT_INFINITE
+        ? Clock::time_point::max()
+        : Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        match_reads(lb, now);
+
+        int count = 0;
+        Clock::time_point next = deadline;
+        for (size_t i = 0; i < lb->done.size();) {
+            Request &r = lb->done[i];
+            if (r.stalled) {
+                i++;
+                continue;
+            }
+            if (r.ready > now || count == max) {
+                if (r.ready < next)
+                    next = r.ready;
+                i++;
+                continue;
+            }
+            GipCompletion &c = out[count++];
+            c.user = r.user;
+            c.kind = r.kind;
+            c.bytes = r.bytes;
+            c.status = r.status;
+            c.error = r.error;
+            lb->done.erase(lb->done.begin() + (ptrdiff_t)i);
+        }
+        if (count > 0)
+            return count;
+        if (lb->woken) {
+            lb->woken = false;
+            return 0;
+        }
+        if (!lb->reads.empty() && !lb->inbound.empty() && lb->inbound.front().ready < next)
+            next = lb->inbound.front().ready;
+        if (now >= deadline)
+            return 0;
+        if (next == Clock::time_point::max())
+            lb->cv.wait(lock);
+        else
+            lb->cv.wait_until(lock, next);
+    }
+}
+
+void lb_wake(void *self)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    lb->woken = true;
+    lb->cv.notify_all();
+}
+
+void lb_close(void *self)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    lb->open = false;
+    lb->reads.clear();
+    lb->done.clear();
+    lb->inbound.clear();
+}
+
+void lb_destroy(void *self)
+{
+    delete (Loopback *)self;
+}
+
+uint64_t lb_dropped(void *self)
+{
+    Loopback *lb = (Loopback *)self;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    return lb->stats.dropped_frames;
+}
+
+const GipTransportOps LOOPBACK_OPS = {
+    "loopback",
+    lb_open,
+    lb_ioctl,
+    lb_read,
+    lb_write,
+    lb_poll,
+    lb_wake,
+    lb_close,
+    lb_destroy,
+    lb_dropped,
+};
+
+Loopback *from(GipTransport t)
+{
+    return t.ops == &LOOPBACK_OPS ? (Loopback *)t.self : nullptr;
+}
+
+} // namespace
+
+GipTransport gip_loopback_create(const GipLoopbackConfig *cfg)
+{
+    Loopback *lb = new Loopback();
+    if (cfg)
+        lb->cfg = *cfg;
+    else
+        memset(&lb->cfg, 0, sizeof(lb->cfg));
+    GipTransport t = { &LOOPBACK_OPS, lb };
+    return t;
+}
+
+bool gip_loopback_add_device(GipTransport t, uint64_t device_id)
+{
+    Loopback *lb = from(t);
+    if (!lb)
+        return false;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->devices.emplace(device_id, LedState{ LED_MODE_ON, LED_BRIGHTNESS_DEFAULT }).second)
+        return false;
+    if (lb->open)
+        queue_inbound(lb, announce_frame(device_id), lb->cfg.announce_latency_us);
+    return true;
+}
+
+bool gip_loopback_remove_device(GipTransport t, uint64_t device_id)
+{
+    Loopback *lb = from(t);
+    if (!lb)
+        return false;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->devices.erase(device_id))
+        return false;
+    if (lb->open)
+        queue_inbound(lb, disconnect_frame(device_id), lb->cfg.read_latency_us);
+    return true;
+}
+
+bool gip_loopback_inject(GipTransport t, const void *frame, uint32_t len)
+{
+    Loopback *lb = from(t);
+    if (!lb)
+        return false;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->open)
+        return false;
+    const uint8_t *p = (const uint8_t *)frame;
+    queue_inbound(lb, std::vector<uint8_t>(p, p + len), lb->cfg.read_latency_us);
+    return true;
+}
+
+bool gip_loopback_inject_burst(GipTransport t, const void *frame, uint32_t len, uint32_t count)
+{
+    Loopback *lb = from(t);
+    if (!lb)
+        return false;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    if (!lb->open)
+        return false;
+    const uint8_t *p = (const uint8_t *)frame;
+    for (uint32_t i = 0; i < count; i++)
+        queue_inbound(lb, std::vector<uint8_t>(p, p + len), lb->cfg.read_latency_us);
+    return true;
+}
+
+bool gip_loopback_led_state(GipTransport t, uint64_t device_id, uint8_t *mode, uint8_t *brightness)
+{
+    Loopback *lb = from(t);
+    if (!lb)
+        return false;
+    std::lock_guard<std::mutex> lock(lb->mu);
+    auto it = lb->devices.find(device_id);
+    if (it == lb->devices.end())
+        return false;
+    *mode = it->second.mode;
+    *brightness = it->second.brightness;
+    return true;
+}
+
+void gip_loopback_stats(GipTransport t, GipLoopbackStats *out)
+{
+    Loopback *lb = from(t);
+    if (!lb) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lb->mu);
+    *out = lb->stats;
+}
@@ -0,0 +1,58 @@
+#ifndef GIP_LOOPBACK_H
+#define GIP_LOOPBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gip_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * In-process stand-in for \\.\XboxGIP. Devices announce themselves on
+ * GIP_REENUMERATE and when added while the transport is open; LED writes
+ * addressed to a present device update its state. Latencies are applied
+ * from the moment a request (or inbound frame) is queued. With an inbound
+ * limit, frames that arrive while the backlog is full are dropped, as the
+ * driver does when nobody is reading. Writes flagged GIP_OPT_ACKNOWLEDGE
+ * are answered with an ack frame once the write has completed.
+ */
+typedef struct {
+    uint32_t announce_latency_us;
+    uint32_t read_latency_us;
+    uint32_t write_latency_us;
+    bool     fail_open;
+    uint32_t fail_write_every;
+    uint32_t stall_write_every;
+    uint32_t fail_error;
+    uint32_t inbound_limit;   /* frames buffered ahead of reads; 0 = unbounded */
+    uint32_t drop_ack_every;  /* swallow every Nth requested acknowledgement */
+} GipLoopbackConfig;
+
+typedef struct {
+    uint64_t opens;
+    uint64_t ioctls;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t failed_writes;
+    uint64_t stalled_writes;
+    uint64_t dropped_frames;
+    uint64_t acks;
+    uint64_t dropped_acks;
+} GipLoopbackStats;
+
+GipTransport gip_loopback_create(const GipLoopbackConfig *cfg);
+bool gip_loopback_add_device(GipTransport t, uint64_t device_id);
+bool gip_loopback_remove_device(GipTransport t, uint64_t device_id);
+bool gip_loopback_inject(GipTransport t, const void *frame, uint32_t len);
+bool gip_loopback_inject_burst(GipTransport t, const void *frame, uint32_t len, uint32_t count);
+bool gip_loopback_led_state(GipTransport t, uint64_t device_id, uint8_t *mode, uint8_t *brightness);
+void gip_loopback_stats(GipTransport t, GipLoopbackStats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef GIP_PROTOCOL_H
+#define GIP_PROTOCOL_H
+
+#include <stdint.h>
+
+#define GIP_REENUMERATE 0x40001CD0
+
+#define GIP_CMD_ACKNOWLEDGE  0x01
+#define GIP_CMD_ANNOUNCE     0x02
+#define GIP_CMD_STATUS       0x03
+#define GIP_CMD_GUIDE        0x07
+#define GIP_CMD_INPUT        0x20
+#define GIP_STATUS_CONNECTED 0x80
+
+/* clientFlags bit asking the device to acknowledge a frame. The ack
+   carries the same sequence number, with the acked command at payload[1]. */
+#define GIP_OPT_ACKNOWLEDGE  0x10
+
+/* Framing used by \\.\XboxGIP; see README.md. */
+#pragma pack(push, 1)
+typedef struct {
+    uint64_t deviceId;
+    uint8_t  commandId;
+    uint8_t  clientFlags;
+    uint8_t  sequence;
+    uint8_t  unknown1;
+    uint32_t length;
+    uint32_t unknown2;
+} GipHeader;
+#pragma pack(pop)
+
+#endif
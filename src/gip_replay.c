@@ -0,0 +1,263 @@
+#include "gip_trace.h"
+#include "gip_protocol.h"
+#include "xbox_led.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define SLEEP_SLICE_NS 10000000ull
+
+typedef struct {
+    void    *user;
+    uint8_t *buf;
+    uint32_t len;
+} ReplayRead;
+
+typedef struct {
+    void    *user;
+    uint32_t bytes;
+} ReplayWrite;
+
+typedef struct {
+    GipTraceReader trace;
+    GipTraceReader writes;      /* second cursor for recorded writes */
+    bool           realtime;
+    bool           open;
+    bool           woken;
+    bool           done;
+    uint64_t       base_ns;     /* host time that matches trace time 0 */
+    GipTraceRecord next;        /* next recorded read, valid unless done */
+
+    ReplayRead     reads[GIP_MAX_INFLIGHT];
+    int            read_count;
+    ReplayWrite    wdone[GIP_MAX_INFLIGHT];
+    int            wdone_count;
+
+    GipReplayStats stats;
+} GipReplay;
+
+static void sleep_ns(uint64_t ns)
+{
+#ifdef _WIN32
+    Sleep((DWORD)((ns + 999999) / 1000000));
+#else
+    struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void advance(GipReplay *rp)
+{
+    while (gip_trace_next(&rp->trace, &rp->next)) {
+        if (rp->next.kind == GIP_TRACE_READ)
+            return;
+    }
+    rp->done = true;
+}
+
+static uint64_t ready_at(const GipReplay *rp)
+{
+    return rp->realtime ? rp->base_ns + rp->next.t_ns : 0;
+}
+
+/* Opening lines the trace clock up with ours at the recorded open, so
+   later frames keep their recorded delay from it. */
+static bool rp_open(void *self, uint32_t *err)
+{
+    GipReplay *rp = (GipReplay *)self;
+    (void)err;
+    if (!rp->base_ns) {
+        GipTraceReader scan = rp->trace;
+        GipTraceRecord rec;
+        uint64_t t = 0;
+        gip_trace_rewind(&scan);
+        while (gip_trace_next(&scan, &rec)) {
+            if (rec.kind == GIP_TRACE_OPEN) {
+                t = rec.t_ns;
+                break;
+            }
+        }
+        rp->base_ns = xbox_time_ns() - t;
+    }
+    rp->open = true;
+    return true;
+}
+
+static bool rp_ioctl(void *self, uint32_t code)
+{
+    GipReplay *rp = (GipReplay *)self;
+    return rp->open && code == GIP_REENUMERATE;
+}
+
+static bool rp_read(void *self, void *buf, uint32_t len, void *user)
+{
+    GipReplay *rp = (GipReplay *)self;
+    if (!rp->open || rp->read_count + rp->wdone_count >= GIP_MAX_INFLIGHT)
+        return false;
+    ReplayRead *r = &rp->reads[rp->read_count++];
+    r->user = user;
+    r->buf = (uint8_t *)buf;
+    r->len = len;
+    return true;
+}
+
+static void compare_write(GipReplay *rp, const uint8_t *buf, uint32_t len)
+{
+    GipTraceRecord rec;
+    while (gip_trace_next(&rp->writes, &rec)) {
+        if (rec.kind != GIP_TRACE_WRITE)
+            continue;
+        bool same = rec.len == len;
+        for (uint32_t i = 0; same && i < len; i++) {
+            if (i != 10 && rec.data[i] != buf[i])   /* GipHeader.sequence */
+                same = false;
+        }
+        if (!same)
+            rp->stats.write_mismatches++;
+        return;
+    }
+    rp->stats.write_mismatches++;
+}
+
+static bool rp_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    GipReplay *rp = (GipReplay *)self;
+    if (!rp->open || rp->read_count + rp->wdone_count >= GIP_MAX_INFLIGHT)
+        return false;
+    rp->stats.writes++;
+    compare_write(rp, (const uint8_t *)buf, len);
+    ReplayWrite *w = &rp->wdone[rp->wdone_count++];
+    w->user = user;
+    w->bytes = len;
+    return true;
+}
+
+static int rp_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    GipReplay *rp = (GipReplay *)self;
+    uint64_t deadline = timeout_ms == GIP_WAIT_INFINITE
+        ? UINT64_MAX
+        : xbox_time_ns() + timeout_ms * 1000000ull;
+
+    for (;;) {
+        int n = 0;
+        while (n < max && rp->wdone_count > 0) {
+            GipCompletion *c = &out[n++];
+            memset(c, 0, sizeof(*c));
+            c->user = rp->wdone[0].user;
+            c->bytes = rp->wdone[0].bytes;
+            c->kind = GIP_IO_WRITE;
+            c->status = GIP_IO_OK;
+            memmove(rp->wdone, rp->wdone + 1, --rp->wdone_count * sizeof(rp->wdone[0]));
+        }
+
+        uint64_t now = xbox_time_ns();
+        while (n < max && rp->read_count > 0 && !rp->done && ready_at(rp) <= now) {
+            ReplayRead *r = &rp->reads[0];
+            uint32_t bytes = rp->next.len < r->len ? rp->next.len : r->len;
+            memcpy(r->buf, rp->next.data, bytes);
+
+            GipCompletion *c = &out[n++];
+            memset(c, 0, sizeof(*c));
+            c->user = r->user;
+            c->kind = GIP_IO_READ;
+            c->status = rp->next.status;
+            c->bytes = bytes;
+            memmove(rp->reads, rp->reads + 1, --rp->read_count * sizeof(rp->reads[0]));
+            rp->stats.reads++;
+            advance(rp);
+        }
+
+        if (n > 0)
+            return n;
+        if (rp->woken) {
+            rp->woken = false;
+            return 0;
+        }
+        now = xbox_time_ns();
+        if (now >= deadline || (rp->done && timeout_ms == GIP_WAIT_INFINITE))
+            return 0;
+
+        uint64_t until = deadline;
+        if (!rp->done && rp->read_count > 0 && ready_at(rp) < until)
+            until = ready_at(rp);
+        uint64_t wait = until - now;
+        sleep_ns(wait < SLEEP_SLICE_NS ? wait : SLEEP_SLICE_NS);
+    }
+}
+
+static void rp_wake(void *self)
+{
+    ((GipReplay *)self)->woken = true;
+}
+
+static void rp_close(void *self)
+{
+    GipReplay *rp = (GipReplay *)self;
+    rp->open = false;
+    rp->read_count = 0;
+    rp->wdone_count = 0;
+}
+
+static void rp_destroy(void *self)
+{
+    GipReplay *rp = (GipReplay *)self;
+    gip_trace_close(&rp->trace);
+    free(rp);
+}
+
+static const GipTransportOps REPLAY_OPS = {
+    "replay",
+    rp_open,
+    rp_ioctl,
+    rp_read,
+    rp_write,
+    rp_poll,
+    rp_wake,
+    rp_close,
+    rp_destroy,
+    NULL,
+};
+
+GipTransport gip_replay_create(const char *path, bool realtime, char *err, size_t err_len)
+{
+    GipTransport t = { NULL, NULL };
+    GipReplay *rp = (GipReplay *)calloc(1, sizeof(*rp));
+    if (!rp) {
+        snprintf(err, err_len, "Out of memory");
+        return t;
+    }
+    if (!gip_trace_open(&rp->trace, path, err, err_len)) {
+        free(rp);
+        return t;
+    }
+    rp->writes = rp->trace;
+    rp->realtime = realtime;
+    advance(rp);
+
+    t.ops = &REPLAY_OPS;
+    t.self = rp;
+    return t;
+}
+
+void gip_replay_stats(GipTransport t, GipReplayStats *out)
+{
+    if (t.ops != &REPLAY_OPS) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = ((GipReplay *)t.self)->stats;
+}
+
+bool gip_replay_done(GipTransport t)
+{
+    return t.ops != &REPLAY_OPS || ((GipReplay *)t.self)->done;
+}
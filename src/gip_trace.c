@@ -0,0 +1,296 @@
+#include "gip_trace.h"
+#include "xbox_led.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FILE_HEADER_LEN   16
+#define RECORD_HEADER_LEN 16
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+    return (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+/* ---- reader ---- */
+
+static bool map_file(GipTraceReader *r, const char *path, char *err, size_t err_len)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        snprintf(err, err_len, "Cannot open %s (error %lu)", path, GetLastError());
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE map = size.QuadPart ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if (!map) {
+        snprintf(err, err_len, "Cannot map %s", path);
+        return false;
+    }
+    r->base = (const uint8_t *)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!r->base) {
+        CloseHandle(map);
+        snprintf(err, err_len, "Cannot map %s", path);
+        return false;
+    }
+    r->map = map;
+    r->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(err, err_len, "Cannot open %s", path);
+        return false;
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        snprintf(err, err_len, "Cannot map %s", path);
+        return false;
+    }
+    r->base = (const uint8_t *)p;
+    r->size = (size_t)st.st_size;
+    r->map = p;
+#endif
+    return true;
+}
+
+bool gip_trace_open(GipTraceReader *r, const char *path, char *err, size_t err_len)
+{
+    memset(r, 0, sizeof(*r));
+    if (!map_file(r, path, err, err_len))
+        return false;
+    if (r->size < FILE_HEADER_LEN || memcmp(r->base, GIP_TRACE_MAGIC, 8) != 0
+        || get_le32(r->base + 8) != GIP_TRACE_VERSION) {
+        snprintf(err, err_len, "%s is not a version %d GIP trace", path, GIP_TRACE_VERSION);
+        gip_trace_close(r);
+        return false;
+    }
+    r->off = FILE_HEADER_LEN;
+    return true;
+}
+
+/* Stops at the end of the file or at a record cut short by a crash. */
+bool gip_trace_next(GipTraceReader *r, GipTraceRecord *rec)
+{
+    if (r->size - r->off < RECORD_HEADER_LEN)
+        return false;
+    const uint8_t *h = r->base + r->off;
+    uint32_t len = get_le32(h + 12);
+    if (r->size - r->off - RECORD_HEADER_LEN < len)
+        return false;
+
+    rec->t_ns = get_le64(h);
+    rec->kind = h[8];
+    rec->status = h[9];
+    rec->len = len;
+    rec->data = h + RECORD_HEADER_LEN;
+    r->off += RECORD_HEADER_LEN + len;
+    return true;
+}
+
+void gip_trace_rewind(GipTraceReader *r)
+{
+    r->off = FILE_HEADER_LEN;
+}
+
+void gip_trace_close(GipTraceReader *r)
+{
+    if (r->base) {
+#ifdef _WIN32
+        UnmapViewOfFile(r->base);
+        CloseHandle((HANDLE)r->map);
+#else
+        munmap(r->map, r->size);
+#endif
+    }
+    memset(r, 0, sizeof(*r));
+}
+
+/* ---- capture ---- */
+
+typedef struct {
+    void *user;
+    void *buf;
+    bool  used;
+} CaptureRead;
+
+typedef struct {
+    GipTransportOps ops;
+    GipTransport    inner;
+    FILE           *file;
+    uint64_t        t0;
+    CaptureRead     reads[GIP_MAX_INFLIGHT];
+} GipCapture;
+
+static void record(GipCapture *c, uint8_t kind, uint8_t status, const void *data, uint32_t len)
+{
+    uint8_t h[RECORD_HEADER_LEN] = { 0 };
+    put_le64(h, xbox_time_ns() - c->t0);
+    h[8] = kind;
+    h[9] = status;
+    put_le32(h + 12, len);
+    fwrite(h, 1, sizeof(h), c->file);
+    if (len)
+        fwrite(data, 1, len, c->file);
+}
+
+static bool cap_open(void *self, uint32_t *err)
+{
+    GipCapture *c = (GipCapture *)self;
+    bool ok = c->inner.ops->open(c->inner.self, err);
+    record(c, GIP_TRACE_OPEN, ok ? GIP_IO_OK : GIP_IO_FAILED, NULL, 0);
+    return ok;
+}
+
+static bool cap_ioctl(void *self, uint32_t code)
+{
+    GipCapture *c = (GipCapture *)self;
+    uint8_t data[4];
+    put_le32(data, code);
+    bool ok = c->inner.ops->ioctl(c->inner.self, code);
+    record(c, GIP_TRACE_IOCTL, ok ? GIP_IO_OK : GIP_IO_FAILED, data, sizeof(data));
+    return ok;
+}
+
+/* Reads are queued under our own tag so the buffer is known when the
+   completion comes back. */
+static bool cap_read(void *self, void *buf, uint32_t len, void *user)
+{
+    GipCapture *c = (GipCapture *)self;
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++) {
+        CaptureRead *slot = &c->reads[i];
+        if (slot->used)
+            continue;
+        if (!c->inner.ops->read(c->inner.self, buf, len, slot))
+            return false;
+        slot->user = user;
+        slot->buf = buf;
+        slot->used = true;
+        return true;
+    }
+    return false;
+}
+
+static bool cap_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    GipCapture *c = (GipCapture *)self;
+    record(c, GIP_TRACE_WRITE, GIP_IO_OK, buf, len);
+    return c->inner.ops->write(c->inner.self, buf, len, user);
+}
+
+static int cap_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    GipCapture *c = (GipCapture *)self;
+    int n = c->inner.ops->poll(c->inner.self, out, max, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        if (out[i].kind != GIP_IO_READ)
+            continue;
+        CaptureRead *slot = (CaptureRead *)out[i].user;
+        if (out[i].status != GIP_IO_CANCELLED)
+            record(c, GIP_TRACE_READ, out[i].status, slot->buf,
+                   out[i].status == GIP_IO_OK ? out[i].bytes : 0);
+        out[i].user = slot->user;
+        slot->used = false;
+    }
+    return n;
+}
+
+static void cap_wake(void *self)
+{
+    GipCapture *c = (GipCapture *)self;
+    c->inner.ops->wake(c->inner.self);
+}
+
+static void cap_close(void *self)
+{
+    GipCapture *c = (GipCapture *)self;
+    c->inner.ops->close(c->inner.self);
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++)
+        c->reads[i].used = false;
+    record(c, GIP_TRACE_CLOSE, GIP_IO_OK, NULL, 0);
+    fflush(c->file);
+}
+
+static uint64_t cap_dropped(void *self)
+{
+    GipCapture *c = (GipCapture *)self;
+    return c->inner.ops->dropped(c->inner.self);
+}
+
+static void cap_destroy(void *self)
+{
+    GipCapture *c = (GipCapture *)self;
+    c->inner.ops->destroy(c->inner.self);
+    fclose(c->file);
+    free(c);
+}
+
+GipTransport gip_capture_create(GipTransport inner, const char *path)
+{
+    if (!inner.ops)
+        return inner;
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return inner;
+
+    uint8_t h[FILE_HEADER_LEN] = { 0 };
+    memcpy(h, GIP_TRACE_MAGIC, 8);
+    put_le32(h + 8, GIP_TRACE_VERSION);
+    fwrite(h, 1, sizeof(h), file);
+
+    GipCapture *c = (GipCapture *)calloc(1, sizeof(*c));
+    if (!c) {
+        fclose(file);
+        return inner;
+    }
+    c->inner = inner;
+    c->file = file;
+    c->t0 = xbox_time_ns();
+    c->ops.name = inner.ops->name;
+    c->ops.open = cap_open;
+    c->ops.ioctl = cap_ioctl;
+    c->ops.read = cap_read;
+    c->ops.write = cap_write;
+    c->ops.poll = cap_poll;
+    c->ops.wake = cap_wake;
+    c->ops.close = cap_close;
+    c->ops.destroy = cap_destroy;
+    c->ops.dropped = inner.ops->dropped ? cap_dropped : NULL;
+
+    GipTransport t = { &c->ops, c };
+    return t;
+}
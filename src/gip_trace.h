@@ -0,0 +1,73 @@
+#ifndef GIP_TRACE_H
+#define GIP_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gip_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary trace of XboxGIP traffic: a 16-byte file header ("GIPTRACE",
+ * version, reserved) followed by records, each a 16-byte little-endian
+ * header and len bytes of frame data. Timestamps are nanoseconds since
+ * the capture started.
+ */
+#define GIP_TRACE_MAGIC   "GIPTRACE"
+#define GIP_TRACE_VERSION 1
+
+#define GIP_TRACE_OPEN  0   /* data: none */
+#define GIP_TRACE_IOCTL 1   /* data: 4-byte control code */
+#define GIP_TRACE_READ  2   /* data: bytes returned; status from completion */
+#define GIP_TRACE_WRITE 3   /* data: frame as submitted */
+#define GIP_TRACE_CLOSE 4   /* data: none */
+
+typedef struct {
+    uint64_t       t_ns;
+    uint8_t        kind;
+    uint8_t        status;
+    uint32_t       len;
+    const uint8_t *data;
+} GipTraceRecord;
+
+/* Read-only view of a trace file, memory-mapped. */
+typedef struct {
+    const uint8_t *base;
+    size_t         size;
+    size_t         off;
+    void          *map;
+} GipTraceReader;
+
+bool gip_trace_open(GipTraceReader *r, const char *path, char *err, size_t err_len);
+bool gip_trace_next(GipTraceReader *r, GipTraceRecord *rec);
+void gip_trace_rewind(GipTraceReader *r);
+void gip_trace_close(GipTraceReader *r);
+
+/* Wraps inner and appends every open, ioctl, completed read and submitted
+   write to path. Takes ownership of inner; destroying the result destroys
+   both. Returns inner unchanged if the file cannot be created. */
+GipTransport gip_capture_create(GipTransport inner, const char *path);
+
+/* Serves the reads of a trace back to the caller, at the recorded pace when
+   realtime is set and as fast as reads are posted otherwise. Writes always
+   succeed and are compared with the recorded ones, ignoring the sequence
+   byte. wake only takes effect between poll sleep slices of at most 10 ms. */
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t write_mismatches;
+} GipReplayStats;
+
+GipTransport gip_replay_create(const char *path, bool realtime, char *err, size_t err_len);
+void         gip_replay_stats(GipTransport t, GipReplayStats *out);
+bool         gip_replay_done(GipTransport t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef GIP_TRANSPORT_H
+#define GIP_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GIP_IO_READ  0
+#define GIP_IO_WRITE 1
+
+#define GIP_IO_OK        0
+#define GIP_IO_FAILED    1
+#define GIP_IO_CANCELLED 2
+#define GIP_IO_GONE      3
+
+#define GIP_MAX_INFLIGHT  32
+#define GIP_WAIT_INFINITE 0xFFFFFFFFu
+
+typedef struct {
+    void    *user;
+    uint32_t bytes;
+    uint32_t error;
+    uint8_t  kind;
+    uint8_t  status;
+} GipCompletion;
+
+/*
+ * Asynchronous byte transport underneath XboxController.
+ *
+ * read/write queue one request and return false only when it cannot be
+ * queued at all; failures are reported as completions from poll. poll
+ * blocks until at least one request completes, wake is called, or the
+ * timeout expires. wake may be called from any thread. close cancels and
+ * drains every outstanding request; no completions are reported for them.
+ * dropped, where the driver can tell, counts inbound frames it discarded
+ * for want of a posted read; it is NULL otherwise.
+ */
+typedef struct {
+    const char *name;
+    bool (*open)(void *self, uint32_t *err);
+    bool (*ioctl)(void *self, uint32_t code);
+    bool (*read)(void *self, void *buf, uint32_t len, void *user);
+    bool (*write)(void *self, const void *buf, uint32_t len, void *user);
+    int  (*poll)(void *self, GipCompletion *out, int max, uint32_t timeout_ms);
+    void (*wake)(void *self);
+    void (*close)(void *self);
+    void (*destroy)(void *self);
+    uint64_t (*dropped)(void *self);
+} GipTransportOps;
+
+typedef struct {
+    const GipTransportOps *ops;
+    void                  *self;
+} GipTransport;
+
+#ifdef _WIN32
+GipTransport gip_transport_win32_create(void);
+#endif
+
+#ifdef __linux__
+/* xone LED class devices under sysfs_root (NULL for /sys/class/leds). */
+GipTransport gip_transport_xone_create(const char *sysfs_root);
+
+/* Raw GIP over io_uring, one caller-owned descriptor per controller. */
+typedef struct {
+    uint64_t syscalls;     /* io_uring_enter calls */
+    uint64_t sqes;
+    uint64_t cqes;
+    uint64_t led_writes;
+    uint64_t dropped;      /* inbound frames that found no room */
+} GipUringStats;
+
+GipTransport gip_transport_uring_create(const int *fds, int count);
+void         gip_uring_stats(GipTransport t, GipUringStats *out);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
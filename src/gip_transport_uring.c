@@ -0,0 +1,670 @@
+#ifdef __linux__
+
+#include "gip_transport.h"
+#include "gip_protocol.h"
+#include "xbox_led.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Raw GIP over arbitrary file descriptors (hidraw, usbfs bulk endpoints,
+ * or a socketpair in tests), one descriptor per controller. On the wire
+ * each packet is a 4-byte header (command, flags, sequence, length as a
+ * 7-bit varint) and its payload; towards XboxController the frames are
+ * rewritten to and from the 20-byte GipHeader framing.
+ *
+ * Requests are only queued as SQEs by read/write; poll submits everything
+ * queued and waits for completions in a single io_uring_enter, so an LED
+ * update costs one syscall when nothing else is pending.
+ */
+
+#define URING_ENTRIES   64
+#define RAW_READ_SIZE   512
+#define RAW_ACC_SIZE    (RAW_READ_SIZE * 2)
+#define INBOUND_MAX     64
+#define FRAME_MAX       (sizeof(GipHeader) + 255)
+#define RAW_DEVICE_BASE 0x5241570000000000ull   /* "RAW" */
+
+#define TAG_READ    1ull
+#define TAG_WRITE   2ull
+#define TAG_WAKE    3ull
+#define TAG_TIMEOUT 4ull
+#define TAG_CANCEL  5ull
+#define USER_DATA(tag, idx) (((tag) << 32) | (uint32_t)(idx))
+
+typedef struct {
+    int      fd;
+    uint64_t device_id;
+    bool     alive;
+    bool     reading;
+    uint8_t  rbuf[RAW_READ_SIZE];
+    uint8_t  acc[RAW_ACC_SIZE];   /* bytes of a packet split across reads */
+    uint32_t have;
+} RawDev;
+
+typedef struct {
+    bool     used;
+    void    *user;
+    uint32_t len;                 /* frame length reported back on success */
+    uint8_t  buf[FRAME_MAX];
+} RawWrite;
+
+typedef struct {
+    void    *user;
+    uint8_t *buf;
+    uint32_t len;
+} RawRead;
+
+typedef struct {
+    uint8_t  data[FRAME_MAX];
+    uint32_t len;
+} RawFrame;
+
+typedef struct {
+    int                     ring_fd;
+    uint8_t                *sq_ptr;
+    uint8_t                *cq_ptr;
+    size_t                  sq_size;
+    size_t                  cq_size;
+    struct io_uring_sqe    *sqes;
+    size_t                  sqes_size;
+    unsigned               *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned               *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe    *cqes;
+    unsigned                sq_local_tail;
+    unsigned                to_submit;
+
+    bool                    open;
+    int                     wake_fd;
+    uint64_t                wake_val;
+    bool                    woken;
+    struct __kernel_timespec timeout;
+
+    RawDev                 *devs;
+    int                     dev_count;
+    RawWrite                writes[GIP_MAX_INFLIGHT];
+    RawRead                 reads[GIP_MAX_INFLIGHT];
+    int                     read_count;
+    RawFrame                inbound[INBOUND_MAX];
+    int                     inbound_count;
+    GipCompletion           done[GIP_MAX_INFLIGHT];
+    int                     done_count;
+
+    GipUringStats           stats;
+} GipUring;
+
+/* ---- ring plumbing ---- */
+
+static int sys_enter(GipUring *u, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    u->stats.syscalls++;
+    return (int)syscall(__NR_io_uring_enter, u->ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void ring_destroy(GipUring *u)
+{
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ptr && u->cq_ptr != u->sq_ptr)
+        munmap(u->cq_ptr, u->cq_size);
+    if (u->sq_ptr)
+        munmap(u->sq_ptr, u->sq_size);
+    if (u->ring_fd >= 0)
+        close(u->ring_fd);
+    u->sqes = NULL;
+    u->sq_ptr = u->cq_ptr = NULL;
+    u->ring_fd = -1;
+}
+
+static bool ring_setup(GipUring *u, uint32_t *err)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (u->ring_fd < 0) {
+        *err = (uint32_t)errno;
+        return false;
+    }
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_size > u->sq_size)
+            u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) {
+        u->sq_ptr = NULL;
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ptr = u->sq_ptr;
+    } else {
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         u->ring_fd, IORING_OFF_CQ_RING);
+        if (u->cq_ptr == MAP_FAILED) {
+            u->cq_ptr = NULL;
+            goto fail;
+        }
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto fail;
+    }
+
+    u->sq_head = (unsigned *)(u->sq_ptr + p.sq_off.head);
+    u->sq_tail = (unsigned *)(u->sq_ptr + p.sq_off.tail);
+    u->sq_mask = (unsigned *)(u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(u->sq_ptr + p.sq_off.array);
+    u->cq_head = (unsigned *)(u->cq_ptr + p.cq_off.head);
+    u->cq_tail = (unsigned *)(u->cq_ptr + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(u->cq_ptr + p.cq_off.cqes);
+    u->sq_local_tail = *u->sq_tail;
+    u->to_submit = 0;
+    return true;
+
+fail:
+    *err = (uint32_t)errno;
+    ring_destroy(u);
+    return false;
+}
+
+static struct io_uring_sqe *get_sqe(GipUring *u)
+{
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (u->sq_local_tail - head >= URING_ENTRIES)
+        return NULL;
+    unsigned idx = u->sq_local_tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    u->sq_local_tail++;
+    u->to_submit++;
+    u->stats.sqes++;
+    return sqe;
+}
+
+static void prep_rw(struct io_uring_sqe *sqe, uint8_t op, int fd, void *addr, uint32_t len, uint64_t data)
+{
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = (uint64_t)-1;   /* current position; ignored by streams */
+    sqe->user_data = data;
+}
+
+/* One syscall submits everything queued and optionally waits. */
+static int flush(GipUring *u, unsigned min_complete)
+{
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned n = u->to_submit;
+    if (!n && !min_complete)
+        return 0;
+    int r = sys_enter(u, n, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+    if (r >= 0)
+        u->to_submit -= (unsigned)r < n ? (unsigned)r : n;
+    return r;
+}
+
+/* ---- framing ---- */
+
+static void queue_frame(GipUring *u, uint64_t device_id, uint8_t cmd, uint8_t flags, uint8_t seq,
+                        const uint8_t *payload, uint32_t len)
+{
+    if (u->inbound_count == INBOUND_MAX || len > FRAME_MAX - sizeof(GipHeader)) {
+        u->stats.dropped++;
+        return;
+    }
+    RawFrame *f = &u->inbound[u->inbound_count++];
+    GipHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.deviceId = device_id;
+    hdr.commandId = cmd;
+    hdr.clientFlags = flags;
+    hdr.sequence = seq;
+    hdr.length = len;
+    memcpy(f->data, &hdr, sizeof(hdr));
+    if (len)
+        memcpy(f->data + sizeof(hdr), payload, len);
+    f->len = (uint32_t)sizeof(hdr) + len;
+}
+
+/* Returns the header size, 0 if more bytes are needed. */
+static uint32_t raw_header(const uint8_t *p, uint32_t n, uint32_t *len)
+{
+    if (n < 4)
+        return 0;
+    if (!(p[3] & 0x80)) {
+        *len = p[3];
+        return 4;
+    }
+    if (n < 5)
+        return 0;
+    *len = (uint32_t)(p[3] & 0x7F) | ((uint32_t)p[4] << 7);
+    return 5;
+}
+
+static uint32_t raw_encode(uint8_t *out, const GipHeader *hdr, const uint8_t *payload)
+{
+    uint32_t h = 3;
+    out[0] = hdr->commandId;
+    out[1] = hdr->clientFlags;
+    out[2] = hdr->sequence;
+    if (hdr->length < 0x80) {
+        out[h++] = (uint8_t)hdr->length;
+    } else {
+        out[h++] = (uint8_t)(hdr->length | 0x80);
+        out[h++] = (uint8_t)(hdr->length >> 7);
+    }
+    memcpy(out + h, payload, hdr->length);
+    return h + hdr->length;
+}
+
+static void parse_raw(GipUring *u, RawDev *d)
+{
+    uint32_t off = 0, len = 0, h;
+    while ((h = raw_header(d->acc + off, d->have - off, &len)) != 0 && d->have - off - h >= len) {
+        const uint8_t *p = d->acc + off;
+        queue_frame(u, d->device_id, p[0], p[1], p[2], p + h, len);
+        off += h + len;
+    }
+    memmove(d->acc, d->acc + off, d->have - off);
+    d->have -= off;
+}
+
+/* ---- request handling ---- */
+
+static void post_dev_read(GipUring *u, RawDev *d)
+{
+    if (!d->alive || d->reading)
+        return;
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe)
+        return;
+    prep_rw(sqe, IORING_OP_READ, d->fd, d->rbuf, sizeof(d->rbuf), USER_DATA(TAG_READ, d - u->devs));
+    d->reading = true;
+}
+
+static void post_wake_read(GipUring *u)
+{
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (sqe)
+        prep_rw(sqe, IORING_OP_READ, u->wake_fd, &u->wake_val, sizeof(u->wake_val), USER_DATA(TAG_WAKE, 0));
+}
+
+static void device_gone(GipUring *u, RawDev *d)
+{
+    uint8_t status = 0;
+    d->alive = false;
+    queue_frame(u, d->device_id, GIP_CMD_STATUS, GIP_OPT_INTERNAL, 0, &status, 1);
+}
+
+static uint8_t map_status(int res)
+{
+    if (res == -ENODEV || res == -EPIPE || res == -ESHUTDOWN || res == -EBADF)
+        return GIP_IO_GONE;
+    if (res == -ECANCELED)
+        return GIP_IO_CANCELLED;
+    return GIP_IO_FAILED;
+}
+
+static void handle_cqe(GipUring *u, const struct io_uring_cqe *cqe)
+{
+    uint32_t tag = (uint32_t)(cqe->user_data >> 32);
+    uint32_t idx = (uint32_t)cqe->user_data;
+    u->stats.cqes++;
+
+    if (tag == TAG_READ && idx < (uint32_t)u->dev_count) {
+        RawDev *d = &u->devs[idx];
+        d->reading = false;
+        if (cqe->res == -EAGAIN || cqe->res == -EINTR) {
+            post_dev_read(u, d);
+        } else if (cqe->res <= 0) {
+            device_gone(u, d);
+        } else {
+            uint32_t n = (uint32_t)cqe->res;
+            if (d->have + n > sizeof(d->acc))
+                d->have = 0;   /* garbage on the line; resync */
+            memcpy(d->acc + d->have, d->rbuf, n);
+            d->have += n;
+            parse_raw(u, d);
+            post_dev_read(u, d);
+        }
+    } else if (tag == TAG_WRITE && idx < GIP_MAX_INFLIGHT) {
+        RawWrite *w = &u->writes[idx];
+        GipCompletion *c = &u->done[u->done_count++];
+        memset(c, 0, sizeof(*c));
+        c->user = w->user;
+        c->kind = GIP_IO_WRITE;
+        if (cqe->res < 0) {
+            c->status = map_status(cqe->res);
+            c->error = (uint32_t)-cqe->res;
+        } else {
+            c->status = GIP_IO_OK;
+            c->bytes = w->len;
+        }
+        w->used = false;
+    } else if (tag == TAG_WAKE) {
+        u->woken = true;
+        if (cqe->res > 0 || cqe->res == -EAGAIN || cqe->res == -EINTR)
+            post_wake_read(u);
+    }
+}
+
+static void reap(GipUring *u)
+{
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        handle_cqe(u, &u->cqes[head & *u->cq_mask]);
+        head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int collect(GipUring *u, GipCompletion *out, int max)
+{
+    int n = 0;
+    while (n < max && u->done_count > 0) {
+        out[n++] = u->done[0];
+        memmove(u->done, u->done + 1, (size_t)--u->done_count * sizeof(u->done[0]));
+    }
+    while (n < max && u->read_count > 0 && u->inbound_count > 0) {
+        RawRead *r = &u->reads[0];
+        RawFrame *f = &u->inbound[0];
+        uint32_t bytes = f->len < r->len ? f->len : r->len;
+        memcpy(r->buf, f->data, bytes);
+
+        GipCompletion *c = &out[n++];
+        memset(c, 0, sizeof(*c));
+        c->user = r->user;
+        c->kind = GIP_IO_READ;
+        c->status = GIP_IO_OK;
+        c->bytes = bytes;
+        memmove(u->reads, u->reads + 1, (size_t)--u->read_count * sizeof(u->reads[0]));
+        memmove(u->inbound, u->inbound + 1, (size_t)--u->inbound_count * sizeof(u->inbound[0]));
+    }
+    return n;
+}
+
+/* ---- transport ops ---- */
+
+static bool uring_open(void *self, uint32_t *err)
+{
+    GipUring *u = (GipUring *)self;
+    if (!ring_setup(u, err))
+        return false;
+    u->open = true;
+    post_wake_read(u);
+    for (int i = 0; i < u->dev_count; i++) {
+        u->devs[i].reading = false;
+        u->devs[i].have = 0;
+        post_dev_read(u, &u->devs[i]);
+    }
+    return true;
+}
+
+/* Raw devices have no reenumerate; answer with an announce for every
+   descriptor that is still readable. */
+static bool uring_ioctl(void *self, uint32_t code)
+{
+    GipUring *u = (GipUring *)self;
+    if (!u->open || code != GIP_REENUMERATE)
+        return false;
+    for (int i = 0; i < u->dev_count; i++) {
+        if (u->devs[i].alive)
+            queue_frame(u, u->devs[i].device_id, GIP_CMD_ANNOUNCE, GIP_OPT_INTERNAL, 0, NULL, 0);
+    }
+    return true;
+}
+
+static bool uring_read(void *self, void *buf, uint32_t len, void *user)
+{
+    GipUring *u = (GipUring *)self;
+    if (!u->open || u->read_count == GIP_MAX_INFLIGHT)
+        return false;
+    RawRead *r = &u->reads[u->read_count++];
+    r->user = user;
+    r->buf = (uint8_t *)buf;
+    r->len = len;
+    return true;
+}
+
+static bool uring_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    GipUring *u = (GipUring *)self;
+    if (!u->open)
+        return false;
+
+    GipHeader hdr = { 0 };
+    const uint8_t *p = (const uint8_t *)buf;
+    RawDev *dev = NULL;
+    if (len >= sizeof(hdr)) {
+        memcpy(&hdr, p, sizeof(hdr));
+        for (int i = 0; i < u->dev_count && !dev; i++) {
+            if (u->devs[i].device_id == hdr.deviceId && u->devs[i].alive)
+                dev = &u->devs[i];
+        }
+    }
+
+    RawWrite *w = NULL;
+    int slot = 0;
+    for (; slot < GIP_MAX_INFLIGHT && !w; slot++) {
+        if (!u->writes[slot].used)
+            w = &u->writes[slot];
+    }
+    if (!w || u->done_count == GIP_MAX_INFLIGHT)
+        return false;
+    slot--;
+
+    if (!dev || hdr.length > 255 || sizeof(hdr) + hdr.length > len) {
+        GipCompletion *c = &u->done[u->done_count++];
+        memset(c, 0, sizeof(*c));
+        c->user = user;
+        c->kind = GIP_IO_WRITE;
+        c->status = dev ? GIP_IO_FAILED : GIP_IO_GONE;
+        c->error = dev ? EINVAL : ENODEV;
+        return true;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe)
+        return false;
+    w->used = true;
+    w->user = user;
+    w->len = len;
+    uint32_t raw_len = raw_encode(w->buf, &hdr, p + sizeof(hdr));
+    prep_rw(sqe, IORING_OP_WRITE, dev->fd, w->buf, raw_len, USER_DATA(TAG_WRITE, slot));
+    if (hdr.commandId == GIP_CMD_LED)
+        u->stats.led_writes++;
+    return true;
+}
+
+static int uring_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    GipUring *u = (GipUring *)self;
+    if (!u->open)
+        return 0;
+    uint64_t deadline = timeout_ms == GIP_WAIT_INFINITE
+        ? UINT64_MAX
+        : xbox_time_ns() + timeout_ms * 1000000ull;
+
+    for (;;) {
+        reap(u);
+        int n = collect(u, out, max);
+        bool woken = u->woken;
+        u->woken = false;
+        uint64_t now = xbox_time_ns();
+        if (n > 0 || woken || now >= deadline) {
+            flush(u, 0);
+            return n;
+        }
+
+        /* The timeout also fires on the first other completion, so it
+           never holds the wait open past real work. */
+        if (deadline != UINT64_MAX) {
+            struct io_uring_sqe *sqe = get_sqe(u);
+            if (sqe) {
+                uint64_t left = deadline - now;
+                u->timeout.tv_sec = (int64_t)(left / 1000000000ull);
+                u->timeout.tv_nsec = (long long)(left % 1000000000ull);
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->fd = -1;
+                sqe->addr = (uint64_t)(uintptr_t)&u->timeout;
+                sqe->len = 1;
+                sqe->off = 1;
+                sqe->user_data = USER_DATA(TAG_TIMEOUT, 0);
+            }
+        }
+        if (flush(u, 1) < 0 && errno != EINTR && errno != EBUSY)
+            return 0;
+    }
+}
+
+static void uring_wake(void *self)
+{
+    GipUring *u = (GipUring *)self;
+    uint64_t one = 1;
+    if (write(u->wake_fd, &one, sizeof(one)) < 0)
+        return;
+}
+
+static void queue_cancel(GipUring *u, uint8_t op, uint64_t target)
+{
+    struct io_uring_sqe *sqe = get_sqe(u);
+    if (!sqe) {
+        flush(u, 0);
+        sqe = get_sqe(u);
+    }
+    if (!sqe)
+        return;
+    sqe->opcode = op;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = USER_DATA(TAG_CANCEL, 0);
+}
+
+/* Closing the ring fd does not wait for the kernel to let go of the
+   buffers, so every request still in flight is cancelled and its
+   completion reaped first. Each SQE yields exactly one CQE. */
+static void cancel_inflight(GipUring *u)
+{
+    for (int i = 0; i < u->dev_count; i++) {
+        if (u->devs[i].reading)
+            queue_cancel(u, IORING_OP_ASYNC_CANCEL, USER_DATA(TAG_READ, i));
+    }
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++) {
+        if (u->writes[i].used)
+            queue_cancel(u, IORING_OP_ASYNC_CANCEL, USER_DATA(TAG_WRITE, i));
+    }
+    queue_cancel(u, IORING_OP_ASYNC_CANCEL, USER_DATA(TAG_WAKE, 0));
+    queue_cancel(u, IORING_OP_TIMEOUT_REMOVE, USER_DATA(TAG_TIMEOUT, 0));
+
+    while (u->stats.cqes != u->stats.sqes) {
+        if (flush(u, 1) < 0 && errno != EINTR && errno != EBUSY)
+            break;
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        u->stats.cqes += tail - head;
+        __atomic_store_n(u->cq_head, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void uring_close(void *self)
+{
+    GipUring *u = (GipUring *)self;
+    if (!u->open)
+        return;
+    cancel_inflight(u);
+    ring_destroy(u);
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++)
+        u->writes[i].used = false;
+    for (int i = 0; i < u->dev_count; i++)
+        u->devs[i].reading = false;
+    u->read_count = 0;
+    u->inbound_count = 0;
+    u->done_count = 0;
+    u->woken = false;
+    u->open = false;
+}
+
+static uint64_t uring_dropped(void *self)
+{
+    return ((GipUring *)self)->stats.dropped;
+}
+
+static void uring_destroy(void *self)
+{
+    GipUring *u = (GipUring *)self;
+    uring_close(u);
+    close(u->wake_fd);
+    free(u->devs);
+    free(u);
+}
+
+static const GipTransportOps URING_OPS = {
+    "raw GIP",
+    uring_open,
+    uring_ioctl,
+    uring_read,
+    uring_write,
+    uring_poll,
+    uring_wake,
+    uring_close,
+    uring_destroy,
+    uring_dropped,
+};
+
+GipTransport gip_transport_uring_create(const int *fds, int count)
+{
+    GipTransport t = { NULL, NULL };
+    if (count < 0 || count > XBOX_MAX_DEVICES)
+        return t;
+    GipUring *u = (GipUring *)calloc(1, sizeof(*u));
+    if (!u)
+        return t;
+    u->devs = (RawDev *)calloc(count ? (size_t)count : 1, sizeof(RawDev));
+    u->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (!u->devs || u->wake_fd < 0) {
+        if (u->wake_fd >= 0)
+            close(u->wake_fd);
+        free(u->devs);
+        free(u);
+        return t;
+    }
+    u->ring_fd = -1;
+    u->dev_count = count;
+    for (int i = 0; i < count; i++) {
+        u->devs[i].fd = fds[i];
+        u->devs[i].device_id = RAW_DEVICE_BASE | (uint64_t)(i + 1);
+        u->devs[i].alive = true;
+    }
+    t.ops = &URING_OPS;
+    t.self = u;
+    return t;
+}
+
+void gip_uring_stats(GipTransport t, GipUringStats *out)
+{
+    if (t.ops != &URING_OPS) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = ((GipUring *)t.self)->stats;
+}
+
+#endif /* __linux__ */
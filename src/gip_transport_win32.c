@@ -0,0 +1,215 @@
+#include "gip_transport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef struct {
+    OVERLAPPED ov;
+    void      *user;
+    uint8_t    kind;
+    bool       busy;
+    DWORD      sync_error;
+} Win32Io;
+
+typedef struct {
+    HANDLE  handle;
+    HANDLE  wake;
+    Win32Io io[GIP_MAX_INFLIGHT];
+} GipWin32;
+
+static Win32Io *claim_io(GipWin32 *t)
+{
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++) {
+        if (!t->io[i].busy)
+            return &t->io[i];
+    }
+    return NULL;
+}
+
+static uint8_t map_status(DWORD err)
+{
+    switch (err) {
+    case ERROR_SUCCESS:              return GIP_IO_OK;
+    case ERROR_OPERATION_ABORTED:    return GIP_IO_CANCELLED;
+    case ERROR_DEVICE_NOT_CONNECTED:
+    case ERROR_DEV_NOT_EXIST:
+    case ERROR_INVALID_HANDLE:       return GIP_IO_GONE;
+    default:                         return GIP_IO_FAILED;
+    }
+}
+
+static bool win32_open(void *self, uint32_t *err)
+{
+    GipWin32 *t = (GipWin32 *)self;
+    HANDLE h = CreateFileW(L"\\\\.\\XboxGIP",
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+        NULL);
+
+    if (h == INVALID_HANDLE_VALUE) {
+        *err = GetLastError();
+        return false;
+    }
+    t->handle = h;
+    return true;
+}
+
+static bool win32_ioctl(void *self, uint32_t code)
+{
+    GipWin32 *t = (GipWin32 *)self;
+    DWORD bytes = 0;
+    return DeviceIoControl(t->handle, code, NULL, 0, NULL, 0, &bytes, NULL) != FALSE;
+}
+
+static bool win32_submit(GipWin32 *t, uint8_t kind, void *buf, uint32_t len, void *user)
+{
+    if (!t->handle)
+        return false;
+    Win32Io *io = claim_io(t);
+    if (!io)
+        return false;
+
+    HANDLE ev = io->ov.hEvent;
+    memset(&io->ov, 0, sizeof(io->ov));
+    io->ov.hEvent = ev;
+    io->user = user;
+    io->kind = kind;
+    io->busy = true;
+    io->sync_error = ERROR_SUCCESS;
+
+    BOOL ok = kind == GIP_IO_READ
+        ? ReadFile(t->handle, buf, len, NULL, &io->ov)
+        : WriteFile(t->handle, buf, len, NULL, &io->ov);
+    if (!ok) {
+        DWORD err = GetLastError();
+        if (err != ERROR_IO_PENDING) {
+            /* Report it through poll like any other completion. */
+            io->sync_error = err;
+            SetEvent(ev);
+        }
+    }
+    return true;
+}
+
+static bool win32_read(void *self, void *buf, uint32_t len, void *user)
+{
+    return win32_submit((GipWin32 *)self, GIP_IO_READ, buf, len, user);
+}
+
+static bool win32_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    return win32_submit((GipWin32 *)self, GIP_IO_WRITE, (void *)buf, len, user);
+}
+
+static int win32_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    GipWin32 *t = (GipWin32 *)self;
+    HANDLE waits[GIP_MAX_INFLIGHT + 1];
+    int    slots[GIP_MAX_INFLIGHT + 1];
+    DWORD  n = 0;
+
+    waits[n] = t->wake;
+    slots[n++] = -1;
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++) {
+        if (t->io[i].busy) {
+            waits[n] = t->io[i].ov.hEvent;
+            slots[n++] = i;
+        }
+    }
+
+    DWORD r = WaitForMultipleObjects(n, waits, FALSE,
+        timeout_ms == GIP_WAIT_INFINITE ? INFINITE : timeout_ms);
+    if (r == WAIT_TIMEOUT || r == WAIT_FAILED)
+        return 0;
+
+    int count = 0;
+    for (DWORD k = 1; k < n && count < max; k++) {
+        Win32Io *io = &t->io[slots[k]];
+        if (io->sync_error == ERROR_SUCCESS && !HasOverlappedIoCompleted(&io->ov))
+            continue;
+
+        GipCompletion *c = &out[count++];
+        DWORD bytes = 0;
+        DWORD err = io->sync_error;
+        if (err == ERROR_SUCCESS && !GetOverlappedResult(t->handle, &io->ov, &bytes, FALSE))
+            err = GetLastError();
+
+        c->user = io->user;
+        c->kind = io->kind;
+        c->bytes = bytes;
+        c->error = err;
+        c->status = map_status(err);
+        io->busy = false;
+    }
+    return count;
+}
+
+static void win32_wake(void *self)
+{
+    SetEvent(((GipWin32 *)self)->wake);
+}
+
+static void win32_close(void *self)
+{
+    GipWin32 *t = (GipWin32 *)self;
+    if (!t->handle)
+        return;
+
+    CancelIoEx(t->handle, NULL);
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++) {
+        Win32Io *io = &t->io[i];
+        if (!io->busy)
+            continue;
+        if (io->sync_error == ERROR_SUCCESS) {
+            DWORD bytes = 0;
+            GetOverlappedResult(t->handle, &io->ov, &bytes, TRUE);
+        }
+        io->busy = false;
+    }
+    CloseHandle(t->handle);
+    t->handle = NULL;
+}
+
+static void win32_destroy(void *self)
+{
+    GipWin32 *t = (GipWin32 *)self;
+    win32_close(t);
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++)
+        CloseHandle(t->io[i].ov.hEvent);
+    CloseHandle(t->wake);
+    free(t);
+}
+
+static const GipTransportOps WIN32_OPS = {
+    "XboxGIP",
+    win32_open,
+    win32_ioctl,
+    win32_read,
+    win32_write,
+    win32_poll,
+    win32_wake,
+    win32_close,
+    win32_destroy,
+    NULL,
+};
+
+GipTransport gip_transport_win32_create(void)
+{
+    GipTransport tr = { NULL, NULL };
+    GipWin32 *t = (GipWin32 *)calloc(1, sizeof(*t));
+    if (!t)
+        return tr;
+
+    t->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    for (int i = 0; i < GIP_MAX_INFLIGHT; i++)
+        t->io[i].ov.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    tr.ops = &WIN32_OPS;
+    tr.self = t;
+    return tr;
+}
@@ -0,0 +1,380 @@
+#ifdef __linux__
+
+#include "gip_transport.h"
+#include "gip_protocol.h"
+#include "xbox_led.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/*
+ * Speaks GIP to XboxController on top of the LED class devices that the
+ * xone driver registers (gip*:white:status, etc.). Reenumerating rescans
+ * the tree and answers with one announce per LED node; LED frames become
+ * pwrite()s of the mode and brightness attributes on descriptors that stay
+ * open for the life of the session.
+ */
+
+#define XONE_DEFAULT_ROOT "/sys/class/leds"
+#define XONE_MAX_LEDS     XBOX_MAX_DEVICES
+#define XONE_FRAME_MAX    64
+
+typedef struct {
+    char     name[NAME_MAX + 1];   /* a d_name fits whole */
+    uint64_t device_id;
+    int      brightness_fd;
+    int      mode_fd;        /* -1 when the driver has no mode attribute */
+    unsigned max_brightness;
+    bool     seen;
+} XoneLed;
+
+typedef struct {
+    void    *user;
+    uint8_t *buf;
+    uint32_t len;
+} XoneRead;
+
+typedef struct {
+    uint8_t  data[XONE_FRAME_MAX];
+    uint32_t len;
+} XoneFrame;
+
+typedef struct {
+    char          root[256];
+    bool          open;
+    int           wake_fd;
+    XoneLed       leds[XONE_MAX_LEDS];
+    int           led_count;
+    XoneRead      reads[GIP_MAX_INFLIGHT];
+    int           read_count;
+    XoneFrame     inbound[GIP_MAX_INFLIGHT];
+    int           inbound_count;
+    GipCompletion done[GIP_MAX_INFLIGHT];
+    int           done_count;
+} GipXone;
+
+/* Stable per node name, so a rescan maps a node to the same device. */
+static uint64_t name_id(const char *name)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (const char *p = name; *p; p++)
+        h = (h ^ (uint8_t)*p) * 1099511628211ull;
+    return h;
+}
+
+static int open_attr(const char *root, const char *name, const char *attr, int flags)
+{
+    char path[PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s/%s", root, name, attr);
+    if (n < 0 || (size_t)n >= sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return open(path, flags | O_CLOEXEC);
+}
+
+static unsigned read_max_brightness(const char *root, const char *name)
+{
+    char buf[32] = { 0 };
+    int fd = open_attr(root, name, "max_brightness", O_RDONLY);
+    if (fd < 0)
+        return LED_BRIGHTNESS_MAX;
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+    unsigned v = n > 0 ? (unsigned)strtoul(buf, NULL, 10) : 0;
+    return v ? v : LED_BRIGHTNESS_MAX;
+}
+
+static void close_led(XoneLed *led)
+{
+    if (led->brightness_fd >= 0)
+        close(led->brightness_fd);
+    if (led->mode_fd >= 0)
+        close(led->mode_fd);
+    led->brightness_fd = -1;
+    led->mode_fd = -1;
+}
+
+static XoneLed *find_led(GipXone *x, uint64_t id)
+{
+    for (int i = 0; i < x->led_count; i++) {
+        if (x->leds[i].device_id == id)
+            return &x->leds[i];
+    }
+    return NULL;
+}
+
+static void queue_inbound(GipXone *x, uint64_t device_id, uint8_t cmd,
+                          const uint8_t *payload, uint32_t len)
+{
+    if (x->inbound_count == GIP_MAX_INFLIGHT)
+        return;
+    XoneFrame *f = &x->inbound[x->inbound_count++];
+    GipHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.deviceId = device_id;
+    hdr.commandId = cmd;
+    hdr.clientFlags = GIP_OPT_INTERNAL;
+    hdr.length = len;
+    memcpy(f->data, &hdr, sizeof(hdr));
+    if (len)
+        memcpy(f->data + sizeof(hdr), payload, len);
+    f->len = sizeof(hdr) + len;
+}
+
+/* A status with the connected bit clear, as the driver sends on unplug. */
+static void queue_gone(GipXone *x, uint64_t device_id)
+{
+    uint8_t status = 0;
+    queue_inbound(x, device_id, GIP_CMD_STATUS, &status, 1);
+}
+
+/* Keeps descriptors of nodes that are still there and drops the rest,
+   reporting each dropped one as unplugged while the session is open. */
+static bool scan(GipXone *x, uint32_t *err)
+{
+    DIR *dir = opendir(x->root);
+    if (!dir) {
+        if (err)
+            *err = (uint32_t)errno;
+        return false;
+    }
+    for (int i = 0; i < x->led_count; i++)
+        x->leds[i].seen = false;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "gip", 3) != 0)
+            continue;
+        XoneLed *led = find_led(x, name_id(de->d_name));
+        if (!led) {
+            if (x->led_count == XONE_MAX_LEDS)
+                continue;
+            int bfd = open_attr(x->root, de->d_name, "brightness", O_WRONLY);
+            if (bfd < 0)
+                continue;
+            led = &x->leds[x->led_count++];
+            memset(led, 0, sizeof(*led));
+            snprintf(led->name, sizeof(led->name), "%s", de->d_name);
+            led->device_id = name_id(de->d_name);
+            led->brightness_fd = bfd;
+            led->mode_fd = open_attr(x->root, de->d_name, "mode", O_WRONLY);
+            led->max_brightness = read_max_brightness(x->root, de->d_name);
+        }
+        led->seen = true;
+    }
+    closedir(dir);
+
+    for (int i = 0; i < x->led_count;) {
+        if (x->leds[i].seen) {
+            i++;
+            continue;
+        }
+        if (x->open)
+            queue_gone(x, x->leds[i].device_id);
+        close_led(&x->leds[i]);
+        x->leds[i] = x->leds[--x->led_count];
+    }
+    return true;
+}
+
+static bool write_attr(int fd, unsigned value)
+{
+    char buf[16];
+    int n = snprintf(buf, sizeof(buf), "%u\n", value);
+    return pwrite(fd, buf, (size_t)n, 0) == n;
+}
+
+static bool xone_open(void *self, uint32_t *err)
+{
+    GipXone *x = (GipXone *)self;
+    if (!scan(x, err))
+        return false;
+    x->open = true;
+    return true;
+}
+
+static bool xone_ioctl(void *self, uint32_t code)
+{
+    GipXone *x = (GipXone *)self;
+    if (!x->open || code != GIP_REENUMERATE || !scan(x, NULL))
+        return false;
+    for (int i = 0; i < x->led_count; i++)
+        queue_inbound(x, x->leds[i].device_id, GIP_CMD_ANNOUNCE, NULL, 0);
+    return true;
+}
+
+static int inflight(const GipXone *x)
+{
+    return x->read_count + x->done_count;
+}
+
+static bool xone_read(void *self, void *buf, uint32_t len, void *user)
+{
+    GipXone *x = (GipXone *)self;
+    if (!x->open || inflight(x) >= GIP_MAX_INFLIGHT)
+        return false;
+    XoneRead *r = &x->reads[x->read_count++];
+    r->user = user;
+    r->buf = (uint8_t *)buf;
+    r->len = len;
+    return true;
+}
+
+static bool xone_write(void *self, const void *buf, uint32_t len, void *user)
+{
+    GipXone *x = (GipXone *)self;
+    if (!x->open || inflight(x) >= GIP_MAX_INFLIGHT)
+        return false;
+
+    GipCompletion *c = &x->done[x->done_count++];
+    memset(c, 0, sizeof(*c));
+    c->user = user;
+    c->kind = GIP_IO_WRITE;
+
+    GipHeader hdr;
+    const uint8_t *p = (const uint8_t *)buf;
+    XoneLed *led = NULL;
+    if (len >= sizeof(hdr)) {
+        memcpy(&hdr, p, sizeof(hdr));
+        led = find_led(x, hdr.deviceId);
+    }
+    if (!led || hdr.commandId != GIP_CMD_LED || hdr.length < 3 || sizeof(hdr) + 3 > len) {
+        c->status = GIP_IO_FAILED;
+        c->error = EINVAL;
+        return true;
+    }
+
+    uint8_t mode = p[sizeof(hdr) + 1];
+    unsigned level = p[sizeof(hdr) + 2];
+    if (level > LED_BRIGHTNESS_MAX)
+        level = LED_BRIGHTNESS_MAX;
+    level = (level * led->max_brightness + LED_BRIGHTNESS_MAX / 2) / LED_BRIGHTNESS_MAX;
+    if (mode == LED_MODE_OFF)
+        level = 0;
+
+    bool ok = (led->mode_fd < 0 || write_attr(led->mode_fd, mode))
+           && write_attr(led->brightness_fd, level);
+    if (!ok) {
+        /* The node goes away with the controller; report it like the
+           Windows driver reports a detached device. */
+        c->error = (uint32_t)errno;
+        c->status = (errno == ENODEV || errno == ENOENT) ? GIP_IO_GONE : GIP_IO_FAILED;
+        if (c->status == GIP_IO_GONE)
+            queue_gone(x, led->device_id);
+        return true;
+    }
+    c->status = GIP_IO_OK;
+    c->bytes = len;
+    return true;
+}
+
+static int collect(GipXone *x, GipCompletion *out, int max)
+{
+    int n = 0;
+    while (n < max && x->done_count > 0) {
+        out[n++] = x->done[0];
+        memmove(x->done, x->done + 1, (size_t)--x->done_count * sizeof(x->done[0]));
+    }
+    while (n < max && x->read_count > 0 && x->inbound_count > 0) {
+        XoneRead *r = &x->reads[0];
+        XoneFrame *f = &x->inbound[0];
+        uint32_t bytes = f->len < r->len ? f->len : r->len;
+        memcpy(r->buf, f->data, bytes);
+
+        GipCompletion *c = &out[n++];
+        memset(c, 0, sizeof(*c));
+        c->user = r->user;
+        c->kind = GIP_IO_READ;
+        c->status = GIP_IO_OK;
+        c->bytes = bytes;
+        memmove(x->reads, x->reads + 1, (size_t)--x->read_count * sizeof(x->reads[0]));
+        memmove(x->inbound, x->inbound + 1, (size_t)--x->inbound_count * sizeof(x->inbound[0]));
+    }
+    return n;
+}
+
+static int xone_poll(void *self, GipCompletion *out, int max, uint32_t timeout_ms)
+{
+    GipXone *x = (GipXone *)self;
+    int n = collect(x, out, max);
+    if (n > 0)
+        return n;
+
+    struct pollfd pfd = { x->wake_fd, POLLIN, 0 };
+    int timeout = timeout_ms == GIP_WAIT_INFINITE ? -1 : (int)timeout_ms;
+    if (poll(&pfd, 1, timeout) > 0) {
+        uint64_t v;
+        if (read(x->wake_fd, &v, sizeof(v)) < 0)
+            return 0;
+    }
+    return collect(x, out, max);
+}
+
+static void xone_wake(void *self)
+{
+    GipXone *x = (GipXone *)self;
+    uint64_t one = 1;
+    if (write(x->wake_fd, &one, sizeof(one)) < 0)
+        return;
+}
+
+static void xone_close(void *self)
+{
+    GipXone *x = (GipXone *)self;
+    for (int i = 0; i < x->led_count; i++)
+        close_led(&x->leds[i]);
+    x->led_count = 0;
+    x->read_count = 0;
+    x->inbound_count = 0;
+    x->done_count = 0;
+    x->open = false;
+}
+
+static void xone_destroy(void *self)
+{
+    GipXone *x = (GipXone *)self;
+    xone_close(x);
+    close(x->wake_fd);
+    free(x);
+}
+
+static const GipTransportOps XONE_OPS = {
+    "xone",
+    xone_open,
+    xone_ioctl,
+    xone_read,
+    xone_write,
+    xone_poll,
+    xone_wake,
+    xone_close,
+    xone_destroy,
+    NULL,
+};
+
+GipTransport gip_transport_xone_create(const char *sysfs_root)
+{
+    GipTransport t = { NULL, NULL };
+    GipXone *x = (GipXone *)calloc(1, sizeof(*x));
+    if (!x)
+        return t;
+    x->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (x->wake_fd < 0) {
+        free(x);
+        return t;
+    }
+    snprintf(x->root, sizeof(x->root), "%s", sysfs_root ? sysfs_root : XONE_DEFAULT_ROOT);
+    t.ops = &XONE_OPS;
+    t.self = x;
+    return t;
+}
+
+#endif /* __linux__ */
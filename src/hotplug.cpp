@@ -0,0 +1,133 @@
+#include "hotplug.h"
+
+#include <cctype>
+#include <cstring>
+
+/* GIP device interface class, as it appears in interface paths. */
+static const char GIP_INTERFACE_GUID[] = "{020bc73c-0dca-4ee3-96d5-ab006ada5938}";
+static const char MICROSOFT_VID[] = "vid_045e";
+
+/* Products that speak GIP over USB. Bluetooth controllers are plain HID
+   and have no GIP LED. */
+static const char *const CONTROLLER_PIDS[] = {
+    "pid_02d1", "pid_02dd",   /* Xbox One */
+    "pid_02e3", "pid_0b00",   /* Elite, Elite Series 2 */
+    "pid_02ea",               /* Xbox One S */
+    "pid_0b0a",               /* Adaptive */
+    "pid_0b12",               /* Xbox Series X|S */
+    "pid_02e6", "pid_02fe",   /* Xbox Wireless Adapter */
+};
+
+static bool ContainsNoCase(const char *s, const char *needle)
+{
+    size_t n = strlen(needle);
+    for (; *s; s++) {
+        size_t i = 0;
+        while (i < n && s[i] && tolower((unsigned char)s[i]) == needle[i])
+            i++;
+        if (i == n)
+            return true;
+    }
+    return false;
+}
+
+HotplugTracker::HotplugTracker()
+{
+    m_cfg.settle_ns = DEFAULT_SETTLE_NS;
+    m_cfg.max_delay_ns = DEFAULT_MAX_DELAY_NS;
+}
+
+HotplugTracker::HotplugTracker(const HotplugConfig &cfg) : m_cfg(cfg)
+{
+}
+
+HotplugSource HotplugTracker::Classify(const char *interface_path)
+{
+    if (!interface_path || !*interface_path)
+        return HOTPLUG_UNKNOWN;
+    if (ContainsNoCase(interface_path, GIP_INTERFACE_GUID))
+        return HOTPLUG_CONTROLLER;
+    if (!ContainsNoCase(interface_path, MICROSOFT_VID))
+        return HOTPLUG_OTHER;
+    for (const char *pid : CONTROLLER_PIDS) {
+        if (ContainsNoCase(interface_path, pid))
+            return HOTPLUG_CONTROLLER;
+    }
+    return HOTPLUG_VENDOR;
+}
+
+void HotplugTracker::Arm(Pending *p, uint64_t now_ns, bool immediate)
+{
+    if (p->armed) {
+        m_stats.coalesced++;
+    } else {
+        p->armed = true;
+        p->now = false;
+        p->first_ns = now_ns;
+        p->controller_ns = 0;
+    }
+    if (immediate && !p->controller_ns)
+        p->controller_ns = now_ns;
+    p->now = p->now || immediate;
+    p->last_ns = now_ns;
+}
+
+void HotplugTracker::Arrival(HotplugSource src, uint64_t now_ns)
+{
+    m_stats.events++;
+    if (src == HOTPLUG_CONTROLLER) {
+        Arm(&m_discover, now_ns, true);
+    } else if (src != HOTPLUG_OTHER && !m_present) {
+        /* With a controller present the session is open, and any further
+           controller announces itself without help. */
+        Arm(&m_discover, now_ns, false);
+    } else {
+        m_stats.filtered++;
+    }
+}
+
+void HotplugTracker::Removal(HotplugSource src, uint64_t now_ns)
+{
+    m_stats.events++;
+    if (m_present && src != HOTPLUG_OTHER)
+        Arm(&m_rescan, now_ns, false);
+    else
+        m_stats.filtered++;
+}
+
+uint64_t HotplugTracker::DueAt(const Pending &p) const
+{
+    if (p.now)
+        return p.controller_ns;
+    uint64_t settled = p.last_ns + m_cfg.settle_ns;
+    uint64_t cap = p.first_ns + m_cfg.max_delay_ns;
+    return settled < cap ? settled : cap;
+}
+
+uint64_t HotplugTracker::Deadline() const
+{
+    uint64_t due = 0;
+    if (m_discover.armed)
+        due = DueAt(m_discover);
+    if (m_rescan.armed && (!due || DueAt(m_rescan) < due))
+        due = DueAt(m_rescan);
+    return due;
+}
+
+unsigned HotplugTracker::Poll(uint64_t now_ns, uint64_t *arrival_ns)
+{
+    unsigned actions = 0;
+    if (m_discover.armed && now_ns >= DueAt(m_discover)) {
+        m_discover.armed = false;
+        if (arrival_ns)
+            *arrival_ns = m_discover.controller_ns;
+        m_stats.discovers++;
+        actions |= HOTPLUG_DISCOVER;
+    }
+    if (m_rescan.armed && now_ns >= DueAt(m_rescan)) {
+        m_rescan.armed = false;
+        m_stats.rescans++;
+        actions |= HOTPLUG_RESCAN;
+    }
+    return actions;
+}
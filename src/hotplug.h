@@ -0,0 +1,87 @@
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+#include <cstdint>
+
+/* What a device notification is known to be about. */
+enum HotplugSource {
+    HOTPLUG_CONTROLLER,   /* the GIP interface class, or a known controller or adapter PID */
+    HOTPLUG_VENDOR,       /* another VID 045E device: a hub, dock, mouse, unlisted model */
+    HOTPLUG_OTHER,        /* some other device, by its interface path */
+    HOTPLUG_UNKNOWN       /* no path, e.g. DBT_DEVNODES_CHANGED */
+};
+
+/* Actions returned by HotplugTracker::Poll. */
+#define HOTPLUG_DISCOVER 0x01   /* a controller may have arrived */
+#define HOTPLUG_RESCAN   0x02   /* a controller may have gone */
+
+struct HotplugConfig {
+    uint64_t settle_ns;      /* quiet time before acting on vague events */
+    uint64_t max_delay_ns;   /* a storm postpones an action by at most this */
+};
+
+struct HotplugStats {
+    uint64_t events;
+    uint64_t filtered;    /* could not concern a controller */
+    uint64_t coalesced;   /* folded into an action already pending */
+    uint64_t discovers;
+    uint64_t rescans;
+};
+
+/*
+ * Turns the device notifications the OS sends into the few controller
+ * operations that are worth doing. A controller arrival asks for discovery
+ * at once. Events for other vendors' devices are dropped. Other Microsoft
+ * devices and events without a path only count while they could matter:
+ * an arrival while no controller is present, a removal while one is.
+ * They are debounced until the bus has been quiet for settle_ns, but never
+ * past max_delay_ns after the first one, so a storm of N events costs at
+ * most one action per max_delay_ns.
+ *
+ * Not thread-safe; time is passed in by the caller, so it can be driven
+ * from a message loop or a synthetic clock.
+ */
+class HotplugTracker {
+public:
+    static constexpr uint64_t DEFAULT_SETTLE_NS    = 150000000ull;
+    static constexpr uint64_t DEFAULT_MAX_DELAY_NS = 1000000000ull;
+
+    HotplugTracker();
+    explicit HotplugTracker(const HotplugConfig &cfg);
+
+    static HotplugSource Classify(const char *interface_path);
+
+    void Arrival(HotplugSource src, uint64_t now_ns);
+    void Removal(HotplugSource src, uint64_t now_ns);
+    void SetControllerPresent(bool present) { m_present = present; }
+
+    /* Returns the actions due at now_ns. With HOTPLUG_DISCOVER, arrival_ns
+       gets the time of the first controller arrival it covers, or 0 if it
+       only covers events without a path. */
+    unsigned Poll(uint64_t now_ns, uint64_t *arrival_ns);
+
+    /* When Poll next has something to return; 0 if nothing is pending. */
+    uint64_t Deadline() const;
+
+    HotplugStats Stats() const { return m_stats; }
+
+private:
+    struct Pending {
+        bool     armed;
+        bool     now;        /* due at first_ns, no debounce */
+        uint64_t first_ns;
+        uint64_t controller_ns;   /* first HOTPLUG_CONTROLLER event, or 0 */
+        uint64_t last_ns;
+    };
+
+    void     Arm(Pending *p, uint64_t now_ns, bool immediate);
+    uint64_t DueAt(const Pending &p) const;
+
+    HotplugConfig m_cfg;
+    bool          m_present = false;
+    Pending       m_discover = {};
+    Pending       m_rescan = {};
+    HotplugStats  m_stats = {};
+};
+
+#endif /* HOTPLUG_H */
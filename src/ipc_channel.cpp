@@ -0,0 +1,343 @@
+#include "ipc_channel.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static const DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+static const DWORD PIPE_BUSY_WAIT_MS = 2000;
+
+IpcChannel::IpcChannel(HANDLE pipe)
+    : m_pipe(pipe),
+      m_read_ev(CreateEventW(nullptr, TRUE, FALSE, nullptr)),
+      m_write_ev(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+{
+}
+
+IpcChannel::~IpcChannel()
+{
+    CloseHandle(m_pipe);
+    CloseHandle(m_read_ev);
+    CloseHandle(m_write_ev);
+}
+
+/* Each direction has its own event so a blocked read never holds up a
+   write from the other thread, which a synchronous handle would. */
+bool IpcChannel::Transfer(bool write, void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0 && !m_shut) {
+        OVERLAPPED ov = {};
+        ov.hEvent = write ? m_write_ev : m_read_ev;
+        DWORD chunk = len > PIPE_BUFFER_SIZE ? PIPE_BUFFER_SIZE : (DWORD)len;
+        BOOL ok = write ? WriteFile(m_pipe, p, chunk, nullptr, &ov)
+                        : ReadFile(m_pipe, p, chunk, nullptr, &ov);
+        if (!ok && GetLastError() != ERROR_IO_PENDING)
+            return false;
+        if (m_shut)
+            CancelIoEx(m_pipe, &ov);
+        DWORD n = 0;
+        if (!GetOverlappedResult(m_pipe, &ov, &n, TRUE) || n == 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return len == 0;
+}
+
+bool IpcChannel::Read(void *buf, size_t len)
+{
+    return Transfer(false, buf, len);
+}
+
+bool IpcChannel::Write(const void *buf, size_t len)
+{
+    return Transfer(true, const_cast<void *>(buf), len);
+}
+
+void IpcChannel::Shutdown()
+{
+    m_shut = true;
+    CancelIoEx(m_pipe, nullptr);
+}
+
+IpcListener::~IpcListener()
+{
+    Close();
+    if (m_next != INVALID_HANDLE_VALUE)
+        CloseHandle(m_next);
+    if (m_stop_ev)
+        CloseHandle(m_stop_ev);
+}
+
+static HANDLE CreatePipeInstance(const char *name, bool first)
+{
+    DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+    if (first)
+        open_mode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+    return CreateNamedPipeA(name, open_mode,
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+}
+
+bool IpcListener::Listen(const char *name, std::string *err)
+{
+    /* The first instance claims the name, so a second daemon fails here.
+       One instance is kept listening from then on. */
+    m_next = CreatePipeInstance(name, true);
+    if (m_next == INVALID_HANDLE_VALUE) {
+        if (err) {
+            char buf[160];
+            snprintf(buf, sizeof(buf), "cannot create %s (error %lu)", name, GetLastError());
+            *err = buf;
+        }
+        return false;
+    }
+    m_name = name;
+    m_stop_ev = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    return true;
+}
+
+IpcChannel *IpcListener::Accept()
+{
+    while (!m_closed) {
+        HANDLE pipe = m_next;
+        m_next = CreatePipeInstance(m_name.c_str(), false);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        OVERLAPPED ov = {};
+        ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        BOOL ok = ConnectNamedPipe(pipe, &ov);
+        DWORD e = ok ? ERROR_SUCCESS : GetLastError();
+        if (e == ERROR_IO_PENDING) {
+            HANDLE waits[2] = { ov.hEvent, m_stop_ev };
+            DWORD n = 0;
+            if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0)
+                CancelIoEx(pipe, &ov);
+            e = GetOverlappedResult(pipe, &ov, &n, TRUE) ? ERROR_SUCCESS : GetLastError();
+        }
+        CloseHandle(ov.hEvent);
+
+        if ((e == ERROR_SUCCESS || e == ERROR_PIPE_CONNECTED) && !m_closed)
+            return new IpcChannel(pipe);
+        CloseHandle(pipe);
+    }
+    return nullptr;
+}
+
+void IpcListener::Close()
+{
+    m_closed = true;
+    if (m_stop_ev)
+        SetEvent(m_stop_ev);
+}
+
+IpcChannel *IpcConnect(const char *name, std::string *err)
+{
+    for (;;) {
+        HANDLE pipe = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE)
+            return new IpcChannel(pipe);
+        DWORD e = GetLastError();
+        if (e == ERROR_PIPE_BUSY && WaitNamedPipeA(name, PIPE_BUSY_WAIT_MS))
+            continue;
+        if (err) {
+            char buf[160];
+            snprintf(buf, sizeof(buf), "cannot connect to %s (error %lu)", name, e);
+            *err = buf;
+        }
+        return nullptr;
+    }
+}
+
+std::string IpcDefaultName()
+{
+    return "\\\\.\\pipe\\xbledctl";
+}
+
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+IpcChannel::IpcChannel(int fd) : m_fd(fd)
+{
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+IpcChannel::~IpcChannel()
+{
+    close(m_fd);
+}
+
+bool IpcChannel::Read(void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0 && !m_shut) {
+        ssize_t n = recv(m_fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return len == 0;
+}
+
+bool IpcChannel::Write(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0 && !m_shut) {
+        ssize_t n = send(m_fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return len == 0;
+}
+
+void IpcChannel::Shutdown()
+{
+    m_shut = true;
+    shutdown(m_fd, SHUT_RDWR);
+}
+
+IpcListener::~IpcListener()
+{
+    Close();
+    if (m_fd >= 0) {
+        close(m_fd);
+        unlink(m_name.c_str());
+    }
+}
+
+static int OpenSocket()
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+static bool FillAddress(const char *name, sockaddr_un *addr, std::string *err)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(name) >= sizeof(addr->sun_path)) {
+        if (err)
+            *err = std::string("socket path too long: ") + name;
+        return false;
+    }
+    strcpy(addr->sun_path, name);
+    return true;
+}
+
+bool IpcListener::Listen(const char *name, std::string *err)
+{
+    sockaddr_un addr;
+    if (!FillAddress(name, &addr, err))
+        return false;
+
+    /* A socket file nobody answers on is left over from a crash. */
+    int probe = OpenSocket();
+    if (probe >= 0 && connect(probe, (sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(probe);
+        if (err)
+            *err = std::string("another daemon is listening on ") + name;
+        return false;
+    }
+    if (probe >= 0)
+        close(probe);
+    unlink(name);
+
+    int fd = OpenSocket();
+    mode_t old_mask = umask(0077);
+    bool ok = fd >= 0 && bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, SOMAXCONN) == 0;
+    umask(old_mask);
+    if (!ok) {
+        if (err)
+            *err = std::string("cannot listen on ") + name + ": " + strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_name = name;
+    return true;
+}
+
+IpcChannel *IpcListener::Accept()
+{
+    while (!m_closed) {
+        int fd = accept(m_fd, nullptr, nullptr);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            if (!m_closed)
+                return new IpcChannel(fd);
+            close(fd);
+            break;
+        }
+        /* Out of descriptors: back off instead of spinning on the backlog. */
+        if (errno == EMFILE || errno == ENFILE)
+            poll(nullptr, 0, 10);
+    }
+    return nullptr;
+}
+
+void IpcListener::Close()
+{
+    m_closed = true;
+    if (m_fd >= 0)
+        shutdown(m_fd, SHUT_RDWR);
+}
+
+IpcChannel *IpcConnect(const char *name, std::string *err)
+{
+    sockaddr_un addr;
+    if (!FillAddress(name, &addr, err))
+        return nullptr;
+    int fd = OpenSocket();
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (err)
+            *err = std::string("cannot connect to ") + name + ": " + strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return nullptr;
+    }
+    return new IpcChannel(fd);
+}
+
+std::string IpcDefaultName()
+{
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir)
+        return std::string(dir) + "/xbledctl.sock";
+    char buf[64];
+    snprintf(buf, sizeof(buf), "/tmp/xbledctl-%u.sock", (unsigned)getuid());
+    return buf;
+}
+
+#endif
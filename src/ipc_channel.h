@@ -0,0 +1,80 @@
+#ifndef IPC_CHANNEL_H
+#define IPC_CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+/*
+ * Local byte stream between the daemon and one client: a Unix domain
+ * socket, or on Windows an overlapped named pipe instance so that one
+ * thread can read while another writes. Read and Write block until the
+ * whole buffer has moved; Shutdown makes pending and later calls fail.
+ */
+class IpcChannel {
+public:
+#ifdef _WIN32
+    explicit IpcChannel(HANDLE pipe);
+#else
+    explicit IpcChannel(int fd);
+#endif
+    ~IpcChannel();
+
+    IpcChannel(const IpcChannel &) = delete;
+    IpcChannel &operator=(const IpcChannel &) = delete;
+
+    bool Read(void *buf, size_t len);
+    bool Write(const void *buf, size_t len);
+    void Shutdown();
+
+private:
+#ifdef _WIN32
+    bool Transfer(bool write, void *buf, size_t len);
+
+    HANDLE m_pipe;
+    HANDLE m_read_ev;
+    HANDLE m_write_ev;
+#else
+    int    m_fd;
+#endif
+    std::atomic<bool> m_shut{false};
+};
+
+class IpcListener {
+public:
+    IpcListener() = default;
+    ~IpcListener();
+
+    IpcListener(const IpcListener &) = delete;
+    IpcListener &operator=(const IpcListener &) = delete;
+
+    bool Listen(const char *name, std::string *err);
+    /* Blocks until a client connects; nullptr once Close() was called. */
+    IpcChannel *Accept();
+    void Close();
+
+private:
+    std::string       m_name;
+    std::atomic<bool> m_closed{false};
+#ifdef _WIN32
+    HANDLE            m_stop_ev = nullptr;
+    HANDLE            m_next = INVALID_HANDLE_VALUE;   /* instance waiting for the next client */
+#else
+    int               m_fd = -1;
+#endif
+};
+
+IpcChannel *IpcConnect(const char *name, std::string *err);
+
+/* \\.\pipe\xbledctl on Windows; $XDG_RUNTIME_DIR/xbledctl.sock, or a
+   per-user path in /tmp, elsewhere. */
+std::string IpcDefaultName();
+
+#endif /* IPC_CHANNEL_H */
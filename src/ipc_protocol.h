@@ -0,0 +1,85 @@
+#ifndef IPC_PROTOCOL_H
+#define IPC_PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * Wire protocol between xbledctld and its clients, over a Unix domain
+ * socket or a named pipe. Every message is an IpcHeader followed by an
+ * op-specific body; integers are little-endian and structs are packed.
+ *
+ * Clients may pipeline: requests are executed in the order they are sent
+ * on a connection, and each reply echoes the request id. Replies to
+ * requests that need the controller (SET_LED) can arrive after replies to
+ * later requests that do not (LIST), so clients should match on id.
+ * Events pushed after SUBSCRIBE carry id 0.
+ */
+#define IPC_VERSION     1
+#define IPC_MAX_MESSAGE 4096
+
+#define IPC_OP_HELLO     1   /* IpcHello -> IpcHello */
+#define IPC_OP_LIST      2   /* none -> IpcList + IpcDeviceState[count] */
+#define IPC_OP_SET_LED   3   /* IpcSetLed + uint64_t[count] -> IpcSetLedReply */
+#define IPC_OP_SUBSCRIBE 4   /* IpcSubscribe -> none; then IPC_OP_EVENT pushes */
+#define IPC_OP_EVENT     0x80
+
+#define IPC_OK              0
+#define IPC_ERR_BAD_REQUEST 1
+#define IPC_ERR_VERSION     2
+#define IPC_ERR_NO_DEVICE   3
+#define IPC_ERR_WRITE       4
+#define IPC_ERR_BUSY        5   /* the service already has too many requests queued */
+
+/* Event kinds, also used as the subscription mask. */
+#define IPC_EVENT_ARRIVED 0x01
+#define IPC_EVENT_LEFT    0x02
+#define IPC_EVENT_LED     0x04
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t length;   /* whole message, header included */
+    uint32_t id;
+    uint16_t op;
+    uint16_t status;   /* replies only */
+} IpcHeader;
+
+typedef struct {
+    uint32_t version;
+} IpcHello;
+
+/* count == 0 addresses every present controller. */
+typedef struct {
+    uint8_t  mode;
+    uint8_t  brightness;
+    uint16_t count;
+} IpcSetLed;
+
+typedef struct {
+    uint16_t applied;
+    uint16_t failed;
+} IpcSetLedReply;
+
+typedef struct {
+    uint32_t mask;
+} IpcSubscribe;
+
+typedef struct {
+    uint64_t device_id;
+    uint8_t  present;
+    uint8_t  mode;
+    uint8_t  brightness;
+    uint8_t  reserved;
+} IpcDeviceState;
+
+typedef struct {
+    uint16_t count;
+} IpcList;
+
+typedef struct {
+    uint8_t        kind;
+    uint8_t        reserved[3];
+    IpcDeviceState state;
+} IpcEvent;
+#pragma pack(pop)
+
+#endif
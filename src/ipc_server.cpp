@@ -0,0 +1,304 @@
+#include "ipc_server.h"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(IpcHeader) == 12, "IpcHeader is a wire format");
+static_assert(sizeof(IpcDeviceState) == 12, "IpcDeviceState is a wire format");
+static_assert(sizeof(IpcEvent) == 16, "IpcEvent is a wire format");
+
+static uint32_t IpcEventKind(BusEventType type)
+{
+    switch (type) {
+    case BUS_DEVICE_ARRIVED: return IPC_EVENT_ARRIVED;
+    case BUS_DEVICE_LEFT:    return IPC_EVENT_LEFT;
+    case BUS_CMD_SENT:       return IPC_EVENT_LED;
+    default:                 return 0;
+    }
+}
+
+struct IpcServer::Client {
+    std::unique_ptr<IpcChannel> chan;
+    std::thread                 writer;
+
+    std::mutex                  mu;
+    std::condition_variable     cv;
+    std::condition_variable     drained;   /* outbox went below MAX_OUTBOX_BYTES */
+    std::vector<uint8_t>        outbox;
+    size_t                      queued_events = 0;
+    bool                        closed = false;
+
+    std::atomic<uint32_t>       mask{0};
+};
+
+IpcServer::~IpcServer()
+{
+    Stop();
+}
+
+bool IpcServer::Start(const std::string &name, std::string *err)
+{
+    if (!m_listener.Listen(name.c_str(), err))
+        return false;
+    if (m_bus_sub < 0) {
+        m_bus_sub = m_service->Bus().Subscribe(
+            BUS_MASK(BUS_DEVICE_ARRIVED) | BUS_MASK(BUS_DEVICE_LEFT) | BUS_MASK(BUS_CMD_SENT),
+            [this] {
+                {
+                    std::lock_guard<std::mutex> lock(m_mu);
+                    m_bus_ready = true;
+                }
+                m_cv.notify_all();
+            });
+    }
+    m_stopping = false;
+    m_accept = std::thread([this] { AcceptLoop(); });
+    m_dispatch = std::thread([this] { DispatchLoop(); });
+    return true;
+}
+
+void IpcServer::Stop()
+{
+    if (!m_accept.joinable())
+        return;
+    m_listener.Close();
+    m_accept.join();
+
+    {
+        std::unique_lock<std::mutex> lock(m_mu);
+        for (const std::shared_ptr<Client> &c : m_clients)
+            c->chan->Shutdown();
+        m_cv.wait(lock, [this] { return m_clients.empty(); });
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    m_dispatch.join();
+}
+
+IpcServerStats IpcServer::Stats() const
+{
+    IpcServerStats s;
+    s.connections = m_connections;
+    s.requests = m_requests;
+    s.bad_requests = m_bad_requests;
+    s.events = m_events;
+    s.dropped_events = m_dropped_events + m_service->Bus().Dropped(m_bus_sub);
+    return s;
+}
+
+void IpcServer::AcceptLoop()
+{
+    while (IpcChannel *chan = m_listener.Accept()) {
+        std::shared_ptr<Client> c = std::make_shared<Client>();
+        c->chan.reset(chan);
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_clients.push_back(c);
+        }
+        m_connections++;
+        std::thread([this, c] { Serve(c); }).detach();
+    }
+}
+
+void IpcServer::Serve(std::shared_ptr<Client> c)
+{
+    c->writer = std::thread(WriteLoop, c.get());
+
+    std::vector<uint8_t> body;
+    for (;;) {
+        {
+            /* A client that sends without reading its replies is not read
+               either until the writer catches up. */
+            std::unique_lock<std::mutex> lock(c->mu);
+            c->drained.wait(lock, [&c] { return c->closed || c->outbox.size() < MAX_OUTBOX_BYTES; });
+            if (c->closed)
+                break;
+        }
+        IpcHeader hdr;
+        if (!c->chan->Read(&hdr, sizeof(hdr)))
+            break;
+        if (hdr.length < sizeof(hdr) || hdr.length > IPC_MAX_MESSAGE) {
+            /* Framing is lost; there is no way to find the next header. */
+            m_bad_requests++;
+            break;
+        }
+        body.resize(hdr.length - sizeof(hdr));
+        if (!body.empty() && !c->chan->Read(body.data(), body.size()))
+            break;
+        m_requests++;
+        Handle(c, hdr, body.data(), (uint32_t)body.size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(c->mu);
+        c->closed = true;
+    }
+    c->cv.notify_all();
+    c->writer.join();
+    c->chan->Shutdown();
+
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_clients.erase(std::find(m_clients.begin(), m_clients.end(), c));
+    m_cv.notify_all();
+}
+
+void IpcServer::Handle(const std::shared_ptr<Client> &c, const IpcHeader &hdr,
+                       const uint8_t *body, uint32_t len)
+{
+    switch (hdr.op) {
+    case IPC_OP_HELLO: {
+        IpcHello in, out = { IPC_VERSION };
+        if (len < sizeof(in))
+            break;
+        memcpy(&in, body, sizeof(in));
+        Queue(c.get(), hdr.id, hdr.op, in.version == IPC_VERSION ? IPC_OK : IPC_ERR_VERSION,
+              &out, sizeof(out));
+        return;
+    }
+    case IPC_OP_LIST: {
+        std::vector<LedDeviceState> states = m_service->Snapshot();
+        std::vector<uint8_t> out(sizeof(IpcList) + states.size() * sizeof(IpcDeviceState));
+        IpcList list = { (uint16_t)states.size() };
+        memcpy(out.data(), &list, sizeof(list));
+        for (size_t i = 0; i < states.size(); i++) {
+            IpcDeviceState ds = { states[i].device_id, states[i].present, states[i].mode,
+                                  states[i].brightness, 0 };
+            memcpy(out.data() + sizeof(list) + i * sizeof(ds), &ds, sizeof(ds));
+        }
+        Queue(c.get(), hdr.id, hdr.op, IPC_OK, out.data(), (uint32_t)out.size());
+        return;
+    }
+    case IPC_OP_SET_LED: {
+        IpcSetLed set;
+        if (len < sizeof(set))
+            break;
+        memcpy(&set, body, sizeof(set));
+        if (set.count > XBOX_MAX_DEVICES || len != sizeof(set) + set.count * sizeof(uint64_t) ||
+            set.brightness > LED_BRIGHTNESS_MAX)
+            break;
+
+        LedRequest req;
+        req.mode = set.mode;
+        req.brightness = set.brightness;
+        req.devices.resize(set.count);
+        if (set.count)
+            memcpy(req.devices.data(), body + sizeof(set), set.count * sizeof(uint64_t));
+        uint32_t id = hdr.id;
+        req.done = [c, id](int applied, int failed) {
+            if (applied < 0)
+                return;   /* shutting down; the client is already gone */
+            IpcSetLedReply reply = { (uint16_t)applied, (uint16_t)failed };
+            uint16_t status = !applied && !failed ? IPC_ERR_NO_DEVICE
+                            : failed             ? IPC_ERR_WRITE
+                                                 : IPC_OK;
+            Queue(c.get(), id, IPC_OP_SET_LED, status, &reply, sizeof(reply));
+        };
+        if (!m_service->Submit(std::move(req)))
+            Queue(c.get(), id, IPC_OP_SET_LED, IPC_ERR_BUSY, nullptr, 0);
+        return;
+    }
+    case IPC_OP_SUBSCRIBE: {
+        IpcSubscribe sub;
+        if (len < sizeof(sub))
+            break;
+        memcpy(&sub, body, sizeof(sub));
+        c->mask = sub.mask;
+        Queue(c.get(), hdr.id, hdr.op, IPC_OK, nullptr, 0);
+        return;
+    }
+    default:
+        break;
+    }
+
+    m_bad_requests++;
+    Queue(c.get(), hdr.id, hdr.op, IPC_ERR_BAD_REQUEST, nullptr, 0);
+}
+
+/* A subscriber that has not drained MAX_QUEUED_EVENTS events, or whose
+   outbox is full, loses the rest; replies are never dropped. */
+void IpcServer::DispatchLoop()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mu);
+            m_cv.wait(lock, [this] { return m_bus_ready || m_stopping; });
+            if (m_stopping)
+                return;
+            m_bus_ready = false;
+        }
+
+        BusEvent ev;
+        while (m_service->Bus().Poll(m_bus_sub, &ev)) {
+            uint32_t kind = IpcEventKind(ev.type);
+            if (!kind)
+                continue;
+            IpcEvent out = {};
+            out.kind = (uint8_t)kind;
+            out.state.device_id = ev.device_id;
+            out.state.present = ev.present;
+            out.state.mode = ev.mode;
+            out.state.brightness = ev.brightness;
+
+            std::lock_guard<std::mutex> lock(m_mu);
+            for (const std::shared_ptr<Client> &c : m_clients) {
+                if (!(c->mask & kind))
+                    continue;
+                {
+                    std::lock_guard<std::mutex> client_lock(c->mu);
+                    if (c->queued_events >= MAX_QUEUED_EVENTS ||
+                        c->outbox.size() >= MAX_OUTBOX_BYTES) {
+                        m_dropped_events++;
+                        continue;
+                    }
+                    c->queued_events++;
+                }
+                Queue(c.get(), 0, IPC_OP_EVENT, IPC_OK, &out, sizeof(out));
+                m_events++;
+            }
+        }
+    }
+}
+
+void IpcServer::Queue(Client *c, uint32_t id, uint16_t op, uint16_t status,
+                      const void *body, uint32_t len)
+{
+    IpcHeader hdr = { (uint32_t)sizeof(hdr) + len, id, op, status };
+    {
+        std::lock_guard<std::mutex> lock(c->mu);
+        if (c->closed)
+            return;
+        const uint8_t *h = (const uint8_t *)&hdr;
+        c->outbox.insert(c->outbox.end(), h, h + sizeof(hdr));
+        if (len)
+            c->outbox.insert(c->outbox.end(), (const uint8_t *)body, (const uint8_t *)body + len);
+    }
+    c->cv.notify_one();
+}
+
+/* Drains whatever is queued when the client closes, then exits. A failed
+   write shuts the channel down, which also ends the reader. */
+void IpcServer::WriteLoop(Client *c)
+{
+    std::vector<uint8_t> out;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(c->mu);
+            c->cv.wait(lock, [c] { return c->closed || !c->outbox.empty(); });
+            if (c->outbox.empty())
+                return;
+            out.swap(c->outbox);
+            c->queued_events = 0;
+        }
+        c->drained.notify_all();
+        if (!c->chan->Write(out.data(), out.size())) {
+            {
+                std::lock_guard<std::mutex> lock(c->mu);
+                c->closed = true;
+            }
+            c->drained.notify_all();
+            c->chan->Shutdown();
+            return;
+        }
+        out.clear();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef IPC_SERVER_H
+#define IPC_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ipc_channel.h"
+#include "ipc_protocol.h"
+#include "led_service.h"
+
+struct IpcServerStats {
+    uint64_t connections;
+    uint64_t requests;
+    uint64_t bad_requests;
+    uint64_t events;
+    uint64_t dropped_events;   /* not sent to a subscriber that fell behind */
+};
+
+/*
+ * Serves ipc_protocol.h on top of a LedService. Each client gets a reader
+ * thread that parses and dispatches requests and a writer thread that
+ * flushes everything queued for it (replies and events) in one write, so
+ * pipelined requests cost one syscall per burst rather than per reply.
+ * Events come off the service's bus on a dispatcher thread of their own,
+ * so a slow client never holds up the worker. A client's outbox is capped
+ * at MAX_OUTBOX_BYTES: past it, events for that client are dropped and its
+ * requests are not read until the writer has caught up.
+ */
+class IpcServer {
+public:
+    static constexpr size_t MAX_QUEUED_EVENTS = 1024;
+    static constexpr size_t MAX_OUTBOX_BYTES = 256 * 1024;
+
+    explicit IpcServer(LedService *service) : m_service(service) {}
+    ~IpcServer();
+
+    bool Start(const std::string &name, std::string *err);
+    void Stop();
+    IpcServerStats Stats() const;
+
+private:
+    struct Client;
+
+    void AcceptLoop();
+    void DispatchLoop();
+    void Serve(std::shared_ptr<Client> c);
+    void Handle(const std::shared_ptr<Client> &c, const IpcHeader &hdr,
+                const uint8_t *body, uint32_t len);
+    static void Queue(Client *c, uint32_t id, uint16_t op, uint16_t status,
+                      const void *body, uint32_t len);
+    static void WriteLoop(Client *c);
+
+    LedService             *m_service;
+    IpcListener             m_listener;
+    std::thread             m_accept;
+    std::thread             m_dispatch;
+    int                     m_bus_sub = -1;
+    bool                    m_bus_ready = false;
+    bool                    m_stopping = false;
+
+    std::mutex              m_mu;
+    std::condition_variable m_cv;
+    std::vector<std::shared_ptr<Client>> m_clients;
+
+    std::atomic<uint64_t>   m_connections{0};
+    std::atomic<uint64_t>   m_requests{0};
+    std::atomic<uint64_t>   m_bad_requests{0};
+    std::atomic<uint64_t>   m_events{0};
+    std::atomic<uint64_t>   m_dropped_events{0};
+};
+
+#endif /* IPC_SERVER_H */
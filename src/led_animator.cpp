@@ -0,0 +1,238 @@
+#include "led_animator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+/* The last stretch before a deadline is spun rather than slept, since the
+   OS timer alone overshoots by up to its resolution. */
+#ifdef _WIN32
+static const std::chrono::microseconds SPIN_MARGIN(1500);
+#else
+static const std::chrono::microseconds SPIN_MARGIN(200);
+#endif
+
+static const double PI = 3.14159265358979323846;
+
+LedAnimator::LedAnimator(Sink sink) : m_sink(std::move(sink))
+{
+    memset(m_hist, 0, sizeof(m_hist));
+}
+
+LedAnimator::~LedAnimator()
+{
+    Stop();
+}
+
+void LedAnimator::Start(const AnimatorConfig &cfg)
+{
+    Stop();
+
+    m_cfg = cfg;
+    m_cfg.rate_hz = std::min(std::max(m_cfg.rate_hz, 1u), MAX_RATE_HZ);
+    m_cfg.period_ms = std::max(m_cfg.period_ms, 100u);
+
+    {
+        std::lock_guard<std::mutex> lock(m_stats_mu);
+        memset(m_hist, 0, sizeof(m_hist));
+        m_ticks = m_skipped = m_frames = 0;
+        m_max_late_ns = 0;
+    }
+    m_thread = std::thread(&LedAnimator::Run, this);
+}
+
+void LedAnimator::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_wait_mu);
+        m_stop = true;
+    }
+    m_wait_cv.notify_all();
+    m_thread.join();
+    m_stop = false;
+}
+
+static void RaisePriority()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+    /* Needs CAP_SYS_NICE; without it the thread keeps normal priority. */
+    sched_param sp = {};
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+#endif
+}
+
+void LedAnimator::Run()
+{
+    if (m_cfg.realtime)
+        RaisePriority();
+#ifdef _WIN32
+    timeBeginPeriod(1);
+#endif
+
+    const std::chrono::nanoseconds tick(1000000000ll / m_cfg.rate_hz);
+    const double period_ns = m_cfg.period_ms * 1e6;
+    const Clock::time_point start = Clock::now();
+    int64_t n = 0;
+    int last = -1;
+
+    while (!m_stop) {
+        const Clock::time_point deadline = start + tick * n;
+        {
+            std::unique_lock<std::mutex> lock(m_wait_mu);
+            m_wait_cv.wait_until(lock, deadline - SPIN_MARGIN, [this] { return m_stop.load(); });
+        }
+        while (!m_stop && Clock::now() < deadline)
+            std::this_thread::yield();
+        if (m_stop)
+            break;
+
+        Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - deadline).count());
+
+        /* Phase comes from the deadline, not the wake-up time, so jitter
+           never shows up in the curve. */
+        double elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - start).count();
+        double phase = std::fmod(elapsed / period_ns, 1.0);
+        int level = (int)std::lround(Sample(m_cfg, phase) * m_cfg.peak);
+        if (level != last) {
+            m_sink((uint8_t)level);
+            last = level;
+            std::lock_guard<std::mutex> lock(m_stats_mu);
+            m_frames++;
+        }
+
+        n++;
+        int64_t behind = (Clock::now() - (start + tick * n)) / tick;
+        if (behind > 0) {
+            n += behind;
+            std::lock_guard<std::mutex> lock(m_stats_mu);
+            m_skipped += (uint64_t)behind;
+        }
+    }
+
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void LedAnimator::Record(int64_t late_ns)
+{
+    if (late_ns < 0)
+        late_ns = 0;
+    int64_t bucket = late_ns / 1000 / BUCKET_US;
+    std::lock_guard<std::mutex> lock(m_stats_mu);
+    m_hist[bucket < BUCKETS ? bucket : BUCKETS]++;
+    m_ticks++;
+    m_max_late_ns = std::max(m_max_late_ns, late_ns);
+}
+
+AnimatorStats LedAnimator::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_stats_mu);
+    AnimatorStats s = {};
+    s.ticks = m_ticks;
+    s.skipped = m_skipped;
+    s.frames = m_frames;
+    s.max_us = m_max_late_ns / 1000.0;
+    if (!m_ticks)
+        return s;
+
+    uint64_t p50 = (m_ticks + 1) / 2;
+    uint64_t p99 = (m_ticks * 99 + 99) / 100;
+    uint64_t seen = 0;
+    bool have50 = false;
+    for (int i = 0; i <= BUCKETS; i++) {
+        seen += m_hist[i];
+        double us = i < BUCKETS ? (i + 0.5) * BUCKET_US : s.max_us;
+        if (!have50 && seen >= p50) {
+            s.p50_us = us;
+            have50 = true;
+        }
+        if (seen >= p99) {
+            s.p99_us = us;
+            break;
+        }
+    }
+    return s;
+}
+
+float LedAnimator::Sample(const AnimatorConfig &cfg, double phase)
+{
+    switch (cfg.curve) {
+    case ANIM_BREATHE:
+        return (float)(0.5 - 0.5 * std::cos(2.0 * PI * phase));
+
+    case ANIM_HEARTBEAT: {
+        double a = (phase - 0.06) / 0.035;
+        double b = (phase - 0.24) / 0.045;
+        double v = std::exp(-a * a) + 0.6 * std::exp(-b * b);
+        return (float)std::min(v, 1.0);
+    }
+
+    case ANIM_CUSTOM: {
+        const std::vector<AnimKey> &k = cfg.keys;
+        if (k.empty())
+            return 0.0f;
+        if (k.size() == 1)
+            return k[0].level;
+        for (size_t i = 0; i + 1 < k.size(); i++) {
+            if (phase >= k[i].t && phase < k[i + 1].t) {
+                double f = (phase - k[i].t) / (k[i + 1].t - k[i].t);
+                return (float)(k[i].level + f * (k[i + 1].level - k[i].level));
+            }
+        }
+        /* Wrap from the last key back around to the first. */
+        const AnimKey &a = k.back();
+        const AnimKey &b = k.front();
+        double span = 1.0 - a.t + b.t;
+        double pos = phase >= a.t ? phase - a.t : phase + 1.0 - a.t;
+        double f = span > 0.0 ? pos / span : 0.0;
+        return (float)(a.level + f * (b.level - a.level));
+    }
+    }
+    return 0.0f;
+}
+
+/* "t:level,t:level,..." with both values in 0..1, e.g. "0:0,0.5:1,1:0". */
+bool LedAnimator::ParseCurve(const char *text, std::vector<AnimKey> *keys)
+{
+    std::vector<AnimKey> out;
+    const char *p = text;
+    while (*p) {
+        char *end;
+        double t = strtod(p, &end);
+        if (end == p || *end != ':')
+            return false;
+        p = end + 1;
+        double level = strtod(p, &end);
+        if (end == p || t < 0.0 || t > 1.0 || level < 0.0 || level > 1.0)
+            return false;
+        out.push_back({ (float)t, (float)level });
+        p = end;
+        while (*p == ',' || *p == ' ' || *p == '\n' || *p == '\r')
+            p++;
+    }
+    if (out.empty())
+        return false;
+    std::sort(out.begin(), out.end(), [](const AnimKey &a, const AnimKey &b) { return a.t < b.t; });
+    *keys = std::move(out);
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef LED_ANIMATOR_H
+#define LED_ANIMATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum AnimCurve { ANIM_BREATHE, ANIM_HEARTBEAT, ANIM_CUSTOM };
+
+struct AnimKey {
+    float t;        /* position in the period, 0..1 */
+    float level;    /* 0..1 of peak brightness */
+};
+
+struct AnimatorConfig {
+    AnimCurve            curve;
+    uint32_t             period_ms;
+    uint32_t             rate_hz;
+    uint8_t              peak;
+    bool                 realtime;
+    std::vector<AnimKey> keys;
+};
+
+/* Tick lateness relative to the absolute deadline, in microseconds. */
+struct AnimatorStats {
+    uint64_t ticks;
+    uint64_t skipped;
+    uint64_t frames;
+    double   p50_us;
+    double   p99_us;
+    double   max_us;
+};
+
+/*
+ * Computes a brightness every tick on its own thread and hands changed
+ * values to the sink. Deadlines are start + n * tick on the monotonic
+ * clock, so a late tick never shifts the ones after it; ticks that are
+ * already a full period late are skipped and counted.
+ */
+class LedAnimator {
+public:
+    using Sink = std::function<void(uint8_t brightness)>;
+
+    static constexpr uint32_t MAX_RATE_HZ = 100;
+
+    explicit LedAnimator(Sink sink);
+    ~LedAnimator();
+
+    void Start(const AnimatorConfig &cfg);
+    void Stop();
+    bool Running() const { return m_thread.joinable(); }
+    AnimatorStats Stats() const;
+
+    static float Sample(const AnimatorConfig &cfg, double phase);
+    static bool  ParseCurve(const char *text, std::vector<AnimKey> *keys);
+
+private:
+    void Run();
+    void Record(int64_t late_ns);
+
+    static constexpr int BUCKET_US = 10;
+    static constexpr int BUCKETS   = 2000;
+
+    Sink                    m_sink;
+    AnimatorConfig          m_cfg;
+    std::thread             m_thread;
+    std::atomic<bool>       m_stop{false};
+    std::mutex              m_wait_mu;
+    std::condition_variable m_wait_cv;
+
+    mutable std::mutex      m_stats_mu;
+    uint32_t                m_hist[BUCKETS + 1];
+    uint64_t                m_ticks = 0;
+    uint64_t                m_skipped = 0;
+    uint64_t                m_frames = 0;
+    int64_t                 m_max_late_ns = 0;
+};
+
+#endif /* LED_ANIMATOR_H */
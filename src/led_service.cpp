@@ -0,0 +1,431 @@
+#include "led_service.h"
+
+#include <chrono>
+
+/* 0 when the controller is not present. */
+static uint64_t ArrivedNs(const XboxController *ctrl, uint64_t device_id)
+{
+    for (int i = 0; i < ctrl->device_count; i++) {
+        const XboxDevice &dev = ctrl->devices[i];
+        if (dev.device_id == device_id && dev.state == XBOX_DEV_PRESENT)
+            return dev.arrived_ns;
+    }
+    return 0;
+}
+
+LedService::LedService(GipTransport transport)
+{
+    xbox_init_with_transport(&m_ctrl, transport);
+}
+
+LedService::~LedService()
+{
+    Stop();
+    xbox_cleanup(&m_ctrl);
+}
+
+void LedService::Start()
+{
+    if (m_thread.joinable())
+        return;
+    m_stop = false;
+    m_thread = std::thread([this] { Run(); });
+}
+
+void LedService::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mu);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    xbox_wake(&m_ctrl);
+    m_thread.join();
+}
+
+bool LedService::Submit(LedRequest req)
+{
+    BusEvent ev = {};
+    ev.type = BUS_CMD_QUEUED;
+    ev.mode = req.mode;
+    ev.mode_idx = BUS_NO_MODE;
+    ev.brightness = req.brightness;
+    ev.device_id = req.devices.size() == 1 ? req.devices[0] : 0;
+    ev.t_ns = xbox_time_ns();
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(m_mu);
+        full = m_pending.size() >= MAX_PENDING;
+        if (!full)
+            m_pending.push_back(std::move(req));
+    }
+    if (full) {
+        std::lock_guard<std::mutex> lock(m_state_mu);
+        m_stats.rejected++;
+        return false;
+    }
+    m_bus.Publish(ev);
+    m_cv.notify_all();
+    xbox_wake(&m_ctrl);
+    return true;
+}
+
+std::vector<LedDeviceState> LedService::Snapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_state_mu);
+    std::vector<LedDeviceState> out;
+    out.reserve(m_states.size());
+    for (const auto &kv : m_states)
+        out.push_back(kv.second);
+    return out;
+}
+
+LedServiceStats LedService::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_state_mu);
+    return m_stats;
+}
+
+void LedService::Emit(BusEventType type, const LedDeviceState &state, uint8_t error)
+{
+    BusEvent ev = {};
+    ev.type = type;
+    ev.present = state.present;
+    ev.mode = state.mode;
+    ev.mode_idx = BUS_NO_MODE;
+    ev.brightness = state.brightness;
+    ev.error = error;
+    ev.device_id = state.device_id;
+    ev.t_ns = xbox_time_ns();
+    m_bus.Publish(ev);
+}
+
+/*
+ * The session is opened once and kept; when the transport cannot be opened
+ * (no driver, or the last write failed and took the session down) the
+ * worker waits on its own condition variable and retries on an interval,
+ * since there is no handle to pump.
+ */
+void LedService::Run()
+{
+    uint64_t next_open = 0;
+    while (!m_stop) {
+        if (!m_ctrl.open && xbox_time_ns() >= next_open) {
+            xbox_open(&m_ctrl);
+            next_open = xbox_time_ns() + REOPEN_INTERVAL_MS * 1000000ull;
+            SyncDevices();
+        }
+
+        if (m_ctrl.open) {
+            /* Controllers can come back while a write is in progress. The
+               waits inside a write also take the wake a Submit() sends, so
+               requests queued meanwhile are looked for before blocking. */
+            bool queued;
+            {
+                std::lock_guard<std::mutex> lock(m_mu);
+                queued = !m_pending.empty();
+            }
+            xbox_pump(&m_ctrl, queued || m_reconnect.Pending() ? 0 : GIP_WAIT_INFINITE);
+        } else {
+            uint64_t now = xbox_time_ns();
+            uint64_t wait_ns = next_open > now ? next_open - now : 0;
+            std::unique_lock<std::mutex> lock(m_mu);
+            m_cv.wait_for(lock, std::chrono::nanoseconds(wait_ns),
+                          [this] { return m_stop.load() || !m_pending.empty(); });
+        }
+        SyncDevices();
+        if (m_reconnect.Pending()) {
+            /* A hub reset announces every controller at once, but one pump
+               only takes in what the posted reads hold. Gather the rest
+               first, so the most recently active controllers go first. */
+            for (int i = 0; i < XBOX_MAX_DEVICES && (xbox_pump(&m_ctrl, 0) & XBOX_EVENT_ARRIVED); i++)
+                SyncDevices();
+            Reapply();
+            SyncDevices();
+        }
+
+        std::vector<LedRequest> batch;
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            batch.swap(m_pending);
+        }
+        if (!batch.empty()) {
+            Execute(batch);
+            SyncDevices();
+        }
+    }
+
+    std::vector<LedRequest> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mu);
+        cancelled.swap(m_pending);
+    }
+    for (LedRequest &req : cancelled) {
+        if (req.done)
+            req.done(-1, -1);
+    }
+}
+
+void LedService::SyncDevices()
+{
+    std::vector<std::pair<BusEventType, LedDeviceState>> events;
+    {
+        std::lock_guard<std::mutex> lock(m_state_mu);
+        for (auto &kv : m_states)
+            kv.second.present = false;
+        for (int i = 0; m_ctrl.open && i < m_ctrl.device_count; i++) {
+            const XboxDevice &dev = m_ctrl.devices[i];
+            if (dev.state != XBOX_DEV_PRESENT)
+                continue;
+            m_reconnect.Touch(dev.device_id, dev.last_seen_ns);
+            auto it = m_states.find(dev.device_id);
+            if (it != m_states.end() && it->second.arrived_ns == dev.arrived_ns) {
+                it->second.present = true;
+                continue;
+            }
+            /* New, or it reset or left and came back since the last look
+               (possibly within one pump); either way it reset its LED. */
+            LedDeviceState st = { dev.device_id, true, LED_MODE_ON, LED_BRIGHTNESS_DEFAULT,
+                                  dev.arrived_ns };
+            m_states[dev.device_id] = st;
+            events.push_back({ BUS_DEVICE_ARRIVED, st });
+            m_reconnect.Announced(dev.device_id, dev.arrived_ns);
+        }
+        for (auto it = m_states.begin(); it != m_states.end();) {
+            if (it->second.present) {
+                ++it;
+                continue;
+            }
+            events.push_back({ BUS_DEVICE_LEFT, it->second });
+            it = m_states.erase(it);
+        }
+        if (!events.empty())
+            PublishStatus();
+    }
+    for (const auto &ev : events)
+        Emit(ev.first, ev.second);
+}
+
+/* Restores the last value written to controllers that have come back.
+   A failure closes the session; the announce after reopening queues the
+   controller again. */
+void LedService::Reapply()
+{
+    std::vector<ReconnectResult> results = m_reconnect.Run(&m_ctrl);
+    std::vector<LedDeviceState> emit;
+    {
+        std::lock_guard<std::mutex> lock(m_state_mu);
+        for (const ReconnectResult &r : results) {
+            if (!r.ok)
+                continue;
+            auto it = m_states.find(r.device_id);
+            if (it == m_states.end())
+                continue;
+            it->second.mode = r.mode;
+            it->second.brightness = r.brightness;
+            emit.push_back(it->second);
+        }
+        m_stats.writes += results.size();
+        m_stats.frames = m_ctrl.write_stats.sent;
+        m_stats.suppressed = m_ctrl.write_stats.suppressed;
+        m_stats.reconnect = m_reconnect.Stats();
+        if (!emit.empty())
+            PublishStatus();
+    }
+
+    uint64_t now = xbox_time_ns();
+    for (const ReconnectResult &r : results) {
+        if (!r.ok) {
+            Emit(BUS_CMD_FAILED, { r.device_id, m_ctrl.open, r.mode, r.brightness, 0 },
+                 (uint8_t)r.error);
+            continue;
+        }
+        BusEvent ev = {};
+        ev.type = BUS_HOTPLUG;
+        ev.present = 1;
+        ev.mode = r.mode;
+        ev.mode_idx = BUS_NO_MODE;
+        ev.brightness = r.brightness;
+        ev.device_id = r.device_id;
+        ev.t_ns = now;
+        ev.latency_ns = r.apply_ns;
+        m_bus.Publish(ev);
+    }
+    for (const LedDeviceState &st : emit)
+        Emit(BUS_CMD_SENT, st);
+}
+
+/* Worker thread, with m_state_mu held. */
+void LedService::PublishStatus()
+{
+    if (!m_status)
+        return;
+    StatusDevice out[STATUS_MAX_DEVICES] = {};
+    uint32_t n = 0;
+    for (const auto &kv : m_states) {
+        if (n == STATUS_MAX_DEVICES)
+            break;
+        out[n].device_id = kv.second.device_id;
+        out[n].present = kv.second.present;
+        out[n].mode = kv.second.mode;
+        out[n].brightness = kv.second.brightness;
+        n++;
+    }
+    m_status->Publish(out, n);
+}
+
+/*
+ * Writes one value to several controllers in a single broadcast. A failed
+ * write closes the session, so the failures get one retry after reopening,
+ * which covers a replug. err gets XBOX_ERR_NO_DEVICE for controllers that
+ * were not there, otherwise the error of the last attempt.
+ */
+void LedService::WriteDevices(const std::vector<uint64_t> &ids, uint8_t mode, uint8_t brightness,
+                              std::map<uint64_t, int> *err)
+{
+    std::vector<uint64_t> todo = ids;
+    for (uint64_t id : ids)
+        (*err)[id] = XBOX_ERR_NO_DEVICE;
+
+    for (int attempt = 0; attempt < 2 && !todo.empty(); attempt++) {
+        if (!m_ctrl.open)
+            xbox_open(&m_ctrl);
+
+        /* Only controllers in the table can be written, so clients naming
+           more than XBOX_MAX_DEVICES ids still fit in one call. */
+        std::vector<uint64_t> present;
+        for (uint64_t id : todo) {
+            if (ArrivedNs(&m_ctrl, id))
+                present.push_back(id);
+        }
+        if (present.empty())
+            break;
+        XboxLedResult results[XBOX_MAX_DEVICES];
+        int n = xbox_set_led_many(&m_ctrl, present.data(), (int)present.size(), mode, brightness,
+                                  results);
+
+        std::vector<uint64_t> retry;
+        for (int i = 0; i < n; i++) {
+            if (results[i].ok) {
+                (*err)[results[i].device_id] = XBOX_OK;
+            } else {
+                (*err)[results[i].device_id] = m_ctrl.last_err;
+                retry.push_back(results[i].device_id);
+            }
+        }
+        if (m_ctrl.open)
+            break;
+        todo.swap(retry);
+    }
+}
+
+void LedService::Execute(std::vector<LedRequest> &batch)
+{
+    std::vector<uint64_t> present;
+    for (int i = 0; m_ctrl.open && i < m_ctrl.device_count; i++) {
+        if (m_ctrl.devices[i].state == XBOX_DEV_PRESENT)
+            present.push_back(m_ctrl.devices[i].device_id);
+    }
+
+    std::vector<uint64_t>      order;
+    std::map<uint64_t, size_t> last;
+    size_t targets = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        const std::vector<uint64_t> &ids = batch[i].devices.empty() ? present : batch[i].devices;
+        for (uint64_t id : ids) {
+            if (last.find(id) == last.end())
+                order.push_back(id);
+            last[id] = i;
+            targets++;
+        }
+    }
+
+    /* Targets that end up with the same value share one broadcast. */
+    std::map<uint16_t, std::vector<uint64_t>> groups;
+    for (uint64_t id : order) {
+        const LedRequest &req = batch[last[id]];
+        uint8_t bright = req.mode == LED_MODE_OFF ? 0 : req.brightness;
+        groups[(uint16_t)(req.mode << 8 | bright)].push_back(id);
+    }
+
+    std::map<uint64_t, bool> result;
+    std::vector<LedDeviceState> changed;
+    for (const auto &g : groups) {
+        uint8_t mode = (uint8_t)(g.first >> 8), bright = (uint8_t)g.first;
+        std::map<uint64_t, int> err;
+        WriteDevices(g.second, mode, bright, &err);
+        uint64_t latency = m_ctrl.write_latency_ns;
+        uint64_t now = xbox_time_ns();
+        for (uint64_t id : g.second) {
+            bool ok = err[id] == XBOX_OK;
+            result[id] = ok;
+            if (ok) {
+                m_reconnect.Remember(id, mode, bright, now);
+                changed.push_back({ id, true, mode, bright, ArrivedNs(&m_ctrl, id) });
+                BusEvent lat = {};
+                lat.type = BUS_LATENCY;
+                lat.present = 1;
+                lat.mode_idx = BUS_NO_MODE;
+                lat.device_id = id;
+                lat.t_ns = xbox_time_ns();
+                lat.latency_ns = latency;
+                m_bus.Publish(lat);
+            } else {
+                Emit(BUS_CMD_FAILED, { id, m_ctrl.open, mode, bright, 0 }, (uint8_t)err[id]);
+            }
+        }
+    }
+
+    int failed_total = 0;
+    for (LedRequest &req : batch) {
+        const std::vector<uint64_t> &ids = req.devices.empty() ? present : req.devices;
+        int applied = 0, failed = 0;
+        for (uint64_t id : ids) {
+            if (result[id])
+                applied++;
+            else
+                failed++;
+        }
+        failed_total += failed;
+        if (req.done)
+            req.done(applied, failed);
+    }
+
+    std::vector<LedDeviceState> arrived, emit;
+    {
+        std::lock_guard<std::mutex> lock(m_state_mu);
+        m_stats.requests += batch.size();
+        m_stats.batches++;
+        m_stats.writes += order.size();
+        m_stats.coalesced += targets - order.size();
+        m_stats.failed += (uint64_t)failed_total;
+        m_stats.frames = m_ctrl.write_stats.sent;
+        m_stats.suppressed = m_ctrl.write_stats.suppressed;
+        for (const LedDeviceState &st : changed) {
+            auto it = m_states.find(st.device_id);
+            if (it == m_states.end()) {
+                /* Announced during the write (or the reopen before it), so
+                   SyncDevices has not seen it yet; it has the value now. */
+                m_states[st.device_id] = st;
+                arrived.push_back(st);
+                emit.push_back(st);
+                continue;
+            }
+            LedDeviceState &cur = it->second;
+            if (cur.present && cur.mode == st.mode && cur.brightness == st.brightness)
+                continue;
+            cur.present = st.present;
+            cur.mode = st.mode;
+            cur.brightness = st.brightness;
+            emit.push_back(cur);
+        }
+        if (!emit.empty())
+            PublishStatus();
+    }
+    for (const LedDeviceState &st : arrived)
+        Emit(BUS_DEVICE_ARRIVED, st);
+    for (const LedDeviceState &st : emit)
+        Emit(BUS_CMD_SENT, st);
+}
@@ -0,0 +1,113 @@
+#ifndef LED_SERVICE_H
+#define LED_SERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event_bus.h"
+#include "reconnect.h"
+#include "status_page.h"
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+struct LedDeviceState {
+    uint64_t device_id;
+    bool     present;
+    uint8_t  mode;
+    uint8_t  brightness;
+    uint64_t arrived_ns;   /* the XboxDevice::arrived_ns the state belongs to */
+};
+
+/* An empty device list addresses every present controller. done runs on
+   the worker thread once every target has been written or has failed, or
+   with (-1, -1) from Stop() if the request never ran. */
+struct LedRequest {
+    std::vector<uint64_t>               devices;
+    uint8_t                             mode;
+    uint8_t                             brightness;
+    std::function<void(int, int)>       done;   /* (applied, failed) */
+};
+
+struct LedServiceStats {
+    uint64_t requests;
+    uint64_t batches;
+    uint64_t writes;
+    uint64_t coalesced;   /* targets overwritten by a later request in the same batch */
+    uint64_t rejected;    /* refused by Submit() because MAX_PENDING were queued */
+    uint64_t failed;
+    uint64_t frames;       /* LED frames put on the bus */
+    uint64_t suppressed;   /* targets that already showed the value */
+    ReconnectStats reconnect;
+};
+
+/*
+ * Owns an XboxController on a worker thread for clients that are not the
+ * UI. Requests queue up while a write is in flight, up to MAX_PENDING, and
+ * the worker takes them as one batch. When several requests in a batch
+ * address the same controller only the last one is written, and all of
+ * them report its result. Controllers getting the same value share one
+ * broadcast. A controller that comes back gets the last value written to
+ * it again (see ReconnectScheduler). Arrivals, departures, writes and
+ * their latency go out on the event bus, and the device table is mirrored
+ * to the status page when one is attached.
+ */
+class LedService {
+public:
+    static constexpr uint32_t REOPEN_INTERVAL_MS = 2000;
+    static constexpr size_t   MAX_PENDING = 256;
+
+    explicit LedService(GipTransport transport);
+    ~LedService();
+
+    /* Call before Start(); the publisher must outlive the service. */
+    void SetStatusPublisher(StatusPublisher *status) { m_status = status; }
+    /* Call before Start(): frames in flight when re-applying after a
+       reconnect. */
+    void SetReconnectConcurrency(int frames) { m_reconnect.SetConcurrency(frames); }
+    void Start();
+    void Stop();
+
+    /* Returns false, without calling done, when MAX_PENDING requests are
+       already waiting for the worker. */
+    bool Submit(LedRequest req);
+    std::vector<LedDeviceState> Snapshot() const;
+    LedServiceStats Stats() const;
+
+    EventBus &Bus() { return m_bus; }
+
+private:
+    void Run();
+    void SyncDevices();
+    void Reapply();
+    void Execute(std::vector<LedRequest> &batch);
+    void WriteDevices(const std::vector<uint64_t> &ids, uint8_t mode, uint8_t brightness,
+                      std::map<uint64_t, int> *err);
+    void Emit(BusEventType type, const LedDeviceState &state, uint8_t error = 0);
+    void PublishStatus();
+
+    XboxController          m_ctrl;
+    ReconnectScheduler      m_reconnect;   /* worker thread */
+    std::thread             m_thread;
+    std::atomic<bool>       m_stop{false};
+
+    std::mutex              m_mu;
+    std::condition_variable m_cv;
+    std::vector<LedRequest> m_pending;
+
+    mutable std::mutex      m_state_mu;
+    std::map<uint64_t, LedDeviceState> m_states;
+    LedServiceStats         m_stats = {};
+    StatusPublisher        *m_status = nullptr;
+
+    EventBus                m_bus;
+};
+
+#endif /* LED_SERVICE_H */
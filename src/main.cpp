@@ -5,16 +5,24 @@
 
 #include <d3d11.h>
 #include <shellapi.h>
-#include <shlwapi.h>
 #include <dbt.h>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
-
-#pragma comment(lib, "shlwapi.lib")
+#include <mutex>
 
 extern "C" {
 #include "xbox_led.h"
 }
+#include "app_config.h"
+#include "gip_loopback.h"
+#include "gip_trace.h"
+#include "command_queue.h"
+#include "event_bus.h"
+#include "hotplug.h"
+#include "led_animator.h"
+#include "reconnect.h"
+#include "status_page.h"
 
 static ID3D11Device           *g_pd3dDevice          = nullptr;
 static ID3D11DeviceContext    *g_pd3dDeviceContext    = nullptr;
@@ -31,50 +39,6 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND, UINT, WPARAM,
 
 static char g_config_path[MAX_PATH] = {};
 
-static void InitConfigPath()
-{
-    GetModuleFileNameA(nullptr, g_config_path, MAX_PATH);
-    PathRemoveFileSpecA(g_config_path);
-    strcat_s(g_config_path, "\\xbledctl.ini");
-}
-
-static void SaveConfig(int brightness, int mode_idx, bool start_with_windows, bool minimize_to_tray)
-{
-    char buf[512];
-    snprintf(buf, sizeof(buf),
-        "[xbledctl]\nbrightness=%d\nmode=%d\nstart_with_windows=%d\nminimize_to_tray=%d\n",
-        brightness, mode_idx, start_with_windows ? 1 : 0, minimize_to_tray ? 1 : 0);
-    FILE *f = nullptr;
-    fopen_s(&f, g_config_path, "w");
-    if (f) { fputs(buf, f); fclose(f); }
-}
-
-static void LoadConfig(int *brightness, int *mode_idx, bool *start_with_windows, bool *minimize_to_tray)
-{
-    *brightness = LED_BRIGHTNESS_DEFAULT;
-    *mode_idx = 1;
-    *start_with_windows = true;
-    *minimize_to_tray = true;
-
-    FILE *f = nullptr;
-    fopen_s(&f, g_config_path, "r");
-    if (!f) return;
-
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-        int val;
-        if (sscanf_s(line, "brightness=%d", &val) == 1)
-            *brightness = (val >= 0 && val <= LED_BRIGHTNESS_MAX) ? val : LED_BRIGHTNESS_DEFAULT;
-        else if (sscanf_s(line, "mode=%d", &val) == 1)
-            *mode_idx = (val >= 0 && val <= 7) ? val : 1;
-        else if (sscanf_s(line, "start_with_windows=%d", &val) == 1)
-            *start_with_windows = (val != 0);
-        else if (sscanf_s(line, "minimize_to_tray=%d", &val) == 1)
-            *minimize_to_tray = (val != 0);
-    }
-    fclose(f);
-}
-
 static const char *AUTOSTART_KEY = "Software\\Microsoft\\Windows\\CurrentVersion\\Run";
 static const char *AUTOSTART_VAL = "xbledctl";
 
@@ -108,6 +72,7 @@ static bool IsAutoStartEnabled()
 }
 
 #define WM_TRAYICON (WM_USER + 1)
+#define WM_APP_BUS  (WM_APP + 1)
 #define ID_TRAY_SHOW 1001
 #define ID_TRAY_QUIT 1002
 
@@ -148,43 +113,88 @@ static void RestoreFromTray(HWND hwnd)
 }
 
 static XboxController g_ctrl;
-static int            g_brightness = LED_BRIGHTNESS_DEFAULT;
-static int            g_mode_idx   = 1;
-static char           g_status[128] = "Plug in your controller with a USB cable";
-static ImVec4         g_status_color;
-static bool           g_start_with_windows = true;
-static bool           g_minimize_to_tray = true;
-static bool           g_device_change_pending = false;
-static DWORD          g_device_change_tick = 0;
-static bool           g_device_removed = false;
-static bool           g_controller_present = false;
-
-enum WorkerCmd { CMD_NONE, CMD_REFRESH, CMD_APPLY };
-static HANDLE         g_worker_thread = nullptr;
-static HANDLE         g_worker_event = nullptr;
-static volatile WorkerCmd g_worker_cmd = CMD_NONE;
-static volatile bool  g_worker_busy = false;
-static volatile int   g_worker_brightness = 0;
-static volatile int   g_worker_mode = 0;
+static AppConfig      g_cfg;
+static HotplugTracker g_hotplug;
+static HDEVNOTIFY     g_dev_notify[2];
+
+/* USB devices and the GIP interface class; the first covers the wired
+   controller and the wireless adapter, the second controllers behind it. */
+static const GUID HOTPLUG_CLASSES[2] = {
+    { 0xA5DCBF10, 0x6530, 0x11D2, { 0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED } },
+    { 0x020BC73C, 0x0DCA, 0x4EE3, { 0x96, 0xD5, 0xAB, 0x00, 0x6A, 0xDA, 0x59, 0x38 } },
+};
 
-static const ImVec4 COL_WARN    = ImVec4(0.902f, 0.706f, 0.157f, 1.0f);
+/*
+ * The worker reports through g_bus only. Each consumer on the UI thread
+ * (status line, tray, metrics, log) has its own subscription and keeps
+ * its own copy of what it needs; text is formatted when it is drawn.
+ */
+static EventBus       g_bus;
+static int            g_sub_gui = -1;
+static int            g_sub_tray = -1;
+static int            g_sub_metrics = -1;
+static int            g_sub_log = -1;
+static FILE          *g_log = nullptr;
+static BusEvent       g_status_event = {};
+static bool           g_have_status = false;
+static bool           g_controller_present = false;   /* UI thread, from events */
+static bool           g_session_present = false;      /* worker thread */
 
-struct ModeEntry {
-    const char *label;
-    uint8_t     value;
+static HANDLE         g_worker_thread = nullptr;
+static CommandQueue   g_queue([] { xbox_wake(&g_ctrl); });
+
+/* Last LED state written by the worker, mirrored to the status page. */
+static StatusPublisher g_status_page;
+static uint8_t        g_led_mode = LED_MODE_ON;
+static uint8_t        g_led_bright = LED_BRIGHTNESS_DEFAULT;
+/* Worker: controllers that got g_led_mode/bright, with the arrival
+   (XboxDevice::arrived_ns) they got it in; a reset or reconnect since
+   then means the LED is back at default. */
+struct AppliedLed {
+    uint64_t device_id;
+    uint64_t arrived_ns;
 };
+static AppliedLed     g_led_applied[XBOX_MAX_DEVICES];
+static int            g_led_applied_count = 0;
+/* Worker: writes arrivals most recently active first, a few frames in
+   flight at a time, as the daemon does. */
+static ReconnectScheduler g_reconnect;
+
+/* Worker: the last committed apply, written to every controller that
+   announces itself, and when Windows last reported a device arrival. */
+static WorkerCommand  g_desired = {};
+static bool           g_have_desired = false;
+static uint64_t       g_hotplug_ns = 0;
+static const uint64_t HOTPLUG_WINDOW_NS = 5000000000ull;
+
+/* Controllers that last took a write. The worker updates the list and the
+   UI thread saves it; at startup the worker writes to these directly
+   instead of enumerating first. */
+static std::mutex     g_known_mu;
+static uint64_t       g_known[XBOX_MAX_DEVICES];
+static int            g_known_count = 0;
+static bool           g_known_dirty = false;
+static bool           g_try_known = true;   /* worker: first open only */
+
+static const uint32_t RESCAN_WINDOW_MS = 300;
+static const uint32_t WORKER_EXIT_TIMEOUT_MS = 1000;
+
+/* Live preview never writes faster than the controller completes writes,
+   and never faster than this floor. */
+static const uint64_t PREVIEW_MIN_INTERVAL_NS = 8000000;
+static uint64_t       g_preview_next_ns = 0;
+static uint64_t       g_preview_writes = 0;
+static uint64_t       g_preview_t0_ns = 0;
+static uint64_t       g_preview_w0 = 0;
+static float          g_preview_rate = 0.0f;
+static double         g_write_latency_ms = 0.0;
+static double         g_hotplug_ms = -1.0;
+
+/* Copied from g_ctrl.write_stats by the worker. */
+static std::atomic<uint64_t> g_frames_sent{0};
+static std::atomic<uint64_t> g_frames_suppressed{0};
 
-static const ModeEntry MODES[] = {
-    { "Off",        LED_MODE_OFF           },
-    { "Steady",     LED_MODE_ON            },
-    { "Fast Blink", LED_MODE_BLINK_FAST    },
-    { "Slow Blink", LED_MODE_BLINK_SLOW    },
-    { "Charging",   LED_MODE_BLINK_CHARGE  },
-    { "Fade Slow",  LED_MODE_FADE_SLOW     },
-    { "Fade Fast",  LED_MODE_FADE_FAST     },
-    { "Fade In",    LED_MODE_RAMP_TO_LEVEL },
-};
-static const int MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+static const ImVec4 COL_WARN    = ImVec4(0.902f, 0.706f, 0.157f, 1.0f);
 
 static const ImVec4 COL_SUCCESS  = ImVec4(0.157f, 0.784f, 0.314f, 1.0f);
 static const ImVec4 COL_ERROR    = ImVec4(0.863f, 0.235f, 0.235f, 1.0f);
@@ -194,91 +204,553 @@ static const ImVec4 COL_ACCENT   = ImVec4(0.063f, 0.486f, 0.063f, 1.0f);
 static const ImVec4 COL_ACCENT_H = ImVec4(0.078f, 0.627f, 0.078f, 1.0f);
 static const ImVec4 COL_ACCENT_A = ImVec4(0.047f, 0.392f, 0.047f, 1.0f);
 
-static void SetStatus(const char *msg, const ImVec4 &col)
+/* Any thread. Mode and brightness are taken from the command, if any. */
+static void PublishEvent(BusEventType type, const WorkerCommand *cmd, bool present,
+                         uint64_t device_id, int error = XBOX_OK)
 {
-    snprintf(g_status, sizeof(g_status), "%s", msg);
-    g_status_color = col;
-    g_redraw_frames = 3;
+    BusEvent ev = {};
+    ev.type = type;
+    ev.present = present;
+    ev.mode_idx = BUS_NO_MODE;
+    ev.error = (uint8_t)error;
+    ev.device_id = device_id;
+    ev.t_ns = xbox_time_ns();
+    if (cmd) {
+        ev.cmd = (uint8_t)cmd->type;
+        ev.flags = (cmd->preview ? BUS_FLAG_PREVIEW : 0) | (cmd->automatic ? BUS_FLAG_AUTO : 0);
+        if (cmd->type == CMD_APPLY) {
+            ev.mode_idx = (uint8_t)cmd->mode_idx;
+            ev.mode = (uint8_t)MODES[cmd->mode_idx].value;
+            ev.brightness = (uint8_t)(cmd->mode_idx == 0 ? 0 : cmd->brightness);
+        }
+    }
+    g_bus.Publish(ev);
 }
 
-static void PostWorkerCmd(WorkerCmd cmd)
+/* Worker thread, after a write completed. */
+static void PublishLatency()
 {
-    if (g_worker_busy)
-        return;
+    BusEvent ev = {};
+    ev.type = BUS_LATENCY;
+    ev.present = 1;
+    ev.mode_idx = BUS_NO_MODE;
+    ev.device_id = g_ctrl.device_id;
+    ev.t_ns = xbox_time_ns();
+    ev.latency_ns = g_ctrl.write_latency_ns;
+    g_bus.Publish(ev);
+}
+
+static void PostWorkerCmd(WorkerCmd cmd, bool preview = false, bool automatic = false)
+{
+    WorkerCommand wc = {};
+    wc.type = cmd;
+    wc.preview = preview;
+    wc.automatic = automatic;
     if (cmd == CMD_APPLY) {
-        g_worker_brightness = g_brightness;
-        g_worker_mode = g_mode_idx;
+        wc.brightness = g_cfg.brightness;
+        wc.mode_idx = g_cfg.mode_idx;
     }
-    g_worker_cmd = cmd;
-    g_worker_busy = true;
-    SetEvent(g_worker_event);
+    if (g_queue.Post(wc))
+        PublishEvent(BUS_CMD_QUEUED, &wc, g_controller_present, 0);
 }
 
-static DWORD WINAPI WorkerThread(LPVOID /*unused*/)
+static void PostAnimationFrame(uint8_t level);
+static LedAnimator    g_animator([](uint8_t level) { PostAnimationFrame(level); });
+static std::atomic<int> g_anim_mode_idx{0};
+
+/* Runs on the animator thread; frames coalesce like slider previews. */
+static void PostAnimationFrame(uint8_t level)
 {
-    while (WaitForSingleObject(g_worker_event, INFINITE) == WAIT_OBJECT_0) {
-        WorkerCmd cmd = g_worker_cmd;
-        g_worker_cmd = CMD_NONE;
-
-        if (cmd == CMD_REFRESH) {
-            xbox_close(&g_ctrl);
-            if (xbox_open(&g_ctrl)) {
-                g_controller_present = true;
-                xbox_close(&g_ctrl);
-                SetStatus("Ready - drag the slider or pick a mode", COL_SUCCESS);
-            } else {
-                g_controller_present = false;
-                SetStatus("Plug in your controller with a USB cable", COL_DIM);
-            }
-        } else if (cmd == CMD_APPLY) {
-            int mode_idx = g_worker_mode;
-            int mode_val = MODES[mode_idx].value;
-            int bright = g_worker_brightness;
-            if (mode_idx == 0) bright = 0;
-
-            if (!xbox_open(&g_ctrl)) {
-                g_controller_present = false;
-                SetStatus("Cannot open controller - try Refresh", COL_ERROR);
-            } else {
-                g_controller_present = true;
-                bool ok = xbox_set_led(&g_ctrl, (uint8_t)mode_val, (uint8_t)bright);
-                xbox_close(&g_ctrl);
-                if (ok) {
-                    if (bright == 0 || mode_idx == 0) {
-                        SetStatus("LED turned off", COL_SUCCESS);
-                    } else {
-                        char buf[128];
-                        snprintf(buf, sizeof(buf), "LED: %s at brightness %d/%d",
-                                 MODES[mode_idx].label, bright, LED_BRIGHTNESS_MAX);
-                        SetStatus(buf, COL_SUCCESS);
-                    }
-                    SaveConfig(bright, mode_idx, g_start_with_windows, g_minimize_to_tray);
-                } else {
-                    SetStatus("Command failed - try Refresh to reconnect", COL_ERROR);
-                }
+    WorkerCommand wc = {};
+    wc.type = CMD_APPLY;
+    wc.preview = true;
+    wc.mode_idx = g_anim_mode_idx;
+    wc.brightness = level;
+    g_queue.Post(wc);
+}
+
+static void UpdateAnimation()
+{
+    const ModeEntry &mode = MODES[g_cfg.mode_idx];
+    if (mode.anim < 0) {
+        g_animator.Stop();
+        return;
+    }
+
+    AnimatorConfig ac;
+    ac.curve = (AnimCurve)mode.anim;
+    ac.period_ms = (uint32_t)g_cfg.anim_period_ms;
+    ac.rate_hz = (uint32_t)g_cfg.anim_rate_hz;
+    ac.peak = (uint8_t)g_cfg.brightness;
+    ac.realtime = g_cfg.anim_realtime;
+    if (ac.curve == ANIM_CUSTOM && !LedAnimator::ParseCurve(g_cfg.anim_curve, &ac.keys))
+        LedAnimator::ParseCurve(DEFAULT_ANIM_CURVE, &ac.keys);
+
+    g_anim_mode_idx = g_cfg.mode_idx;
+    g_animator.Start(ac);
+}
+
+static void OnControllerLost()
+{
+    g_session_present = false;
+    PublishEvent(BUS_DEVICE_LEFT, nullptr, false, g_ctrl.device_id);
+}
+
+static uint64_t ArrivedNs(uint64_t device_id)
+{
+    for (int i = 0; i < g_ctrl.device_count; i++) {
+        if (g_ctrl.devices[i].device_id == device_id)
+            return g_ctrl.devices[i].arrived_ns;
+    }
+    return 0;
+}
+
+static bool ShowsOurLed(const XboxDevice &dev)
+{
+    for (int i = 0; i < g_led_applied_count; i++) {
+        if (g_led_applied[i].device_id == dev.device_id)
+            return g_led_applied[i].arrived_ns == dev.arrived_ns;
+    }
+    return false;
+}
+
+/* Every present controller gets the value, in one broadcast. */
+static bool WriteAll(uint8_t mode, uint8_t bright)
+{
+    XboxLedResult results[XBOX_MAX_DEVICES];
+    int n = xbox_set_led_many(&g_ctrl, nullptr, 0, mode, bright, results);
+    int ok = 0;
+    uint64_t now = xbox_time_ns();
+    for (int i = 0; i < n; i++) {
+        if (!results[i].ok)
+            continue;
+        g_led_applied[ok++] = { results[i].device_id, ArrivedNs(results[i].device_id) };
+        g_reconnect.Remember(results[i].device_id, mode, bright, now);
+    }
+    if (ok) {
+        g_led_mode = mode;
+        g_led_bright = bright;
+        g_led_applied_count = ok;
+    }
+    return n > 0 && ok == n;
+}
+
+/* Worker, after a successful write. */
+static void NoteKnownDevices()
+{
+    std::lock_guard<std::mutex> lock(g_known_mu);
+    bool same = g_known_count == g_led_applied_count;
+    for (int i = 0; i < g_led_applied_count && same; i++) {
+        bool found = false;
+        for (int j = 0; j < g_known_count && !found; j++)
+            found = g_known[j] == g_led_applied[i].device_id;
+        same = found;
+    }
+    if (same)
+        return;
+    for (int i = 0; i < g_led_applied_count; i++)
+        g_known[i] = g_led_applied[i].device_id;
+    g_known_count = g_led_applied_count;
+    g_known_dirty = true;
+}
+
+/* Startup skips discovery when the last run left a device list. IDs that
+   do not answer the session's reenumerate within RESCAN_WINDOW_MS are
+   dropped again, which the worker sees as XBOX_EVENT_LEFT. */
+static bool OpenSession()
+{
+    uint64_t ids[XBOX_MAX_DEVICES];
+    int n = 0;
+    if (g_try_known && !g_ctrl.open) {
+        std::lock_guard<std::mutex> lock(g_known_mu);
+        n = g_known_count;
+        memcpy(ids, g_known, sizeof(ids[0]) * (size_t)n);
+    }
+    g_try_known = false;
+    return n ? xbox_open_cached(&g_ctrl, ids, n, RESCAN_WINDOW_MS) : xbox_open(&g_ctrl);
+}
+
+/* Controllers that left or reset since the write show the default LED;
+   forget that they had ours. */
+static void PruneApplied()
+{
+    int kept = 0;
+    for (int i = 0; i < g_led_applied_count; i++) {
+        for (int j = 0; j < g_ctrl.device_count; j++) {
+            const XboxDevice &dev = g_ctrl.devices[j];
+            if (dev.device_id == g_led_applied[i].device_id && dev.state == XBOX_DEV_PRESENT &&
+                dev.arrived_ns == g_led_applied[i].arrived_ns) {
+                g_led_applied[kept++] = g_led_applied[i];
+                break;
             }
         }
-        g_worker_busy = false;
+    }
+    g_led_applied_count = kept;
+}
+
+/*
+ * Writes to controllers that are present but do not show our LED yet,
+ * which is every controller that has announced itself since the last
+ * write. They get what the others show (so an animation carries on), or
+ * the last committed apply if there are no others. g_reconnect orders and
+ * paces the writes. Runs after every pump, so the time from announce to
+ * LED is one write.
+ */
+static void ApplyArrivals()
+{
+    if (!g_have_desired || !g_ctrl.open)
+        return;
+    /* A reset re-announces without an arrival event. */
+    PruneApplied();
+
+    uint8_t mode = (uint8_t)MODES[g_desired.mode_idx].value;
+    uint8_t bright = (uint8_t)(g_desired.mode_idx == 0 ? 0 : g_desired.brightness);
+    if (g_led_applied_count) {
+        mode = g_led_mode;
+        bright = g_led_bright;
+    }
+
+    uint64_t announced = 0;
+    for (int i = 0; i < g_ctrl.device_count; i++) {
+        const XboxDevice &dev = g_ctrl.devices[i];
+        if (dev.state != XBOX_DEV_PRESENT)
+            continue;
+        g_reconnect.Touch(dev.device_id, dev.last_seen_ns);
+        if (ShowsOurLed(dev))
+            continue;
+        /* All controllers show the one value, a newcomer too; remembering
+           it does not count as activity. */
+        g_reconnect.Remember(dev.device_id, mode, bright, 0);
+        g_reconnect.Announced(dev.device_id, dev.arrived_ns);
+        if (!announced || dev.last_seen_ns < announced)
+            announced = dev.last_seen_ns;
+    }
+    if (!g_reconnect.Pending())
+        return;
+
+    std::vector<ReconnectResult> results = g_reconnect.Run(&g_ctrl);
+    if (results.empty())
+        return;
+    uint64_t now = xbox_time_ns();
+    uint64_t since = g_hotplug_ns && now - g_hotplug_ns < HOTPLUG_WINDOW_NS ? g_hotplug_ns : announced;
+    g_hotplug_ns = 0;
+    g_session_present = xbox_is_open(&g_ctrl);
+
+    WorkerCommand cmd = g_desired;
+    cmd.automatic = true;
+    bool all_ok = true;
+    for (const ReconnectResult &r : results) {
+        if (r.ok && g_led_applied_count < XBOX_MAX_DEVICES)
+            g_led_applied[g_led_applied_count++] = { r.device_id, ArrivedNs(r.device_id) };
+        all_ok = all_ok && r.ok;
+    }
+    if (!all_ok) {
+        PublishEvent(BUS_CMD_FAILED, &cmd, g_session_present, g_ctrl.device_id, g_ctrl.last_err);
+        return;
+    }
+    g_led_mode = mode;
+    g_led_bright = bright;
+    NoteKnownDevices();
+    PublishEvent(BUS_CMD_SENT, &cmd, true, results[0].device_id);
+
+    BusEvent ev = {};
+    ev.type = BUS_HOTPLUG;
+    ev.present = 1;
+    ev.mode_idx = BUS_NO_MODE;
+    ev.device_id = results[0].device_id;
+    ev.t_ns = now;
+    ev.latency_ns = now - since;
+    g_bus.Publish(ev);
+}
+
+/*
+ * Intermediate slider value. Waits out the rate cap while still pumping
+ * reads, then drops the value if a newer one was queued in the meantime.
+ */
+static void RunPreview(const WorkerCommand &cmd)
+{
+    for (;;) {
+        uint64_t now = xbox_time_ns();
+        if (now >= g_preview_next_ns)
+            break;
+        xbox_pump(&g_ctrl, (uint32_t)((g_preview_next_ns - now + 999999) / 1000000));
+    }
+    if (g_queue.HasPending(CMD_APPLY, cmd.device_id) || !xbox_is_open(&g_ctrl))
+        return;
+
+    int bright = cmd.mode_idx == 0 ? 0 : cmd.brightness;
+    if (WriteAll((uint8_t)MODES[cmd.mode_idx].value, (uint8_t)bright)) {
+        PublishEvent(BUS_CMD_SENT, &cmd, true, g_ctrl.device_id);
+        PublishLatency();
+        uint64_t interval = g_ctrl.write_latency_avg_ns;
+        if (interval < PREVIEW_MIN_INTERVAL_NS)
+            interval = PREVIEW_MIN_INTERVAL_NS;
+        g_preview_next_ns = xbox_time_ns() + interval;
+    }
+}
+
+static void RunWorkerCommand(const WorkerCommand &cmd)
+{
+    if (cmd.type == CMD_APPLY && cmd.preview) {
+        RunPreview(cmd);
+        return;
+    }
+
+    if (cmd.type == CMD_HOTPLUG) {
+        /* With the session open the announce arrives on its own; without
+           one, discovery returns as soon as the controller announces. Only
+           a controller's own interface starts the plug-in latency clock. */
+        if (!g_hotplug_ns)
+            g_hotplug_ns = cmd.t_ns;
+        if (!g_ctrl.open)
+            g_session_present = xbox_open(&g_ctrl);
+    } else if (cmd.type == CMD_REFRESH) {
+        g_session_present = xbox_open(&g_ctrl);
+        if (g_session_present)
+            PublishEvent(BUS_CMD_SENT, &cmd, true, g_ctrl.device_id);
+        else
+            PublishEvent(BUS_CMD_FAILED, &cmd, false, 0, g_ctrl.last_err);
+    } else if (cmd.type == CMD_RESCAN) {
+        if (!xbox_rescan(&g_ctrl, RESCAN_WINDOW_MS) && g_session_present)
+            OnControllerLost();
+    } else if (cmd.type == CMD_APPLY) {
+        g_desired = cmd;
+        g_have_desired = true;
+
+        /* Nothing to write to yet; the first announce will apply it. */
+        if (cmd.automatic && g_ctrl.open && !xbox_device_count(&g_ctrl)) {
+            PublishEvent(BUS_CMD_FAILED, &cmd, false, 0, XBOX_ERR_NO_DEVICE);
+            return;
+        }
+
+        int mode_idx = cmd.mode_idx;
+        int mode_val = MODES[mode_idx].value;
+        int bright = cmd.brightness;
+        if (mode_idx == 0) bright = 0;
+
+        /* The session stays open between applies; a failed write closes
+           it, so one retry covers a controller that was replugged. */
+        bool ok = false;
+        for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+            if (!OpenSession())
+                break;
+            ok = WriteAll((uint8_t)mode_val, (uint8_t)bright);
+        }
+
+        g_session_present = xbox_is_open(&g_ctrl);
+        if (ok) {
+            NoteKnownDevices();
+            PublishEvent(BUS_CMD_SENT, &cmd, true, g_ctrl.device_id);
+            PublishLatency();
+        } else {
+            PublishEvent(BUS_CMD_FAILED, &cmd, g_session_present, g_ctrl.device_id, g_ctrl.last_err);
+        }
+    }
+}
+
+/* Controllers that missed the last write still show the LED they reset to
+   when they connected. */
+static void PublishStatus()
+{
+    StatusDevice out[STATUS_MAX_DEVICES] = {};
+    uint32_t n = 0;
+    for (int i = 0; g_ctrl.open && i < g_ctrl.device_count && n < STATUS_MAX_DEVICES; i++) {
+        const XboxDevice &dev = g_ctrl.devices[i];
+        if (dev.state != XBOX_DEV_PRESENT)
+            continue;
+        bool ours = ShowsOurLed(dev);
+        out[n].device_id = dev.device_id;
+        out[n].present = 1;
+        out[n].mode = ours ? g_led_mode : (uint8_t)LED_MODE_ON;
+        out[n].brightness = ours ? g_led_bright : (uint8_t)LED_BRIGHTNESS_DEFAULT;
+        n++;
+    }
+    g_status_page.Publish(out, n);
+}
+
+/*
+ * The worker owns the XboxGIP session. While it waits for the next command
+ * it keeps a read posted, so announces and disconnects land in the device
+ * table as they happen. Commands are drained until the queue is empty, so
+ * anything posted during an apply is picked up before the worker sleeps.
+ */
+static DWORD WINAPI WorkerThread(LPVOID /*unused*/)
+{
+    while (!g_queue.Closed()) {
+        unsigned events = xbox_pump(&g_ctrl, GIP_WAIT_INFINITE);
+        if ((events & XBOX_EVENT_LEFT) && g_session_present && !xbox_is_open(&g_ctrl))
+            OnControllerLost();
+        if (events & XBOX_EVENT_ARRIVED)
+            PublishEvent(BUS_DEVICE_ARRIVED, nullptr, g_session_present, g_ctrl.device_id);
+        if (events)
+            PruneApplied();
+
+        WorkerCommand cmd;
+        while (!g_queue.Closed() && g_queue.Take(&cmd))
+            RunWorkerCommand(cmd);
+        ApplyArrivals();
+        PublishStatus();
+        g_frames_sent.store(g_ctrl.write_stats.sent, std::memory_order_relaxed);
+        g_frames_suppressed.store(g_ctrl.write_stats.suppressed, std::memory_order_relaxed);
     }
     return 0;
 }
 
 static void ApplyLed()
 {
-    SetStatus("Sending command...", COL_DIM);
+    UpdateAnimation();
     PostWorkerCmd(CMD_APPLY);
 }
 
 static void RefreshController()
 {
-    SetStatus("Searching for controller...", COL_DIM);
     PostWorkerCmd(CMD_REFRESH);
 }
 
 static void TryAutoApply()
 {
-    SetStatus("Controller detected - applying settings...", COL_DIM);
-    PostWorkerCmd(CMD_APPLY);
+    UpdateAnimation();
+    PostWorkerCmd(CMD_APPLY, false, true);
+}
+
+static const char *FormatStatus(char *buf, size_t len, ImVec4 *col)
+{
+    const BusEvent &ev = g_status_event;
+    *col = COL_DIM;
+    if (!g_have_status)
+        return "Plug in your controller with a USB cable";
+
+    switch (ev.type) {
+    case BUS_DEVICE_LEFT:
+        return "Controller disconnected";
+    case BUS_CMD_QUEUED:
+        if (ev.cmd == CMD_REFRESH)
+            return "Searching for controller...";
+        return (ev.flags & BUS_FLAG_AUTO) ? "Applying saved settings..." : "Sending command...";
+    case BUS_CMD_SENT:
+        *col = COL_SUCCESS;
+        if (ev.cmd == CMD_REFRESH)
+            return "Ready - drag the slider or pick a mode";
+        if (ev.brightness == 0 || ev.mode_idx == 0)
+            return "LED turned off";
+        snprintf(buf, len, "LED: %s at brightness %d/%d",
+                 MODES[ev.mode_idx].label, ev.brightness, LED_BRIGHTNESS_MAX);
+        return buf;
+    case BUS_CMD_FAILED:
+        if (ev.cmd == CMD_REFRESH || ((ev.flags & BUS_FLAG_AUTO) && ev.error == XBOX_ERR_NO_DEVICE))
+            return "Plug in your controller with a USB cable";
+        *col = COL_ERROR;
+        return ev.error == XBOX_ERR_SEND ? "Command failed - try Refresh to reconnect"
+                                         : "Cannot open controller - try Refresh";
+    default:
+        return "";
+    }
+}
+
+/* Status line and presence. A committed apply is saved here rather than
+   on the worker, so the worker never touches the disk. */
+static void DrainGuiEvents()
+{
+    BusEvent ev;
+    while (g_bus.Poll(g_sub_gui, &ev)) {
+        if (ev.flags & BUS_FLAG_PREVIEW)
+            continue;
+        if (ev.type != BUS_CMD_QUEUED)
+            g_controller_present = ev.present;
+        if (ev.type == BUS_CMD_SENT && ev.cmd == CMD_APPLY) {
+            bool known_changed = false;
+            {
+                std::lock_guard<std::mutex> lock(g_known_mu);
+                if (g_known_dirty) {
+                    memcpy(g_cfg.known_devices, g_known, sizeof(g_known[0]) * (size_t)g_known_count);
+                    g_cfg.known_device_count = g_known_count;
+                    g_known_dirty = false;
+                    known_changed = true;
+                }
+            }
+            if (!(ev.flags & BUS_FLAG_AUTO)) {
+                AppConfig saved = g_cfg;
+                saved.brightness = ev.brightness;
+                saved.mode_idx = ev.mode_idx;
+                SaveConfig(g_config_path, saved);
+            } else if (known_changed) {
+                SaveConfig(g_config_path, g_cfg);
+            }
+        }
+        g_status_event = ev;
+        g_have_status = true;
+        g_redraw_frames = 3;
+    }
+}
+
+static void DrainTrayEvents()
+{
+    static bool shown_present = false;
+    bool present = shown_present;
+    BusEvent ev;
+    while (g_bus.Poll(g_sub_tray, &ev)) {
+        if (!(ev.flags & BUS_FLAG_PREVIEW))
+            present = ev.present;
+    }
+    if (present == shown_present)
+        return;
+    shown_present = present;
+    NOTIFYICONDATAW nid = g_nid;
+    nid.uFlags = NIF_TIP;
+    wcscpy_s(nid.szTip, present ? L"Xbox LED Control - controller connected" : L"Xbox LED Control");
+    Shell_NotifyIconW(NIM_MODIFY, &nid);
+}
+
+static void DrainMetricsEvents()
+{
+    BusEvent ev;
+    while (g_bus.Poll(g_sub_metrics, &ev)) {
+        if (ev.type == BUS_CMD_SENT && (ev.flags & BUS_FLAG_PREVIEW))
+            g_preview_writes++;
+        else if (ev.type == BUS_LATENCY)
+            g_write_latency_ms = g_write_latency_ms * 0.875 + ev.latency_ns / 1e6 * 0.125;
+        else if (ev.type == BUS_HOTPLUG)
+            g_hotplug_ms = ev.latency_ns / 1e6;
+    }
+}
+
+static void DrainLogEvents()
+{
+    static const char *const NAMES[BUS_EVENT_TYPES] = {
+        "arrived", "left", "queued", "sent", "failed", "latency", "hotplug"
+    };
+    BusEvent ev;
+    bool wrote = false;
+    while (g_bus.Poll(g_sub_log, &ev)) {
+        fprintf(g_log, "%llu %s cmd=%u flags=%u present=%u device=%016llx mode=0x%02x brightness=%u"
+                       " error=%u latency_ns=%llu\n",
+                (unsigned long long)ev.t_ns, NAMES[ev.type], ev.cmd, ev.flags, ev.present,
+                (unsigned long long)ev.device_id, ev.mode, ev.brightness, ev.error,
+                (unsigned long long)ev.latency_ns);
+        wrote = true;
+    }
+    if (wrote)
+        fflush(g_log);
+}
+
+static void DrainEvents()
+{
+    DrainGuiEvents();
+    DrainTrayEvents();
+    DrainMetricsEvents();
+    if (g_log)
+        DrainLogEvents();
+}
+
+static HotplugSource HotplugDeviceSource(const DEV_BROADCAST_HDR *hdr)
+{
+    if (!hdr || hdr->dbch_devicetype != DBT_DEVTYP_DEVICEINTERFACE)
+        return HOTPLUG_UNKNOWN;
+    const DEV_BROADCAST_DEVICEINTERFACE_W *di = (const DEV_BROADCAST_DEVICEINTERFACE_W *)hdr;
+    char path[512];
+    if (!WideCharToMultiByte(CP_UTF8, 0, di->dbcc_name, -1, path, sizeof(path), nullptr, nullptr))
+        return HOTPLUG_UNKNOWN;
+    return HotplugTracker::Classify(path);
 }
 
 static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -299,7 +771,7 @@ static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
         break;
     case WM_SIZE:
         if (wParam == SIZE_MINIMIZED) {
-            if (g_minimize_to_tray) {
+            if (g_cfg.minimize_to_tray) {
                 MinimizeToTray(hWnd);
                 return 0;
             }
@@ -310,12 +782,16 @@ static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
     case WM_SYSCOMMAND:
         if ((wParam & 0xfff0) == SC_KEYMENU) return 0;
-        if ((wParam & 0xfff0) == SC_CLOSE && g_minimize_to_tray) {
+        if ((wParam & 0xfff0) == SC_CLOSE && g_cfg.minimize_to_tray) {
             MinimizeToTray(hWnd);
             return 0;
         }
         break;
 
+    case WM_APP_BUS:
+        /* Only wakes the loop, which drains the bus after dispatching. */
+        return 0;
+
     case WM_TRAYICON:
         if (lParam == WM_LBUTTONDBLCLK) {
             RestoreFromTray(hWnd);
@@ -340,18 +816,17 @@ static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
         return 0;
 
     case WM_DEVICECHANGE: {
-        if (wParam == DBT_DEVICEARRIVAL) {
-            g_device_change_pending = true;
-            g_device_change_tick = GetTickCount();
-        }
+        /* Only recorded here; the main loop turns what g_hotplug decides
+           into worker commands. */
+        uint64_t now = xbox_time_ns();
         if (wParam == DBT_DEVNODES_CHANGED) {
-            if (!g_device_change_pending) {
-                g_device_change_pending = true;
-                g_device_change_tick = GetTickCount();
-            }
-        }
-        if (wParam == DBT_DEVICEREMOVECOMPLETE) {
-            g_device_removed = true;
+            g_hotplug.Arrival(HOTPLUG_UNKNOWN, now);
+        } else if (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVICEREMOVECOMPLETE) {
+            HotplugSource src = HotplugDeviceSource((const DEV_BROADCAST_HDR *)lParam);
+            if (wParam == DBT_DEVICEARRIVAL)
+                g_hotplug.Arrival(src, now);
+            else
+                g_hotplug.Removal(src, now);
         }
         return 0;
     }
@@ -405,7 +880,7 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
         ImGui::PopFont();
 
         ImGui::SameLine(ImGui::GetContentRegionAvail().x - 60);
-        float pct = (float)g_brightness / LED_BRIGHTNESS_MAX;
+        float pct = (float)g_cfg.brightness / LED_BRIGHTNESS_MAX;
         ImVec4 numCol = ImVec4(
             0.063f + 0.094f * pct,
             0.486f + (0.863f - 0.486f) * pct,
@@ -413,24 +888,43 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
             1.0f
         );
         ImGui::PushFont(fontBig);
-        ImGui::TextColored(numCol, "%d", g_brightness);
+        ImGui::TextColored(numCol, "%d", g_cfg.brightness);
         ImGui::PopFont();
 
         ImGui::SetNextItemWidth(-1);
-        if (ImGui::SliderInt("##brightness", &g_brightness, 0, LED_BRIGHTNESS_MAX, "", ImGuiSliderFlags_None)) {
+        if (ImGui::SliderInt("##brightness", &g_cfg.brightness, 0, LED_BRIGHTNESS_MAX, "", ImGuiSliderFlags_None)) {
+            if (g_cfg.live_preview && g_controller_present && MODES[g_cfg.mode_idx].anim < 0)
+                PostWorkerCmd(CMD_APPLY, true);
+        }
+        if (ImGui::IsItemActivated()) {
+            g_preview_t0_ns = xbox_time_ns();
+            g_preview_w0 = g_preview_writes;
+            g_preview_rate = 0.0f;
+        }
+        bool dragging = ImGui::IsItemActive();
+        if (dragging && g_cfg.live_preview) {
+            double secs = (xbox_time_ns() - g_preview_t0_ns) / 1e9;
+            if (secs > 0.25)
+                g_preview_rate = (float)((double)(g_preview_writes - g_preview_w0) / secs);
         }
         if (ImGui::IsItemDeactivatedAfterEdit()) {
             ApplyLed();
         }
 
         ImGui::TextColored(COL_DIM, "0");
+        if (g_cfg.live_preview && g_preview_rate > 0.0f) {
+            ImGui::SameLine();
+            ImGui::TextColored(COL_DIM, "  live %.0f updates/s, %.1f ms per write, %llu unchanged",
+                               g_preview_rate, g_write_latency_ms,
+                               (unsigned long long)g_frames_suppressed.load(std::memory_order_relaxed));
+        }
         ImGui::SameLine(ImGui::GetContentRegionAvail().x - 20);
         ImGui::TextColored(COL_DIM, "%d", LED_BRIGHTNESS_MAX);
     }
     ImGui::EndChild();
     ImGui::Spacing();
 
-    ImGui::BeginChild("##mode_card", ImVec2(-1, 80), ImGuiChildFlags_Borders);
+    ImGui::BeginChild("##mode_card", ImVec2(-1, 125), ImGuiChildFlags_Borders);
     {
         ImGui::PushFont(fontSub);
         ImGui::TextColored(COL_DIM, "LED MODE");
@@ -438,9 +932,9 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
         ImGui::Spacing();
 
         for (int i = 0; i < MODE_COUNT; i++) {
-            if (i > 0) ImGui::SameLine();
+            if (i > 0 && i != FIRST_HOST_MODE) ImGui::SameLine();
 
-            bool is_active = (i == g_mode_idx);
+            bool is_active = (i == g_cfg.mode_idx);
             if (is_active) {
                 ImGui::PushStyleColor(ImGuiCol_Button,        COL_ACCENT);
                 ImGui::PushStyleColor(ImGuiCol_ButtonHovered,  COL_ACCENT_H);
@@ -449,7 +943,7 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
             }
 
             if (ImGui::Button(MODES[i].label)) {
-                g_mode_idx = i;
+                g_cfg.mode_idx = i;
                 ApplyLed();
             }
 
@@ -461,7 +955,7 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
 
     ImGui::Spacing();
 
-    bool busy = g_worker_busy;
+    bool busy = g_queue.Busy();
     ImGui::BeginDisabled(busy);
 
     ImGui::PushStyleColor(ImGuiCol_Button,       COL_ACCENT);
@@ -488,19 +982,30 @@ static void RenderGui(ImFont *fontTitle, ImFont *fontSub, ImFont *fontBig)
     ImGui::EndDisabled();
 
     ImGui::Spacing();
-    ImGui::TextColored(g_status_color, "%s", g_status);
+    char status_buf[128];
+    ImVec4 status_col;
+    const char *status = FormatStatus(status_buf, sizeof(status_buf), &status_col);
+    ImGui::TextColored(status_col, "%s", status);
+    if (g_hotplug_ms >= 0.0) {
+        ImGui::SameLine();
+        ImGui::TextColored(COL_DIM, "  (plug-in to LED %.0f ms)", g_hotplug_ms);
+    }
 
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::Spacing();
 
-    if (ImGui::Checkbox("Start with Windows", &g_start_with_windows)) {
-        SetAutoStart(g_start_with_windows);
-        SaveConfig(g_brightness, g_mode_idx, g_start_with_windows, g_minimize_to_tray);
+    if (ImGui::Checkbox("Start with Windows", &g_cfg.start_with_windows)) {
+        SetAutoStart(g_cfg.start_with_windows);
+        SaveConfig(g_config_path, g_cfg);
+    }
+    ImGui::SameLine(0, 20);
+    if (ImGui::Checkbox("Minimize to tray", &g_cfg.minimize_to_tray)) {
+        SaveConfig(g_config_path, g_cfg);
     }
     ImGui::SameLine(0, 20);
-    if (ImGui::Checkbox("Minimize to tray", &g_minimize_to_tray)) {
-        SaveConfig(g_brightness, g_mode_idx, g_start_with_windows, g_minimize_to_tray);
+    if (ImGui::Checkbox("Live preview", &g_cfg.live_preview)) {
+        SaveConfig(g_config_path, g_cfg);
     }
 
     ImGui::End();
@@ -554,6 +1059,25 @@ static void CleanupRenderTarget()
     if (g_mainRenderTargetView) { g_mainRenderTargetView->Release(); g_mainRenderTargetView = nullptr; }
 }
 
+/* Value of "--name value" or "--name "quoted value"" on the command line. */
+static bool GetArg(const char *cmdline, const char *name, char *out, size_t out_len)
+{
+    const char *p = strstr(cmdline, name);
+    if (!p || out_len == 0)
+        return false;
+    p += strlen(name);
+    while (*p == ' ')
+        p++;
+    char end = ' ';
+    if (*p == '"')
+        end = *p++;
+    size_t n = 0;
+    while (*p && *p != end && n + 1 < out_len)
+        out[n++] = *p++;
+    out[n] = '\0';
+    return n > 0;
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
 {
     HANDLE hMutex = CreateMutexW(nullptr, TRUE, L"Global\\xbledctl_single_instance");
@@ -566,20 +1090,46 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
     }
 
     bool start_minimized = (strstr(lpCmdLine, "--minimized") != nullptr);
+    bool simulate = (strstr(lpCmdLine, "--simulate") != nullptr);
+
+    if (simulate) {
+        GipLoopbackConfig sim = {};
+        sim.announce_latency_us = 20000;
+        sim.write_latency_us = 500;
+        GipTransport t = gip_loopback_create(&sim);
+        gip_loopback_add_device(t, 0x7E5700000001ull);
+        xbox_init_with_transport(&g_ctrl, t);
+    } else {
+        xbox_init(&g_ctrl);
+    }
 
-    xbox_init(&g_ctrl);
-    g_status_color = COL_DIM;
-    g_worker_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    char capture_path[MAX_PATH];
+    if (GetArg(lpCmdLine, "--capture", capture_path, sizeof(capture_path)))
+        g_ctrl.transport = gip_capture_create(g_ctrl.transport, capture_path);
+    char log_path[MAX_PATH];
+    if (GetArg(lpCmdLine, "--log", log_path, sizeof(log_path)))
+        g_log = fopen(log_path, "a");
+    /* Not fatal: xbledctld may already be publishing. */
+    g_status_page.Create(StatusPageDefaultName().c_str(), nullptr);
+    /* Close() wakes the worker; a discovery in progress then gives up
+       rather than running out its window past WORKER_EXIT_TIMEOUT_MS. */
+    xbox_set_interrupt(&g_ctrl, [](void *) { return g_queue.Closed(); }, nullptr);
     g_worker_thread = CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
 
-    InitConfigPath();
-    LoadConfig(&g_brightness, &g_mode_idx, &g_start_with_windows, &g_minimize_to_tray);
+    DefaultConfigPath(g_config_path, sizeof(g_config_path));
+    LoadConfig(g_config_path, &g_cfg);
+    {
+        /* The worker is already running. */
+        std::lock_guard<std::mutex> lock(g_known_mu);
+        memcpy(g_known, g_cfg.known_devices, sizeof(g_known[0]) * (size_t)g_cfg.known_device_count);
+        g_known_count = g_cfg.known_device_count;
+    }
 
     WNDCLASSEXW wc = { sizeof(wc), CS_CLASSDC, WndProc, 0L, 0L, hInstance,
         nullptr, nullptr, nullptr, nullptr, L"xbledctl", nullptr };
     RegisterClassExW(&wc);
 
-    RECT wr = { 0, 0, 520, 500 };
+    RECT wr = { 0, 0, 520, 545 };
     DWORD style = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX;
     AdjustWindowRect(&wr, style, FALSE);
 
@@ -594,10 +1144,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
         return 1;
     }
 
-    DEV_BROADCAST_DEVICEINTERFACE dbdi = {};
-    dbdi.dbcc_size = sizeof(dbdi);
-    dbdi.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
-    RegisterDeviceNotification(g_hwnd, &dbdi, DEVICE_NOTIFY_WINDOW_HANDLE | DEVICE_NOTIFY_ALL_INTERFACE_CLASSES);
+    for (int i = 0; i < 2; i++) {
+        DEV_BROADCAST_DEVICEINTERFACE_W dbdi = {};
+        dbdi.dbcc_size = sizeof(dbdi);
+        dbdi.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+        dbdi.dbcc_classguid = HOTPLUG_CLASSES[i];
+        g_dev_notify[i] = RegisterDeviceNotificationW(g_hwnd, &dbdi, DEVICE_NOTIFY_WINDOW_HANDLE);
+    }
 
     AddTrayIcon(g_hwnd);
 
@@ -627,20 +1180,42 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
     if (!fontSub)     fontSub     = fontDefault;
     fontBig = fontTitle;
 
-    RefreshController();
-    if (g_controller_present)
-        ApplyLed();
+    /* Events published before this point have no subscriber and are lost,
+       which is fine: the worker has not been given a command yet. */
+    auto wake_ui = [hwnd = g_hwnd] { PostMessageW(hwnd, WM_APP_BUS, 0, 0); };
+    const uint32_t status_mask = BUS_MASK(BUS_DEVICE_LEFT) | BUS_MASK(BUS_CMD_QUEUED) |
+                                 BUS_MASK(BUS_CMD_SENT) | BUS_MASK(BUS_CMD_FAILED);
+    g_sub_gui = g_bus.Subscribe(status_mask, wake_ui);
+    g_sub_tray = g_bus.Subscribe(BUS_MASK(BUS_DEVICE_LEFT) | BUS_MASK(BUS_CMD_SENT) |
+                                 BUS_MASK(BUS_CMD_FAILED), wake_ui);
+    g_sub_metrics = g_bus.Subscribe(BUS_MASK(BUS_CMD_SENT) | BUS_MASK(BUS_LATENCY) |
+                                    BUS_MASK(BUS_HOTPLUG), wake_ui);
+    if (g_log)
+        g_sub_log = g_bus.Subscribe(BUS_MASK_ALL, wake_ui);
+
+    /* With controllers remembered from the last run the auto-apply goes
+       straight to them; otherwise look for one first. */
+    if (!g_cfg.known_device_count)
+        RefreshController();
+    TryAutoApply();
 
-    g_start_with_windows = IsAutoStartEnabled();
+    g_cfg.start_with_windows = IsAutoStartEnabled();
 
     const float clear[4] = { 0.071f, 0.071f, 0.094f, 1.0f };
 
     bool done = false;
     while (!done) {
-        if (g_minimized_to_tray && !g_device_change_pending && !g_device_removed) {
-            WaitMessage();
-        } else if (g_redraw_frames <= 0 && !g_device_change_pending && !g_device_removed) {
-            MsgWaitForMultipleObjects(0, nullptr, FALSE, 100, QS_ALLINPUT);
+        if (g_minimized_to_tray || g_redraw_frames <= 0) {
+            DWORD wait = g_minimized_to_tray ? INFINITE : 100;
+            uint64_t due = g_hotplug.Deadline();
+            if (due) {
+                uint64_t now = xbox_time_ns();
+                DWORD left = due > now ? (DWORD)((due - now + 999999) / 1000000) : 0;
+                if (left < wait)
+                    wait = left;
+            }
+            if (wait)
+                MsgWaitForMultipleObjects(0, nullptr, FALSE, wait, QS_ALLINPUT);
         }
 
         MSG msg;
@@ -652,22 +1227,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
         }
         if (done) break;
 
-        if (g_device_removed) {
-            g_device_removed = false;
-            if (g_controller_present) {
-                xbox_close(&g_ctrl);
-                g_controller_present = false;
-                SetStatus("Controller disconnected", COL_DIM);
-                g_device_change_pending = false;
-            }
-        }
-
-        if (g_device_change_pending && !g_controller_present
-            && (GetTickCount() - g_device_change_tick) >= 1000) {
-            g_device_change_pending = false;
-            TryAutoApply();
-        } else if (g_device_change_pending && g_controller_present) {
-            g_device_change_pending = false;
+        DrainEvents();
+
+        /* A rescan only reports a disconnect if our controller stops
+           answering; a discover with the session open just timestamps the
+           arrival for the plug-in latency. */
+        g_hotplug.SetControllerPresent(g_controller_present);
+        uint64_t arrival_ns = 0;
+        unsigned hotplug = g_hotplug.Poll(xbox_time_ns(), &arrival_ns);
+        if (hotplug & HOTPLUG_RESCAN)
+            PostWorkerCmd(CMD_RESCAN);
+        if (hotplug & HOTPLUG_DISCOVER) {
+            WorkerCommand wc = {};
+            wc.type = CMD_HOTPLUG;
+            wc.t_ns = arrival_ns;
+            g_queue.Post(wc);
         }
 
         if (g_minimized_to_tray)
@@ -708,10 +1282,28 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
         g_redraw_frames--;
     }
 
-    TerminateThread(g_worker_thread, 0);
+    /* The worker finishes the command in hand and returns. That is normally
+       one write, and discovery stops when the queue closes, but a stalled
+       write can take seconds; past the timeout the session is left to
+       process exit rather than freed under the worker. */
+    for (HDEVNOTIFY h : g_dev_notify) {
+        if (h)
+            UnregisterDeviceNotification(h);
+    }
+    g_animator.Stop();
+    g_queue.Close();
+    bool worker_done = WaitForSingleObject(g_worker_thread, WORKER_EXIT_TIMEOUT_MS) == WAIT_OBJECT_0;
     CloseHandle(g_worker_thread);
-    CloseHandle(g_worker_event);
-    xbox_cleanup(&g_ctrl);
+    if (worker_done) {
+        /* The worker publishes to the page after every command. */
+        g_status_page.Close();
+        xbox_cleanup(&g_ctrl);
+    }
+    if (g_log) {
+        fprintf(g_log, "writes sent %llu, suppressed %llu\n",
+                (unsigned long long)g_frames_sent.load(), (unsigned long long)g_frames_suppressed.load());
+        fclose(g_log);
+    }
 
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -0,0 +1,74 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bounded lock-free ring for any number of producers and one consumer.
+ * Each cell carries a sequence number: a producer claims a slot by moving
+ * the tail with a CAS and publishes the value by advancing the cell's
+ * sequence, so the consumer never sees a half-written entry. Push fails
+ * instead of waiting when the ring is full.
+ */
+template <typename T, size_t N>
+class MpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    MpscRing()
+    {
+        for (size_t i = 0; i < N; i++)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    bool Push(const T &value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & (N - 1)];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Consumer thread only. */
+    bool Pop(T *out)
+    {
+        Cell &cell = m_cells[m_head & (N - 1)];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0)
+            return false;
+        *out = cell.value;
+        cell.seq.store(m_head + N, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T                   value;
+    };
+
+    Cell                              m_cells[N];
+    alignas(64) std::atomic<size_t>   m_tail{0};
+    alignas(64) size_t                m_head = 0;
+};
+
+#endif /* MPSC_RING_H */
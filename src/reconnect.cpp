@@ -0,0 +1,150 @@
+#include "reconnect.h"
+
+#include <algorithm>
+
+ReconnectScheduler::ReconnectScheduler(int concurrency)
+{
+    SetConcurrency(concurrency);
+}
+
+void ReconnectScheduler::SetConcurrency(int frames)
+{
+    if (frames < 1)
+        frames = 1;
+    if (frames > XBOX_BATCH_WINDOW_MAX)
+        frames = XBOX_BATCH_WINDOW_MAX;
+    m_concurrency = frames;
+}
+
+void ReconnectScheduler::Remember(uint64_t device_id, uint8_t mode, uint8_t brightness,
+                                  uint64_t now_ns)
+{
+    auto it = m_saved.find(device_id);
+    if (it == m_saved.end() && m_saved.size() >= MAX_REMEMBERED) {
+        /* Forget the controller that has been quiet the longest. */
+        auto oldest = m_saved.begin();
+        for (auto s = m_saved.begin(); s != m_saved.end(); ++s) {
+            if (s->second.active_ns < oldest->second.active_ns)
+                oldest = s;
+        }
+        m_saved.erase(oldest);
+    }
+    Saved &s = m_saved[device_id];
+    s.mode = mode;
+    s.brightness = brightness;
+    s.active_ns = std::max(s.active_ns, now_ns);
+}
+
+void ReconnectScheduler::Touch(uint64_t device_id, uint64_t now_ns)
+{
+    auto it = m_saved.find(device_id);
+    if (it != m_saved.end() && now_ns > it->second.active_ns)
+        it->second.active_ns = now_ns;
+}
+
+bool ReconnectScheduler::Announced(uint64_t device_id, uint64_t announce_ns)
+{
+    if (m_saved.find(device_id) == m_saved.end())
+        return false;
+    for (const Queued &q : m_queue) {
+        if (q.device_id == device_id)
+            return true;
+    }
+    m_queue.push_back({ device_id, announce_ns });
+    return true;
+}
+
+int ReconnectScheduler::Bucket(uint64_t ns)
+{
+    uint64_t ms = ns / 1000000;
+    int b = 0;
+    while (ms && b < RECONNECT_HIST_BUCKETS - 1) {
+        ms >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static bool IsPresent(const XboxController *ctrl, uint64_t device_id)
+{
+    for (int i = 0; ctrl->open && i < ctrl->device_count; i++) {
+        if (ctrl->devices[i].device_id == device_id)
+            return ctrl->devices[i].state == XBOX_DEV_PRESENT;
+    }
+    return false;
+}
+
+std::vector<ReconnectResult> ReconnectScheduler::Run(XboxController *ctrl)
+{
+    std::vector<Queued> queue;
+    queue.swap(m_queue);
+
+    /* Gone again already; the next announce queues it afresh. */
+    queue.erase(std::remove_if(queue.begin(), queue.end(),
+                               [ctrl](const Queued &q) { return !IsPresent(ctrl, q.device_id); }),
+                queue.end());
+    if (queue.empty())
+        return {};
+
+    std::stable_sort(queue.begin(), queue.end(), [this](const Queued &a, const Queued &b) {
+        return m_saved[a.device_id].active_ns > m_saved[b.device_id].active_ns;
+    });
+    /* One batch holds XBOX_MAX_DEVICES; the rest wait for the next call,
+       ahead of anything announced meanwhile. */
+    if (queue.size() > XBOX_MAX_DEVICES) {
+        m_queue.insert(m_queue.begin(), queue.begin() + XBOX_MAX_DEVICES, queue.end());
+        queue.resize(XBOX_MAX_DEVICES);
+    }
+
+    XboxLedTarget targets[XBOX_MAX_DEVICES];
+    for (size_t i = 0; i < queue.size(); i++) {
+        const Saved &s = m_saved[queue[i].device_id];
+        targets[i].device_id = queue[i].device_id;
+        targets[i].mode = s.mode;
+        targets[i].brightness = s.brightness;
+    }
+
+    int window = ctrl->batch_window;
+    xbox_set_batch_window(ctrl, m_concurrency);
+    XboxLedResult results[XBOX_MAX_DEVICES];
+    int n = xbox_set_led_each(ctrl, targets, (int)queue.size(), results);
+    xbox_set_batch_window(ctrl, window);
+
+    std::vector<ReconnectResult> out;
+    uint64_t first_ns = UINT64_MAX, last_ns = 0;
+    uint32_t written = 0;
+    for (int i = 0; i < n; i++) {
+        ReconnectResult r = {};
+        r.device_id = results[i].device_id;
+        r.mode = targets[i].mode;
+        r.brightness = targets[i].brightness;
+        r.ok = results[i].ok;
+        if (r.ok) {
+            uint64_t announce = queue[i].announce_ns;
+            r.apply_ns = results[i].done_ns > announce ? results[i].done_ns - announce : 0;
+            first_ns = std::min(first_ns, announce);
+            last_ns = std::max(last_ns, results[i].done_ns);
+            m_stats.apply_hist[Bucket(r.apply_ns)]++;
+            m_stats.applied++;
+            written++;
+        } else {
+            r.error = ctrl->last_err != XBOX_OK ? ctrl->last_err : XBOX_ERR_SEND;
+            m_stats.failed++;
+        }
+        out.push_back(r);
+    }
+
+    if (written) {
+        if (m_stats.last_storm_devices && first_ns <= m_storm_last_ns) {
+            m_stats.last_storm_devices += written;
+        } else {
+            m_stats.storms++;
+            m_storm_first_ns = first_ns;
+            m_stats.last_storm_devices = written;
+        }
+        m_storm_last_ns = std::max(m_storm_last_ns, last_ns);
+        m_stats.last_storm_ns = m_storm_last_ns > m_storm_first_ns ? m_storm_last_ns - m_storm_first_ns : 0;
+        m_stats.max_storm_ns = std::max(m_stats.max_storm_ns, m_stats.last_storm_ns);
+    }
+    return out;
+}
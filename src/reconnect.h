@@ -0,0 +1,97 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+/* Time-to-apply buckets: under 1 ms, under 2 ms, ... doubling; the last
+   one takes everything slower. */
+#define RECONNECT_HIST_BUCKETS 12
+
+struct ReconnectStats {
+    uint64_t storms;             /* a Run() for controllers that announced while the
+                                    previous one was writing continues its storm */
+    uint64_t applied;
+    uint64_t failed;
+    uint64_t last_storm_ns;      /* first announce to last LED written */
+    uint32_t last_storm_devices;
+    uint64_t max_storm_ns;
+    uint32_t apply_hist[RECONNECT_HIST_BUCKETS];   /* announce to written, per controller */
+};
+
+struct ReconnectResult {
+    uint64_t device_id;
+    uint8_t  mode;
+    uint8_t  brightness;
+    bool     ok;
+    uint64_t apply_ns;   /* announce to written; 0 if the write failed */
+    int      error;      /* XBOX_ERR_* when !ok */
+};
+
+/*
+ * Puts a controller's LED back the way it was when it announces again,
+ * e.g. after a hub reset brings every controller back at once. Values are
+ * remembered per device ID across departures. Controllers that were
+ * active most recently go first, and at most Concurrency() frames are in
+ * flight, so a storm neither floods the transport nor leaves the last
+ * controller behind N serial writes.
+ *
+ * Worker thread only.
+ */
+class ReconnectScheduler {
+public:
+    static constexpr int    DEFAULT_CONCURRENCY = 4;
+    static constexpr size_t MAX_REMEMBERED = 64;
+
+    explicit ReconnectScheduler(int concurrency = DEFAULT_CONCURRENCY);
+
+    void SetConcurrency(int frames);
+    int  Concurrency() const { return m_concurrency; }
+
+    /* The controller was set to this value. */
+    void Remember(uint64_t device_id, uint8_t mode, uint8_t brightness, uint64_t now_ns);
+
+    /* The controller sent something (input, status, ack). */
+    void Touch(uint64_t device_id, uint64_t now_ns);
+
+    /* Queues a re-apply if a value is remembered for the controller;
+       returns whether it did. */
+    bool Announced(uint64_t device_id, uint64_t announce_ns);
+
+    bool Pending() const { return !m_queue.empty(); }
+
+    /* Writes the remembered values to queued controllers that are still
+       present, at most XBOX_MAX_DEVICES per call; Pending() tells whether
+       more are left. */
+    std::vector<ReconnectResult> Run(XboxController *ctrl);
+
+    ReconnectStats Stats() const { return m_stats; }
+
+    static int Bucket(uint64_t ns);
+
+private:
+    struct Saved {
+        uint8_t  mode;
+        uint8_t  brightness;
+        uint64_t active_ns;
+    };
+    struct Queued {
+        uint64_t device_id;
+        uint64_t announce_ns;
+    };
+
+    int                       m_concurrency;
+    std::map<uint64_t, Saved> m_saved;
+    std::vector<Queued>       m_queue;
+    ReconnectStats            m_stats = {};
+    uint64_t                  m_storm_first_ns = 0;
+    uint64_t                  m_storm_last_ns = 0;
+};
+
+#endif /* RECONNECT_H */
@@ -0,0 +1,130 @@
+/*
+ * xbledctl-replay: runs a capture made with --capture through the same
+ * session code the app uses and reports what it saw.
+ *
+ *   xbledctl-replay [--realtime] trace.gtr
+ */
+#include "gip_decode.h"
+#include "gip_protocol.h"
+#include "gip_trace.h"
+#include "xbox_led.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define IDLE_TIMEOUT_MS 2000
+
+static XboxController g_ctrl;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: xbledctl-replay [--realtime] trace.gtr\n");
+}
+
+static void wait_until(uint64_t t)
+{
+    for (;;) {
+        uint64_t now = xbox_time_ns();
+        if (now >= t)
+            return;
+        xbox_pump(&g_ctrl, (uint32_t)((t - now + 999999) / 1000000));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool realtime = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0)
+            realtime = true;
+        else if (argv[i][0] == '-' || path) {
+            usage();
+            return 2;
+        } else
+            path = argv[i];
+    }
+    if (!path) {
+        usage();
+        return 2;
+    }
+
+    char err[256];
+    GipTransport t = gip_replay_create(path, realtime, err, sizeof(err));
+    if (!t.ops) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    GipTraceReader trace;
+    if (!gip_trace_open(&trace, path, err, sizeof(err))) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+
+    xbox_init_with_transport(&g_ctrl, t);
+    uint64_t start = xbox_time_ns();
+    bool found = xbox_open(&g_ctrl);
+    uint64_t discovered = xbox_time_ns();
+    if (!found)
+        printf("discovery: %s\n", g_ctrl.error);
+    else
+        printf("discovery: %.3f ms, device %016llx\n", (discovered - start) / 1e6,
+               (unsigned long long)g_ctrl.device_id);
+
+    /* Recorded LED writes are issued again through xbox_set_led, at their
+       recorded offsets in realtime mode. */
+    GipTraceRecord rec;
+    uint64_t t_open = 0;
+    int applies = 0, failed = 0;
+    while (gip_trace_next(&trace, &rec)) {
+        if (rec.kind == GIP_TRACE_OPEN && !t_open)
+            t_open = rec.t_ns;
+        if (rec.kind != GIP_TRACE_WRITE)
+            continue;
+
+        GipDecoder dec;
+        GipMsg msg;
+        gip_decoder_init(&dec, rec.data, rec.len);
+        if (!gip_decode_next(&dec, &msg) || msg.command != GIP_CMD_LED || msg.length < 3)
+            continue;
+        if (realtime)
+            wait_until(start + (rec.t_ns - t_open));
+        if (!xbox_is_open(&g_ctrl))
+            xbox_open(&g_ctrl);
+        applies++;
+        if (!xbox_set_led(&g_ctrl, msg.payload[1], msg.payload[2]))
+            failed++;
+    }
+
+    uint64_t idle_since = xbox_time_ns();
+    uint64_t seen = g_ctrl.read_stats.messages;
+    while (g_ctrl.open && !gip_replay_done(t)) {
+        xbox_pump(&g_ctrl, 100);
+        if (g_ctrl.read_stats.messages != seen) {
+            seen = g_ctrl.read_stats.messages;
+            idle_since = xbox_time_ns();
+        } else if (xbox_time_ns() - idle_since > IDLE_TIMEOUT_MS * 1000000ull) {
+            break;
+        }
+    }
+    uint64_t took = xbox_time_ns() - start;
+
+    GipReplayStats rs;
+    gip_replay_stats(t, &rs);
+    const XboxReadStats *st = &g_ctrl.read_stats;
+    printf("reads:     %llu (%llu messages, %llu overruns)\n",
+           (unsigned long long)rs.reads, (unsigned long long)st->messages,
+           (unsigned long long)st->overruns);
+    printf("devices:   %d present at end\n", xbox_device_count(&g_ctrl));
+    printf("applies:   %d (%d failed), %llu writes, %llu differ from the trace\n",
+           applies, failed, (unsigned long long)rs.writes,
+           (unsigned long long)rs.write_mismatches);
+    if (g_ctrl.write_latency_avg_ns)
+        printf("write:     %.1f us average\n", g_ctrl.write_latency_avg_ns / 1e3);
+    printf("elapsed:   %.3f ms, %.0f messages/s\n", took / 1e6,
+           took ? st->messages * 1e9 / (double)took : 0.0);
+
+    gip_trace_close(&trace);
+    xbox_cleanup(&g_ctrl);
+    return failed ? 1 : 0;
+}
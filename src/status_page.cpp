@@ -0,0 +1,288 @@
+#include "status_page.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Spins this many times on an odd sequence before yielding. */
+static const int SPINS_BEFORE_YIELD = 64;
+
+static uint64_t MonotonicNs()
+{
+    /* steady_clock is CLOCK_MONOTONIC / QPC, so readers can compare it
+       with their own clock. */
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t CurrentPid()
+{
+#ifdef _WIN32
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+/* Claims the page for this process. A taken-over page may still be mapped
+   by readers, so the header is rewritten under the seqlock too. Every
+   update starts from an even value, in case the previous writer died
+   between its two stores. */
+static void InitPage(StatusPage *page)
+{
+    uint32_t s = page->seq.load(std::memory_order_relaxed);
+    s += s & 1;
+    page->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    page->magic = STATUS_PAGE_MAGIC;
+    page->version = STATUS_PAGE_VERSION;
+    page->size = (uint32_t)sizeof(StatusPage);
+    page->writer_pid = CurrentPid();
+    page->update_ns = MonotonicNs();
+    page->generation = 0;
+    page->count = 0;
+    memset(page->devices, 0, sizeof(page->devices));
+    page->seq.store(s + 2, std::memory_order_release);
+}
+
+StatusPublisher::~StatusPublisher()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool StatusPublisher::Create(const char *name, std::string *err)
+{
+    /* The mapping lives as long as any handle, so an existing one always
+       belongs to a running writer (or a reader of one). */
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                   (DWORD)sizeof(StatusPage), name);
+    DWORD e = GetLastError();
+    if (m_mapping && e == ERROR_ALREADY_EXISTS) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        if (err)
+            *err = std::string("another process publishes ") + name;
+        return false;
+    }
+    if (m_mapping)
+        m_page = (StatusPage *)MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StatusPage));
+    if (!m_page) {
+        if (err) {
+            char buf[160];
+            snprintf(buf, sizeof(buf), "cannot map %s (error %lu)", name, GetLastError());
+            *err = buf;
+        }
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+    m_name = name;
+    InitPage(m_page);
+    return true;
+}
+
+#else
+
+static bool WriterAlive(const StatusPage *page)
+{
+    if (page->magic != STATUS_PAGE_MAGIC || !page->writer_pid || page->writer_pid == CurrentPid())
+        return false;
+    return kill((pid_t)page->writer_pid, 0) == 0 || errno == EPERM;
+}
+
+bool StatusPublisher::Create(const char *name, std::string *err)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        if (err)
+            *err = std::string("cannot open ") + name + ": " + strerror(errno);
+        return false;
+    }
+    /* A segment left by a writer that died is taken over; one whose
+       writer is still running is not. */
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < sizeof(StatusPage) &&
+                                ftruncate(fd, sizeof(StatusPage)) != 0)) {
+        if (err)
+            *err = std::string("cannot size ") + name + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(StatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        if (err)
+            *err = std::string("cannot map ") + name + ": " + strerror(errno);
+        return false;
+    }
+    if (WriterAlive((StatusPage *)p)) {
+        munmap(p, sizeof(StatusPage));
+        if (err)
+            *err = std::string("another process publishes ") + name;
+        return false;
+    }
+    m_page = (StatusPage *)p;
+    m_name = name;
+    InitPage(m_page);
+    return true;
+}
+
+#endif
+
+void StatusPublisher::Publish(const StatusDevice *devices, uint32_t count)
+{
+    if (!m_page)
+        return;
+    if (count > STATUS_MAX_DEVICES)
+        count = STATUS_MAX_DEVICES;
+    if (count == m_page->count && memcmp(m_page->devices, devices, count * sizeof(StatusDevice)) == 0)
+        return;
+
+    uint32_t s = m_page->seq.load(std::memory_order_relaxed);
+    s += s & 1;
+    m_page->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_page->devices, devices, count * sizeof(StatusDevice));
+    m_page->count = count;
+    m_page->generation++;
+    m_page->update_ns = MonotonicNs();
+    m_page->seq.store(s + 2, std::memory_order_release);
+}
+
+void StatusPublisher::Close()
+{
+    if (!m_page)
+        return;
+    uint32_t s = m_page->seq.load(std::memory_order_relaxed);
+    s += s & 1;
+    m_page->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_page->writer_pid = 0;
+    m_page->count = 0;
+    m_page->generation++;
+    m_page->update_ns = MonotonicNs();
+    m_page->seq.store(s + 2, std::memory_order_release);
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_page);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(m_page, sizeof(StatusPage));
+    shm_unlink(m_name.c_str());
+#endif
+    m_page = nullptr;
+}
+
+StatusReader::~StatusReader()
+{
+    Close();
+}
+
+bool StatusReader::Open(const char *name, std::string *err)
+{
+    Close();
+#ifdef _WIN32
+    m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (m_mapping)
+        m_page = (const StatusPage *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(StatusPage));
+    if (!m_page) {
+        if (err)
+            *err = std::string("no status page at ") + name;
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+#else
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(StatusPage)) {
+        if (err)
+            *err = std::string("no status page at ") + name;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(StatusPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        if (err)
+            *err = std::string("cannot map ") + name + ": " + strerror(errno);
+        return false;
+    }
+    m_page = (const StatusPage *)p;
+#endif
+
+    if (m_page->magic != STATUS_PAGE_MAGIC || m_page->version != STATUS_PAGE_VERSION ||
+        m_page->size != sizeof(StatusPage)) {
+        if (err)
+            *err = std::string("unsupported status page at ") + name;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool StatusReader::Snapshot(StatusSnapshot *out, int max_retries) const
+{
+    if (!m_page)
+        return false;
+    for (int i = 0; i < max_retries; i++) {
+        uint32_t s1 = m_page->seq.load(std::memory_order_acquire);
+        if (s1 & 1) {
+            if (i % SPINS_BEFORE_YIELD == SPINS_BEFORE_YIELD - 1)
+                std::this_thread::yield();
+            continue;
+        }
+        out->writer_pid = m_page->writer_pid;
+        out->update_ns = m_page->update_ns;
+        out->generation = m_page->generation;
+        out->count = m_page->count;
+        if (out->count > STATUS_MAX_DEVICES)
+            continue;
+        memcpy(out->devices, m_page->devices, out->count * sizeof(StatusDevice));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_page->seq.load(std::memory_order_relaxed) == s1)
+            return true;
+    }
+    return false;
+}
+
+void StatusReader::Close()
+{
+    if (!m_page)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)m_page);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap((void *)m_page, sizeof(StatusPage));
+#endif
+    m_page = nullptr;
+}
+
+std::string StatusPageDefaultName()
+{
+#ifdef _WIN32
+    return "Local\\xbledctl-status";
+#else
+    char buf[64];
+    snprintf(buf, sizeof(buf), "/xbledctl-status-%u", (unsigned)getuid());
+    return buf;
+#endif
+}
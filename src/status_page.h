@@ -0,0 +1,106 @@
+#ifndef STATUS_PAGE_H
+#define STATUS_PAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+/*
+ * Device table and LED state published in a named shared-memory segment
+ * so that monitoring tools can poll it without a syscall per read. One
+ * process writes; readers map it read-only and take snapshots under a
+ * seqlock: seq is odd while an update is in progress, and a copy is only
+ * kept if seq was even and unchanged around it.
+ */
+#define STATUS_PAGE_MAGIC   0x5441545344454C42ull   /* "BLEDSTAT" */
+#define STATUS_PAGE_VERSION 1
+#define STATUS_MAX_DEVICES  16
+
+struct StatusDevice {
+    uint64_t device_id;
+    uint8_t  present;
+    uint8_t  mode;
+    uint8_t  brightness;
+    uint8_t  reserved[5];
+};
+
+struct StatusPage {
+    uint64_t              magic;
+    uint32_t              version;
+    uint32_t              size;
+    std::atomic<uint32_t> seq;
+    uint32_t              writer_pid;   /* 0 once the writer has exited */
+    uint64_t              update_ns;    /* writer's monotonic clock */
+    uint32_t              generation;   /* bumped on every published change */
+    uint32_t              count;
+    StatusDevice          devices[STATUS_MAX_DEVICES];
+};
+
+static_assert(sizeof(StatusDevice) == 16, "StatusDevice is shared with other processes");
+static_assert(sizeof(std::atomic<uint32_t>) == 4 && std::atomic<uint32_t>::is_always_lock_free,
+              "seq must be a plain lock-free word in shared memory");
+
+struct StatusSnapshot {
+    uint32_t     writer_pid;
+    uint64_t     update_ns;
+    uint32_t     generation;
+    uint32_t     count;
+    StatusDevice devices[STATUS_MAX_DEVICES];
+};
+
+class StatusPublisher {
+public:
+    StatusPublisher() = default;
+    ~StatusPublisher();
+
+    StatusPublisher(const StatusPublisher &) = delete;
+    StatusPublisher &operator=(const StatusPublisher &) = delete;
+
+    /* Fails if another live process already publishes under name. */
+    bool Create(const char *name, std::string *err);
+    /* Skips the update when nothing changed since the last one. */
+    void Publish(const StatusDevice *devices, uint32_t count);
+    void Close();
+    bool IsOpen() const { return m_page != nullptr; }
+
+private:
+    StatusPage  *m_page = nullptr;
+    std::string  m_name;
+#ifdef _WIN32
+    HANDLE       m_mapping = nullptr;
+#endif
+};
+
+class StatusReader {
+public:
+    static constexpr int DEFAULT_RETRIES = 1000;
+
+    StatusReader() = default;
+    ~StatusReader();
+
+    StatusReader(const StatusReader &) = delete;
+    StatusReader &operator=(const StatusReader &) = delete;
+
+    bool Open(const char *name, std::string *err);
+    /* False when no consistent copy was seen within max_retries attempts. */
+    bool Snapshot(StatusSnapshot *out, int max_retries = DEFAULT_RETRIES) const;
+    void Close();
+
+private:
+    const StatusPage *m_page = nullptr;
+#ifdef _WIN32
+    HANDLE            m_mapping = nullptr;
+#endif
+};
+
+/* Local\xbledctl-status on Windows, /xbledctl-status-<uid> elsewhere. */
+std::string StatusPageDefaultName();
+
+#endif /* STATUS_PAGE_H */
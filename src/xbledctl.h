@@ -0,0 +1,120 @@
+#ifndef XBLEDCTL_H
+#define XBLEDCTL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * libxbledctl: LED control for programs that embed it instead of running
+ * xbledctl-cli or talking to xbledctld.
+ *
+ * A session owns one controller transport and a worker thread that keeps
+ * the session open, tracks arrivals and removals, and performs the writes.
+ * Every function may be called from any thread. Requests submitted while a
+ * write is in flight are batched, and when several address the same
+ * controller only the last value is written.
+ *
+ * Controllers are addressed by their 64-bit GIP device ID, as returned by
+ * xbled_list. An empty device list (count 0) means every controller that
+ * is present when the request runs.
+ */
+
+#ifdef _WIN32
+#if defined(XBLEDCTL_BUILD) && !defined(XBLEDCTL_STATIC)
+#define XBLEDCTL_API __declspec(dllexport)
+#elif !defined(XBLEDCTL_STATIC)
+#define XBLEDCTL_API __declspec(dllimport)
+#else
+#define XBLEDCTL_API
+#endif
+#else
+#define XBLEDCTL_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XBLED_API_VERSION 1
+
+#define XBLED_OK            0
+#define XBLED_ERR_ARGS      1
+#define XBLED_ERR_NO_DEVICE 2   /* no addressed controller was present */
+#define XBLED_ERR_WRITE     3   /* at least one write failed */
+#define XBLED_ERR_CLOSED    4   /* the session was closed first */
+#define XBLED_ERR_BUSY      5   /* too many requests queued; try again */
+
+#define XBLED_MODE_OFF          0x00
+#define XBLED_MODE_ON           0x01
+#define XBLED_MODE_BLINK_FAST   0x02
+#define XBLED_MODE_BLINK_SLOW   0x03
+#define XBLED_MODE_BLINK_CHARGE 0x04
+#define XBLED_MODE_FADE_SLOW    0x08
+#define XBLED_MODE_FADE_FAST    0x09
+
+#define XBLED_BRIGHTNESS_MAX 47
+
+#define XBLED_BACKEND_DEFAULT  0   /* \\.\XboxGIP on Windows, xone sysfs on Linux */
+#define XBLED_BACKEND_LOOPBACK 1   /* in-process simulation */
+#define XBLED_BACKEND_RAW      2   /* Linux: raw GIP device nodes over io_uring */
+
+typedef struct XbledSession XbledSession;
+
+/* Zero-initialise and set size to sizeof(XbledOptions); fields added in
+   later versions are treated as zero when size says they are missing. */
+typedef struct {
+    uint32_t            size;
+    int                 backend;
+    int                 simulate_devices;   /* LOOPBACK: controllers to create */
+    const char         *sysfs_root;         /* DEFAULT on Linux; NULL for /sys/class/leds */
+    const char *const  *raw_paths;          /* RAW */
+    int                 raw_count;
+} XbledOptions;
+
+typedef struct {
+    uint64_t device_id;
+    uint8_t  present;
+    uint8_t  mode;
+    uint8_t  brightness;
+    uint8_t  reserved[5];
+} XbledDevice;
+
+/* Runs on the session's worker thread. It must not block and must not call
+   xbled_set_led or xbled_close on the same session. */
+typedef void (*XbledDoneFn)(void *user, int status, int applied, int failed);
+
+XBLEDCTL_API int xbled_version(void);
+
+/* opts may be NULL for the default backend. Returns NULL and fills error
+   (if given) when the backend cannot be set up. */
+XBLEDCTL_API XbledSession *xbled_open(const XbledOptions *opts, char *error, size_t error_len);
+
+/* Stops the worker. Requests that have not run complete with
+   XBLED_ERR_CLOSED before this returns. */
+XBLEDCTL_API void xbled_close(XbledSession *s);
+
+/* Copies up to max present controllers and returns how many there are,
+   or -1 for a bad argument. */
+XBLEDCTL_API int xbled_list(XbledSession *s, XbledDevice *out, int max);
+
+/* Blocks until at least count controllers are present, timeout_ms has
+   passed or the session is closed; returns the number present. */
+XBLEDCTL_API int xbled_wait_devices(XbledSession *s, int count, uint32_t timeout_ms);
+
+/* Queues a write and returns at once; done (may be NULL) reports the
+   result. Returns XBLED_OK if the request was queued, XBLED_ERR_BUSY
+   (without calling done) if the queue is full. */
+XBLEDCTL_API int xbled_submit(XbledSession *s, const uint64_t *devices, int count,
+                              uint8_t mode, uint8_t brightness, XbledDoneFn done, void *user);
+
+/* Synchronous xbled_submit. applied and failed may be NULL. */
+XBLEDCTL_API int xbled_set_led(XbledSession *s, const uint64_t *devices, int count,
+                               uint8_t mode, uint8_t brightness, int *applied, int *failed);
+
+XBLEDCTL_API const char *xbled_strerror(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XBLEDCTL_H */
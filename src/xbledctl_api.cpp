@@ -0,0 +1,292 @@
+/*
+ * C API over LedService; see xbledctl.h.
+ */
+#include "xbledctl.h"
+
+#include "gip_loopback.h"
+#include "led_service.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(XBLED_MODE_OFF == LED_MODE_OFF && XBLED_MODE_FADE_FAST == LED_MODE_FADE_FAST,
+              "public LED modes must match the wire values");
+static_assert(XBLED_BRIGHTNESS_MAX == LED_BRIGHTNESS_MAX, "brightness range mismatch");
+
+static const uint64_t SIMULATED_DEVICE_BASE = 0x7E5700000001ull;
+
+/*
+ * close_mu is held shared by every call that touches the service and
+ * exclusively by xbled_close, so a close waits for calls in progress and
+ * later submits see closed instead of queueing on a stopped worker.
+ */
+struct XbledSession {
+    std::unique_ptr<LedService> service;
+    std::vector<int>            raw_fds;
+
+    std::shared_mutex           close_mu;
+    std::atomic<bool>           closed{false};
+
+    std::mutex                  dev_mu;
+    std::condition_variable     dev_cv;
+    int                         dev_sub = -1;
+};
+
+static void SetError(char *error, size_t len, const char *msg)
+{
+    if (error && len)
+        snprintf(error, len, "%s", msg);
+}
+
+static int ResultStatus(int applied, int failed)
+{
+    if (applied < 0)
+        return XBLED_ERR_CLOSED;
+    if (!applied && !failed)
+        return XBLED_ERR_NO_DEVICE;
+    return failed ? XBLED_ERR_WRITE : XBLED_OK;
+}
+
+static bool CreateTransport(const XbledOptions &o, XbledSession *s, GipTransport *out,
+                            char *error, size_t error_len)
+{
+    switch (o.backend) {
+    case XBLED_BACKEND_LOOPBACK:
+        if (o.simulate_devices < 0 || o.simulate_devices > XBOX_MAX_DEVICES) {
+            SetError(error, error_len, "simulate_devices out of range");
+            return false;
+        }
+        *out = gip_loopback_create(nullptr);
+        for (int i = 0; i < o.simulate_devices; i++)
+            gip_loopback_add_device(*out, SIMULATED_DEVICE_BASE + (uint64_t)i);
+        return true;
+
+    case XBLED_BACKEND_DEFAULT:
+#if defined(_WIN32)
+        *out = gip_transport_win32_create();
+        return true;
+#elif defined(__linux__)
+        *out = gip_transport_xone_create(o.sysfs_root);
+        return true;
+#else
+        SetError(error, error_len, "no controller backend on this platform");
+        return false;
+#endif
+
+    case XBLED_BACKEND_RAW:
+#ifdef __linux__
+        if (o.raw_count < 1 || o.raw_count > XBOX_MAX_DEVICES || !o.raw_paths) {
+            SetError(error, error_len, "raw backend needs 1-16 device paths");
+            return false;
+        }
+        for (int i = 0; i < o.raw_count; i++) {
+            int fd = open(o.raw_paths[i], O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "cannot open %s", o.raw_paths[i]);
+                SetError(error, error_len, msg);
+                return false;
+            }
+            s->raw_fds.push_back(fd);
+        }
+        *out = gip_transport_uring_create(s->raw_fds.data(), (int)s->raw_fds.size());
+        return true;
+#else
+        SetError(error, error_len, "raw backend is only available on Linux");
+        return false;
+#endif
+
+    default:
+        SetError(error, error_len, "unknown backend");
+        return false;
+    }
+}
+
+static void FreeSession(XbledSession *s)
+{
+    s->service.reset();
+#ifdef __linux__
+    for (int fd : s->raw_fds)
+        close(fd);
+#endif
+    delete s;
+}
+
+extern "C" int xbled_version(void)
+{
+    return XBLED_API_VERSION;
+}
+
+extern "C" XbledSession *xbled_open(const XbledOptions *opts, char *error, size_t error_len)
+{
+    XbledOptions o = {};
+    if (opts) {
+        if (opts->size < sizeof(uint32_t)) {
+            SetError(error, error_len, "options size not set");
+            return nullptr;
+        }
+        memcpy(&o, opts, opts->size < sizeof(o) ? opts->size : sizeof(o));
+    }
+
+    XbledSession *s = new XbledSession;
+    GipTransport transport;
+    if (!CreateTransport(o, s, &transport, error, error_len)) {
+        FreeSession(s);
+        return nullptr;
+    }
+    s->service.reset(new LedService(transport));
+    s->dev_sub = s->service->Bus().Subscribe(BUS_MASK(BUS_DEVICE_ARRIVED), [s] {
+        /* Taking the lock orders this against the waiter's predicate check. */
+        { std::lock_guard<std::mutex> lock(s->dev_mu); }
+        s->dev_cv.notify_all();
+    });
+    s->service->Start();
+    return s;
+}
+
+extern "C" void xbled_close(XbledSession *s)
+{
+    if (!s)
+        return;
+    s->closed = true;
+    { std::lock_guard<std::mutex> lock(s->dev_mu); }
+    s->dev_cv.notify_all();
+    /* Waits for calls still inside the service. */
+    { std::unique_lock<std::shared_mutex> lock(s->close_mu); }
+    s->service->Stop();
+    FreeSession(s);
+}
+
+static int CountPresent(const std::vector<LedDeviceState> &states)
+{
+    int n = 0;
+    for (const LedDeviceState &st : states)
+        n += st.present;
+    return n;
+}
+
+extern "C" int xbled_list(XbledSession *s, XbledDevice *out, int max)
+{
+    if (!s || (max > 0 && !out))
+        return -1;
+    std::shared_lock<std::shared_mutex> lock(s->close_mu);
+    int n = 0;
+    for (const LedDeviceState &st : s->service->Snapshot()) {
+        if (!st.present)
+            continue;
+        if (n < max) {
+            XbledDevice d = {};
+            d.device_id = st.device_id;
+            d.present = 1;
+            d.mode = st.mode;
+            d.brightness = st.brightness;
+            out[n] = d;
+        }
+        n++;
+    }
+    return n;
+}
+
+extern "C" int xbled_wait_devices(XbledSession *s, int count, uint32_t timeout_ms)
+{
+    if (!s)
+        return -1;
+    std::shared_lock<std::shared_mutex> close_lock(s->close_mu);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int present = 0;
+    std::unique_lock<std::mutex> lock(s->dev_mu);
+    s->dev_cv.wait_until(lock, deadline, [&] {
+        /* Arrival events only wake us; the device table is the truth. */
+        BusEvent ev;
+        while (s->service->Bus().Poll(s->dev_sub, &ev)) {}
+        present = CountPresent(s->service->Snapshot());
+        return present >= count || s->closed;
+    });
+    return present;
+}
+
+extern "C" int xbled_submit(XbledSession *s, const uint64_t *devices, int count,
+                            uint8_t mode, uint8_t brightness, XbledDoneFn done, void *user)
+{
+    if (!s || count < 0 || count > XBOX_MAX_DEVICES || (count && !devices) ||
+        brightness > LED_BRIGHTNESS_MAX)
+        return XBLED_ERR_ARGS;
+
+    LedRequest req;
+    req.mode = mode;
+    req.brightness = brightness;
+    req.devices.assign(devices, devices + count);
+    if (done) {
+        req.done = [done, user](int applied, int failed) {
+            done(user, ResultStatus(applied, failed), applied < 0 ? 0 : applied,
+                 failed < 0 ? 0 : failed);
+        };
+    }
+
+    std::shared_lock<std::shared_mutex> lock(s->close_mu);
+    if (s->closed)
+        return XBLED_ERR_CLOSED;
+    return s->service->Submit(std::move(req)) ? XBLED_OK : XBLED_ERR_BUSY;
+}
+
+namespace {
+struct SyncResult {
+    std::mutex              mu;
+    std::condition_variable cv;
+    bool                    done = false;
+    int                     status = XBLED_OK;
+    int                     applied = 0;
+    int                     failed = 0;
+};
+}
+
+extern "C" int xbled_set_led(XbledSession *s, const uint64_t *devices, int count,
+                             uint8_t mode, uint8_t brightness, int *applied, int *failed)
+{
+    SyncResult r;
+    int rc = xbled_submit(s, devices, count, mode, brightness,
+        [](void *user, int status, int ok, int bad) {
+            SyncResult *res = (SyncResult *)user;
+            std::lock_guard<std::mutex> lock(res->mu);
+            res->status = status;
+            res->applied = ok;
+            res->failed = bad;
+            res->done = true;
+            res->cv.notify_one();
+        }, &r);
+    if (rc != XBLED_OK)
+        return rc;
+
+    std::unique_lock<std::mutex> lock(r.mu);
+    r.cv.wait(lock, [&] { return r.done; });
+    if (applied)
+        *applied = r.applied;
+    if (failed)
+        *failed = r.failed;
+    return r.status;
+}
+
+extern "C" const char *xbled_strerror(int status)
+{
+    switch (status) {
+    case XBLED_OK:            return "ok";
+    case XBLED_ERR_ARGS:      return "invalid argument";
+    case XBLED_ERR_NO_DEVICE: return "no controller found";
+    case XBLED_ERR_WRITE:     return "LED write failed";
+    case XBLED_ERR_CLOSED:    return "session closed";
+    case XBLED_ERR_BUSY:      return "too many requests queued";
+    default:                  return "unknown error";
+    }
+}
@@ -1,111 +1,547 @@
 #include "xbox_led.h"
+#include "gip_decode.h"
+#include "gip_frames.h"
+#include "gip_protocol.h"
 
 #include <stdio.h>
 #include <string.h>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#else
+#include <time.h>
+#endif
 
-#define GIP_REENUMERATE 0x40001CD0
+#define DISCOVER_TIMEOUT_MS 1500
+#define WRITE_TIMEOUT_MS    2000
+#define ACK_TIMEOUT_DEFAULT_MS 50
+#define RECOVER_INTERVAL_MS 250
 
-#pragma pack(push, 1)
-typedef struct {
-    uint64_t deviceId;
-    uint8_t  commandId;
-    uint8_t  clientFlags;
-    uint8_t  sequence;
-    uint8_t  unknown1;
-    uint32_t length;
-    uint32_t unknown2;
-} GipHeader;
-#pragma pack(pop)
+uint64_t xbox_time_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000ull
+         + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000ull / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint32_t remaining_ms(uint64_t deadline)
+{
+    uint64_t now = xbox_time_ns();
+    if (now >= deadline)
+        return 0;
+    return (uint32_t)((deadline - now + 999999) / 1000000);
+}
+
+static bool interrupted(const XboxController *ctrl)
+{
+    return ctrl->interrupt && ctrl->interrupt(ctrl->interrupt_ctx);
+}
 
 void xbox_init(XboxController *ctrl)
+{
+#ifdef _WIN32
+    xbox_init_with_transport(ctrl, gip_transport_win32_create());
+#elif defined(__linux__)
+    xbox_init_with_transport(ctrl, gip_transport_xone_create(NULL));
+#else
+    GipTransport none = { NULL, NULL };
+    xbox_init_with_transport(ctrl, none);
+#endif
+}
+
+void xbox_init_with_transport(XboxController *ctrl, GipTransport transport)
 {
     memset(ctrl, 0, sizeof(*ctrl));
-    ctrl->seq = 1;
-}
-
-static bool discover_device(XboxController *ctrl)
-{
-    HANDLE h = (HANDLE)ctrl->handle;
-    DWORD bytes = 0;
-    DeviceIoControl(h, GIP_REENUMERATE, NULL, 0, NULL, 0, &bytes, NULL);
-
-    uint8_t buf[4096];
-    OVERLAPPED ov;
-    memset(&ov, 0, sizeof(ov));
-    ov.hEvent = (HANDLE)ctrl->read_event;
-
-    for (int i = 0; i < 5; i++) {
-        memset(buf, 0, sizeof(buf));
-        ResetEvent(ov.hEvent);
-        DWORD rd = 0;
-        BOOL ok = ReadFile(h, buf, sizeof(buf), &rd, &ov);
-        if (!ok && GetLastError() == ERROR_IO_PENDING) {
-            DWORD wait = WaitForSingleObject(ov.hEvent, 300);
-            if (wait == WAIT_TIMEOUT) {
-                CancelIo(h);
-                WaitForSingleObject(ov.hEvent, 100);
-                continue;
-            }
-            GetOverlappedResult(h, &ov, &rd, FALSE);
+    ctrl->read_depth = XBOX_READ_DEPTH_DEFAULT;
+    ctrl->batch_window = XBOX_BATCH_WINDOW_MAX;
+    ctrl->transport = transport;
+}
+
+void xbox_set_read_depth(XboxController *ctrl, int depth)
+{
+    if (depth < 1)
+        depth = 1;
+    if (depth > XBOX_READ_DEPTH_MAX)
+        depth = XBOX_READ_DEPTH_MAX;
+    ctrl->read_depth = depth;
+}
+
+void xbox_set_batch_window(XboxController *ctrl, int frames)
+{
+    if (frames < 1)
+        frames = 1;
+    if (frames > XBOX_BATCH_WINDOW_MAX)
+        frames = XBOX_BATCH_WINDOW_MAX;
+    ctrl->batch_window = frames;
+}
+
+void xbox_set_interrupt(XboxController *ctrl, XboxInterruptFn fn, void *ctx)
+{
+    ctrl->interrupt = fn;
+    ctrl->interrupt_ctx = ctx;
+}
+
+void xbox_set_ack_policy(XboxController *ctrl, const XboxAckPolicy *policy)
+{
+    ctrl->ack = *policy;
+    if (ctrl->ack.request_ack && !ctrl->ack.ack_timeout_ms)
+        ctrl->ack.ack_timeout_ms = ACK_TIMEOUT_DEFAULT_MS;
+}
+
+static void reset_reads(XboxController *ctrl)
+{
+    for (int i = 0; i < XBOX_READ_DEPTH_MAX; i++)
+        ctrl->reads[i].state = XBOX_READ_IDLE;
+    ctrl->read_head = 0;
+    ctrl->read_tail = 0;
+}
+
+/* Tops the ring back up to read_depth outstanding reads. */
+static void post_reads(XboxController *ctrl)
+{
+    if (!ctrl->open)
+        return;
+    while (ctrl->read_tail - ctrl->read_head < (uint32_t)ctrl->read_depth) {
+        XboxRead *r = &ctrl->reads[ctrl->read_tail % XBOX_READ_DEPTH_MAX];
+        if (!ctrl->transport.ops->read(ctrl->transport.self, r->buf, sizeof(r->buf), r))
+            break;
+        r->state = XBOX_READ_POSTED;
+        ctrl->read_tail++;
+    }
+}
+
+static XboxDevice *find_device(XboxController *ctrl, uint64_t id)
+{
+    for (int i = 0; i < ctrl->device_count; i++) {
+        if (ctrl->devices[i].device_id == id)
+            return &ctrl->devices[i];
+    }
+    return NULL;
+}
+
+static void select_primary(XboxController *ctrl)
+{
+    for (int i = 0; i < ctrl->device_count; i++) {
+        if (ctrl->devices[i].state == XBOX_DEV_PRESENT) {
+            ctrl->device_id = ctrl->devices[i].device_id;
+            ctrl->connected = true;
+            return;
         }
-        if (rd < sizeof(GipHeader))
+    }
+    ctrl->device_id = 0;
+    ctrl->connected = false;
+}
+
+static int rescan_pending(const XboxController *ctrl)
+{
+    int pending = 0;
+    for (int i = 0; i < ctrl->device_count; i++) {
+        const XboxDevice *dev = &ctrl->devices[i];
+        if (dev->state == XBOX_DEV_PRESENT && dev->scan_gen != ctrl->scan_gen)
+            pending++;
+    }
+    return pending;
+}
+
+static unsigned mark_present(XboxController *ctrl, uint64_t id, uint64_t now)
+{
+    XboxDevice *dev = find_device(ctrl, id);
+    if (!dev) {
+        for (int i = 0; i < ctrl->device_count && !dev; i++) {
+            if (ctrl->devices[i].state == XBOX_DEV_ABSENT)
+                dev = &ctrl->devices[i];
+        }
+        if (!dev && ctrl->device_count < XBOX_MAX_DEVICES)
+            dev = &ctrl->devices[ctrl->device_count++];
+        if (!dev)
+            return 0;
+        memset(dev, 0, sizeof(*dev));
+        dev->device_id = id;
+        dev->first_seen_ns = now;
+        dev->seq = 1;
+    }
+
+    unsigned ev = 0;
+    if (dev->state != XBOX_DEV_PRESENT) {
+        dev->state = XBOX_DEV_PRESENT;
+        dev->arrived_ns = now;
+        dev->led_known = false;
+        ev = XBOX_EVENT_ARRIVED;
+    }
+    dev->last_seen_ns = now;
+    dev->scan_gen = ctrl->scan_gen;
+    return ev;
+}
+
+static void match_ack(XboxController *ctrl, const GipMsg *msg, uint64_t now)
+{
+    XboxDevice *dev = find_device(ctrl, msg->device_id);
+    if (!dev || !dev->ack_wait || msg->sequence != dev->ack_seq)
+        return;
+    if (msg->length >= 2 && msg->payload[1] != dev->ack_cmd)
+        return;
+
+    dev->ack_wait = false;
+    dev->acks++;
+    dev->ack_rtt_ns = now - dev->ack_sent_ns;
+    dev->ack_rtt_avg_ns = dev->ack_rtt_avg_ns
+        ? (dev->ack_rtt_avg_ns * 7 + dev->ack_rtt_ns) / 8
+        : dev->ack_rtt_ns;
+}
+
+/* A read may carry several framed messages back to back. */
+static unsigned parse_messages(XboxController *ctrl, const uint8_t *buf, uint32_t n)
+{
+    unsigned ev = 0;
+    uint64_t now = xbox_time_ns();
+    GipDecoder dec;
+    GipMsg msg;
+    GipStatus status;
+
+    if (n == XBOX_READ_SIZE)
+        ctrl->read_stats.overruns++;
+
+    gip_decoder_init(&dec, buf, n);
+    while (gip_decode_next(&dec, &msg)) {
+        ctrl->read_stats.messages++;
+        if (msg.truncated)
+            ctrl->read_stats.overruns++;
+        /* An ack only settles a pending write; presence comes from
+           announces, so an ack from a stale or unknown id adds nothing. */
+        if (msg.command == GIP_CMD_ACKNOWLEDGE)
+            match_ack(ctrl, &msg, now);
+        if (msg.command == GIP_CMD_ANNOUNCE) {
+            /* A present controller announcing out of turn has reset, with
+               the LED back at default; one a scan generation behind is
+               answering a reenumerate. */
+            XboxDevice *dev = find_device(ctrl, msg.device_id);
+            bool reset = dev && dev->state == XBOX_DEV_PRESENT && dev->scan_gen == ctrl->scan_gen;
+            ev |= mark_present(ctrl, msg.device_id, now);
+            dev = find_device(ctrl, msg.device_id);
+            if (dev) {
+                if (reset)
+                    dev->arrived_ns = now;
+                dev->led_known = false;
+            }
             continue;
+        }
 
-        GipHeader *hdr = (GipHeader *)buf;
-        if (hdr->commandId == 0x01 || hdr->commandId == 0x02) {
-            ctrl->device_id = hdr->deviceId;
-            return true;
+        XboxDevice *dev = find_device(ctrl, msg.device_id);
+        if (!dev || dev->state != XBOX_DEV_PRESENT)
+            continue;
+        dev->last_seen_ns = now;
+        if (gip_msg_status(&msg, &status) && !status.connected) {
+            dev->state = XBOX_DEV_ABSENT;
+            ev |= XBOX_EVENT_LEFT;
         }
     }
-    return false;
+
+    if (ev)
+        select_primary(ctrl);
+    return ev;
 }
 
-bool xbox_open(XboxController *ctrl)
+static bool start_session(XboxController *ctrl)
 {
-    xbox_close(ctrl);
+    if (ctrl->open)
+        return true;
 
-    HANDLE h = CreateFileW(L"\\\\.\\XboxGIP",
-        GENERIC_READ | GENERIC_WRITE,
-        FILE_SHARE_READ | FILE_SHARE_WRITE,
-        NULL, OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
-        NULL);
+    if (!ctrl->transport.ops) {
+        snprintf(ctrl->error, sizeof(ctrl->error), "No transport available");
+        ctrl->last_err = XBOX_ERR_OPEN_FAILED;
+        return false;
+    }
 
-    if (h == INVALID_HANDLE_VALUE) {
+    uint32_t err = 0;
+    if (!ctrl->transport.ops->open(ctrl->transport.self, &err)) {
         snprintf(ctrl->error, sizeof(ctrl->error),
-                 "Cannot open XboxGIP driver (error %lu)", GetLastError());
+                 "Cannot open %s driver (error %lu)",
+                 ctrl->transport.ops->name, (unsigned long)err);
         ctrl->last_err = XBOX_ERR_OPEN_FAILED;
         return false;
     }
-    ctrl->handle = h;
-    ctrl->read_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    ctrl->open = true;
+    ctrl->transport_dropped = ctrl->transport.ops->dropped
+        ? ctrl->transport.ops->dropped(ctrl->transport.self) : 0;
+    ctrl->recover_pending = false;
+    reset_reads(ctrl);
+    post_reads(ctrl);
+    ctrl->transport.ops->ioctl(ctrl->transport.self, GIP_REENUMERATE);
+    return true;
+}
+
+/* Parses completed reads from the head of the ring, stopping at the first
+   one still in flight. */
+static unsigned consume_reads(XboxController *ctrl)
+{
+    unsigned ev = 0;
+    while (ctrl->open && ctrl->read_head != ctrl->read_tail) {
+        XboxRead *r = &ctrl->reads[ctrl->read_head % XBOX_READ_DEPTH_MAX];
+        if (r->state != XBOX_READ_DONE)
+            break;
+        r->state = XBOX_READ_IDLE;
+        ctrl->read_head++;
+
+        if (r->status == GIP_IO_OK) {
+            ctrl->read_stats.completed++;
+            ev |= parse_messages(ctrl, r->buf, r->bytes);
+        } else if (r->status != GIP_IO_CANCELLED) {
+            if (ctrl->connected)
+                ev |= XBOX_EVENT_LEFT;
+            xbox_close(ctrl);
+            ev |= XBOX_EVENT_CLOSED;
+        }
+    }
+    return ev;
+}
+
+/*
+ * Frames the driver dropped may have been announces. The ring goes to full
+ * depth and, once a pump completes no read so the backlog has drained,
+ * every controller is asked to announce again, at most once per
+ * RECOVER_INTERVAL_MS. The scan generation moves first, so the answers of
+ * controllers already present are not taken for resets.
+ */
+static void recover_dropped(XboxController *ctrl, bool drained)
+{
+    const GipTransportOps *ops = ctrl->transport.ops;
+    if (ops->dropped) {
+        uint64_t total = ops->dropped(ctrl->transport.self);
+        if (total != ctrl->transport_dropped) {
+            ctrl->read_stats.dropped += total - ctrl->transport_dropped;
+            ctrl->transport_dropped = total;
+            ctrl->read_depth = XBOX_READ_DEPTH_MAX;
+            ctrl->recover_pending = true;
+        }
+    }
+    if (!ctrl->recover_pending || !drained)
+        return;
+    uint64_t now = xbox_time_ns();
+    if (now < ctrl->recover_after_ns)
+        return;
+    ctrl->recover_pending = false;
+    ctrl->recover_after_ns = now + RECOVER_INTERVAL_MS * 1000000ull;
+    ctrl->read_stats.recoveries++;
+    ctrl->scan_gen++;
+    post_reads(ctrl);
+    ops->ioctl(ctrl->transport.self, GIP_REENUMERATE);
+}
+
+/* Cached IDs that have not announced by the deadline were not there. */
+static unsigned expire_provisional(XboxController *ctrl)
+{
+    if (!rescan_pending(ctrl)) {
+        ctrl->confirm_deadline_ns = 0;
+        return 0;
+    }
+    if (xbox_time_ns() < ctrl->confirm_deadline_ns)
+        return 0;
+    ctrl->confirm_deadline_ns = 0;
+    for (int i = 0; i < ctrl->device_count; i++) {
+        XboxDevice *dev = &ctrl->devices[i];
+        if (dev->state == XBOX_DEV_PRESENT && dev->scan_gen != ctrl->scan_gen)
+            dev->state = XBOX_DEV_ABSENT;
+    }
+    select_primary(ctrl);
+    return XBOX_EVENT_LEFT;
+}
+
+unsigned xbox_pump(XboxController *ctrl, uint32_t timeout_ms)
+{
+    if (!ctrl->transport.ops)
+        return 0;
+    if (ctrl->confirm_deadline_ns) {
+        uint32_t left = remaining_ms(ctrl->confirm_deadline_ns);
+        if (left < timeout_ms)
+            timeout_ms = left;
+    }
+    if (ctrl->recover_pending) {
+        uint32_t left = remaining_ms(ctrl->recover_after_ns);
+        if (left < timeout_ms)
+            timeout_ms = left;
+    }
+
+    GipCompletion done[GIP_MAX_INFLIGHT];
+    int n = ctrl->transport.ops->poll(ctrl->transport.self, done, GIP_MAX_INFLIGHT, timeout_ms);
+
+    unsigned ev = 0;
+    int reads = 0;
+    for (int i = 0; i < n && ctrl->open; i++) {
+        const GipCompletion *c = &done[i];
+        if (c->kind == GIP_IO_WRITE) {
+            if (c->user != ctrl->write_buf) {
+                XboxBatchWrite *w = (XboxBatchWrite *)c->user;
+                w->done = true;
+                w->done_ns = xbox_time_ns();
+                w->status = c->status;
+                w->bytes = c->bytes;
+                w->error = c->error;
+                continue;
+            }
+            ctrl->write_done = true;
+            ctrl->write_status = c->status;
+            ctrl->write_bytes = c->bytes;
+            ctrl->write_error = c->error;
+            continue;
+        }
+
+        XboxRead *done_read = (XboxRead *)c->user;
+        done_read->bytes = c->bytes;
+        done_read->status = c->status;
+        done_read->state = XBOX_READ_DONE;
+        ev |= consume_reads(ctrl);
+        reads++;
+    }
+
+    if (ctrl->open)
+        recover_dropped(ctrl, reads == 0);
+    if (ctrl->open && ctrl->read_tail == ctrl->read_head)
+        ctrl->read_stats.starved++;
+    post_reads(ctrl);
+    if (ctrl->open && ctrl->confirm_deadline_ns)
+        ev |= expire_provisional(ctrl);
+    return ev;
+}
+
+void xbox_wake(XboxController *ctrl)
+{
+    if (ctrl->transport.ops)
+        ctrl->transport.ops->wake(ctrl->transport.self);
+}
+
+bool xbox_open(XboxController *ctrl)
+{
+    if (xbox_is_open(ctrl))
+        return true;
+
+    bool fresh = !ctrl->open;
+    if (!start_session(ctrl))
+        return false;
+    if (!fresh)
+        ctrl->transport.ops->ioctl(ctrl->transport.self, GIP_REENUMERATE);
+
+    uint64_t deadline = xbox_time_ns() + DISCOVER_TIMEOUT_MS * 1000000ull;
+    while (!ctrl->connected && ctrl->open) {
+        uint32_t left = remaining_ms(deadline);
+        if (!left || interrupted(ctrl))
+            break;
+        xbox_pump(ctrl, left);
+    }
 
-    if (!discover_device(ctrl)) {
+    /* The handle stays open without a controller so that later announces
+       still reach the device table. */
+    if (!ctrl->connected) {
         snprintf(ctrl->error, sizeof(ctrl->error), "No Xbox controller found");
         ctrl->last_err = XBOX_ERR_NO_DEVICE;
-        xbox_close(ctrl);
         return false;
     }
 
-    ctrl->connected = true;
     ctrl->last_err = XBOX_OK;
     ctrl->error[0] = '\0';
     return true;
 }
 
-void xbox_close(XboxController *ctrl)
+/*
+ * Opens the session and takes the given controllers as present without
+ * waiting for them to announce, so the first write goes out at once. They
+ * are provisional, a scan generation behind, until they answer the
+ * reenumerate the session starts with; the pump drops those that have not
+ * within window_ms, as xbox_rescan() would, and reports XBOX_EVENT_LEFT.
+ */
+bool xbox_open_cached(XboxController *ctrl, const uint64_t *ids, int count, uint32_t window_ms)
 {
-    if (ctrl->read_event) {
-        CloseHandle((HANDLE)ctrl->read_event);
-        ctrl->read_event = NULL;
+    if (ctrl->open || count <= 0)
+        return xbox_open(ctrl);
+    if (!start_session(ctrl))
+        return false;
+
+    uint64_t now = xbox_time_ns();
+    for (int i = 0; i < count; i++) {
+        mark_present(ctrl, ids[i], now);
+        XboxDevice *dev = find_device(ctrl, ids[i]);
+        if (dev)
+            dev->scan_gen = ctrl->scan_gen - 1;
     }
-    if (ctrl->handle) {
-        CloseHandle((HANDLE)ctrl->handle);
-        ctrl->handle = NULL;
+    ctrl->confirm_deadline_ns = now + window_ms * 1000000ull;
+    select_primary(ctrl);
+    ctrl->last_err = XBOX_OK;
+    ctrl->error[0] = '\0';
+    return ctrl->connected;
+}
+
+bool xbox_is_open(const XboxController *ctrl)
+{
+    return ctrl->open && ctrl->connected;
+}
+
+bool xbox_rescan(XboxController *ctrl, uint32_t window_ms)
+{
+    if (!ctrl->open)
+        return xbox_open(ctrl);
+
+    ctrl->scan_gen++;
+    ctrl->transport.ops->ioctl(ctrl->transport.self, GIP_REENUMERATE);
+
+    uint64_t deadline = xbox_time_ns() + window_ms * 1000000ull;
+    while (ctrl->open && rescan_pending(ctrl) > 0) {
+        uint32_t left = remaining_ms(deadline);
+        if (!left || interrupted(ctrl))
+            break;
+        xbox_pump(ctrl, left);
+    }
+
+    for (int i = 0; i < ctrl->device_count; i++) {
+        XboxDevice *dev = &ctrl->devices[i];
+        if (dev->state == XBOX_DEV_PRESENT && dev->scan_gen != ctrl->scan_gen)
+            dev->state = XBOX_DEV_ABSENT;
     }
+    ctrl->confirm_deadline_ns = 0;
+    select_primary(ctrl);
+    return ctrl->connected;
+}
+
+/* Targets later writes at another present device, until the next arrival
+   or departure picks the primary again. */
+bool xbox_select_device(XboxController *ctrl, uint64_t device_id)
+{
+    XboxDevice *dev = find_device(ctrl, device_id);
+    if (!dev || dev->state != XBOX_DEV_PRESENT)
+        return false;
+    ctrl->device_id = device_id;
+    ctrl->connected = true;
+    return true;
+}
+
+int xbox_device_count(const XboxController *ctrl)
+{
+    int count = 0;
+    for (int i = 0; i < ctrl->device_count; i++) {
+        if (ctrl->devices[i].state == XBOX_DEV_PRESENT)
+            count++;
+    }
+    return count;
+}
+
+void xbox_close(XboxController *ctrl)
+{
+    if (ctrl->open) {
+        ctrl->transport.ops->close(ctrl->transport.self);
+        ctrl->open = false;
+    }
+    reset_reads(ctrl);
+    ctrl->device_count = 0;
+    ctrl->confirm_deadline_ns = 0;
     ctrl->device_id = 0;
     ctrl->connected = false;
 }
@@ -113,52 +549,423 @@ void xbox_close(XboxController *ctrl)
 void xbox_cleanup(XboxController *ctrl)
 {
     xbox_close(ctrl);
+    if (ctrl->transport.ops) {
+        ctrl->transport.ops->destroy(ctrl->transport.self);
+        ctrl->transport.ops = NULL;
+        ctrl->transport.self = NULL;
+    }
+}
+
+/* Sends write_buf and waits for the transport to finish with it. */
+static bool write_frame(XboxController *ctrl, uint32_t len)
+{
+    /* Reads keep completing while we wait, so the device table stays
+       current even when the write is slow. */
+    ctrl->write_done = false;
+    uint64_t start = xbox_time_ns();
+    bool queued = ctrl->transport.ops->write(ctrl->transport.self, ctrl->write_buf, len, ctrl->write_buf);
+    uint64_t deadline = start + WRITE_TIMEOUT_MS * 1000000ull;
+    while (queued && !ctrl->write_done && ctrl->open) {
+        uint32_t left = remaining_ms(deadline);
+        if (!left)
+            break;
+        xbox_pump(ctrl, left);
+    }
+
+    if (!ctrl->write_done || ctrl->write_status != GIP_IO_OK || ctrl->write_bytes != len) {
+        /* The device_id is only valid while the controller stays attached;
+           drop the session so the next xbox_open() rediscovers it. */
+        bool completed = ctrl->write_done;
+        unsigned long err = (unsigned long)ctrl->write_error;
+        xbox_close(ctrl);
+        if (completed)
+            snprintf(ctrl->error, sizeof(ctrl->error), "Write failed (error %lu)", err);
+        else
+            snprintf(ctrl->error, sizeof(ctrl->error), "Write did not complete");
+        ctrl->last_err = XBOX_ERR_SEND;
+        return false;
+    }
+
+    uint64_t took = xbox_time_ns() - start;
+    ctrl->write_latency_ns = took;
+    ctrl->write_latency_avg_ns = ctrl->write_latency_avg_ns
+        ? (ctrl->write_latency_avg_ns * 7 + took) / 8
+        : took;
+    return true;
+}
+
+/* The brightness the controller ends up with; gip_led_frame() clamps. */
+static uint8_t led_level(uint8_t brightness)
+{
+    return brightness > LED_BRIGHTNESS_MAX ? LED_BRIGHTNESS_MAX : brightness;
+}
+
+static bool led_cached(const XboxDevice *dev, uint8_t mode, uint8_t brightness)
+{
+    return dev->led_known && dev->led_mode == mode && dev->led_brightness == led_level(brightness);
+}
+
+static void led_took(XboxDevice *dev, uint8_t mode, uint8_t brightness)
+{
+    dev->led_known = true;
+    dev->led_mode = mode;
+    dev->led_brightness = led_level(brightness);
 }
 
+/* Writes that would not change the LED return true without touching the
+   bus; see led_known. */
 bool xbox_set_led(XboxController *ctrl, uint8_t mode, uint8_t brightness)
 {
-    if (!ctrl->connected || !ctrl->handle)
+    if (!xbox_is_open(ctrl))
+        return false;
+    XboxDevice *dev = find_device(ctrl, ctrl->device_id);
+    if (!dev)
         return false;
+    if (led_cached(dev, mode, brightness)) {
+        ctrl->write_stats.suppressed++;
+        return true;
+    }
+    dev->led_known = false;
 
-    if (brightness > LED_BRIGHTNESS_MAX)
-        brightness = LED_BRIGHTNESS_MAX;
+    uint8_t seq = dev->seq;
+    dev->seq = (uint8_t)((seq % 255) + 1);
 
-    uint8_t payload[] = { 0x00, mode, brightness };
-    uint8_t pkt[sizeof(GipHeader) + sizeof(payload)];
-    memset(pkt, 0, sizeof(pkt));
+    uint32_t len = gip_led_frame(ctrl->write_buf, ctrl->device_id, seq, mode, brightness);
+    ctrl->write_stats.sent++;
+    if (!ctrl->ack.request_ack) {
+        if (!write_frame(ctrl, len))
+            return false;
+        led_took(dev, mode, brightness);
+        return true;
+    }
 
-    GipHeader *hdr = (GipHeader *)pkt;
-    hdr->deviceId = ctrl->device_id;
-    hdr->commandId = GIP_CMD_LED;
-    hdr->clientFlags = GIP_OPT_INTERNAL;
-    hdr->sequence = ctrl->seq;
-    hdr->length = sizeof(payload);
-    memcpy(pkt + sizeof(GipHeader), payload, sizeof(payload));
+    ((GipHeader *)ctrl->write_buf)->clientFlags |= GIP_OPT_ACKNOWLEDGE;
+    dev->ack_seq = seq;
+    dev->ack_cmd = GIP_CMD_LED;
 
-    ctrl->seq = (ctrl->seq % 255) + 1;
+    /* Retransmits reuse the sequence number, so a late ack for an earlier
+       copy still counts. */
+    for (int attempt = 0; attempt <= ctrl->ack.max_retransmits; attempt++) {
+        if (attempt > 0)
+            dev->retransmits++;
+        dev->ack_wait = true;
+        dev->ack_sent_ns = xbox_time_ns();
+        if (!write_frame(ctrl, len))
+            return false;
 
-    DWORD written = 0;
-    OVERLAPPED ov;
-    memset(&ov, 0, sizeof(ov));
-    ov.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        uint64_t deadline = dev->ack_sent_ns + ctrl->ack.ack_timeout_ms * 1000000ull;
+        while (dev->ack_wait && ctrl->open) {
+            uint32_t left = remaining_ms(deadline);
+            if (!left)
+                break;
+            xbox_pump(ctrl, left);
+        }
+        if (!ctrl->open) {
+            snprintf(ctrl->error, sizeof(ctrl->error), "Controller lost while waiting for acknowledgement");
+            ctrl->last_err = XBOX_ERR_SEND;
+            return false;
+        }
+        if (!dev->ack_wait) {
+            led_took(dev, mode, brightness);
+            return true;
+        }
+    }
+
+    dev->ack_wait = false;
+    dev->ack_timeouts++;
+    snprintf(ctrl->error, sizeof(ctrl->error), "No acknowledgement after %d attempts",
+             ctrl->ack.max_retransmits + 1);
+    ctrl->last_err = XBOX_ERR_NO_ACK;
+    return false;
+}
 
-    BOOL ok = WriteFile((HANDLE)ctrl->handle, pkt, sizeof(pkt), &written, &ov);
-    if (!ok && GetLastError() == ERROR_IO_PENDING) {
-        WaitForSingleObject(ov.hEvent, 2000);
-        GetOverlappedResult((HANDLE)ctrl->handle, &ov, &written, FALSE);
+static bool batch_pending(const XboxController *ctrl)
+{
+    for (int i = 0; i < ctrl->batch_count; i++) {
+        if (!ctrl->batch[i].done)
+            return true;
     }
-    CloseHandle(ov.hEvent);
+    return false;
+}
 
-    if (written != sizeof(pkt)) {
-        snprintf(ctrl->error, sizeof(ctrl->error),
-                 "Write failed (error %lu)", GetLastError());
-        ctrl->last_err = XBOX_ERR_SEND;
-        return false;
+static bool batch_unacked(XboxController *ctrl)
+{
+    for (int i = 0; i < ctrl->batch_count; i++) {
+        XboxDevice *dev = find_device(ctrl, ctrl->batch[i].device_id);
+        if (dev && dev->ack_wait)
+            return true;
+    }
+    return false;
+}
+
+/* Keeps up to batch_window frames of the batch in flight, in batch order,
+   and pumps until every frame that needed sending has completed. A write
+   the transport refuses while others are in flight is tried again when one
+   of them completes; the timeout restarts whenever a frame finishes. */
+static void send_batch(XboxController *ctrl, const bool *resend)
+{
+    for (int i = 0; i < ctrl->batch_count; i++) {
+        XboxBatchWrite *w = &ctrl->batch[i];
+        w->queued = !resend[i];
+        if (resend[i])
+            w->done = false;
     }
 
+    int finished = -1;
+    uint64_t deadline = 0;
+    while (ctrl->open) {
+        int inflight = 0, done = 0;
+        for (int i = 0; i < ctrl->batch_count; i++) {
+            const XboxBatchWrite *w = &ctrl->batch[i];
+            inflight += w->queued && !w->done;
+            done += w->done;
+        }
+        for (int i = 0; i < ctrl->batch_count && inflight < ctrl->batch_window; i++) {
+            XboxBatchWrite *w = &ctrl->batch[i];
+            if (w->queued)
+                continue;
+            if (ctrl->transport.ops->write(ctrl->transport.self, w->buf, w->len, w)) {
+                XboxDevice *dev = ctrl->ack.request_ack ? find_device(ctrl, w->device_id) : NULL;
+                if (dev)
+                    dev->ack_sent_ns = xbox_time_ns();
+                w->queued = true;
+                inflight++;
+                continue;
+            }
+            if (inflight)
+                break;
+            w->queued = true;
+            w->done = true;
+            w->done_ns = xbox_time_ns();
+            w->status = GIP_IO_FAILED;
+            w->bytes = 0;
+            w->error = 0;
+            done++;
+        }
+        if (!batch_pending(ctrl))
+            break;
+
+        if (done != finished) {
+            finished = done;
+            deadline = xbox_time_ns() + WRITE_TIMEOUT_MS * 1000000ull;
+        }
+        uint32_t left = remaining_ms(deadline);
+        if (!left)
+            break;
+        xbox_pump(ctrl, left);
+    }
+}
+
+/* A broadcast holds XBOX_MAX_DEVICES frames; longer lists are refused
+   rather than cut short. */
+static bool too_many_targets(XboxController *ctrl, int count)
+{
+    if (count <= XBOX_MAX_DEVICES)
+        return false;
+    snprintf(ctrl->error, sizeof(ctrl->error), "%d controllers given, at most %d per write",
+             count, XBOX_MAX_DEVICES);
+    ctrl->last_err = XBOX_ERR_TOO_MANY;
     return true;
 }
 
+/*
+ * Broadcast form of xbox_set_led: one frame per target is encoded up front
+ * and up to batch_window of them are in flight at a time, so the whole set
+ * takes about one write round-trip per window instead of one per
+ * controller. Frames go out in target order, and a controller listed twice
+ * gets the first value. A controller that already shows its value gets no
+ * frame and counts as written. Fills one result per target and returns
+ * count, or -1 without writing anything when count is over
+ * XBOX_MAX_DEVICES. As with a single write, a failed write drops the
+ * session, here once the whole batch is over.
+ */
+int xbox_set_led_each(XboxController *ctrl, const XboxLedTarget *targets_in, int count,
+                      XboxLedResult *results)
+{
+    XboxLedResult local[XBOX_MAX_DEVICES];
+    bool          resend[XBOX_MAX_DEVICES];
+    int           targets = count < 0 ? 0 : count;
+    int           suppressed = 0;
+
+    if (too_many_targets(ctrl, targets))
+        return -1;
+    if (!results)
+        results = local;
+
+    ctrl->batch_count = 0;
+    for (int i = 0; i < targets; i++) {
+        const XboxLedTarget *t = &targets_in[i];
+        XboxDevice *dev = ctrl->open ? find_device(ctrl, t->device_id) : NULL;
+        results[i].device_id = t->device_id;
+        results[i].ok = false;
+        results[i].done_ns = 0;
+        if (!dev || dev->state != XBOX_DEV_PRESENT)
+            continue;
+        int first = -1;
+        for (int j = 0; j < i && first < 0; j++) {
+            if (targets_in[j].device_id == t->device_id)
+                first = j;
+        }
+        if (first >= 0) {
+            /* Batched duplicates get their result below. */
+            results[i] = results[first];
+            continue;
+        }
+        if (led_cached(dev, t->mode, t->brightness)) {
+            results[i].ok = true;
+            results[i].done_ns = xbox_time_ns();
+            ctrl->write_stats.suppressed++;
+            suppressed++;
+            continue;
+        }
+        dev->led_known = false;
+
+        XboxBatchWrite *w = &ctrl->batch[ctrl->batch_count];
+        resend[ctrl->batch_count++] = true;
+        uint8_t seq = dev->seq;
+        dev->seq = (uint8_t)((seq % 255) + 1);
+        w->device_id = dev->device_id;
+        w->mode = t->mode;
+        w->brightness = t->brightness;
+        w->len = gip_led_frame(w->buf, dev->device_id, seq, t->mode, t->brightness);
+        if (ctrl->ack.request_ack) {
+            ((GipHeader *)w->buf)->clientFlags |= GIP_OPT_ACKNOWLEDGE;
+            dev->ack_seq = seq;
+            dev->ack_cmd = GIP_CMD_LED;
+        }
+    }
+    if (!ctrl->batch_count) {
+        if (suppressed) {
+            ctrl->last_err = XBOX_OK;
+            ctrl->error[0] = '\0';
+        } else {
+            snprintf(ctrl->error, sizeof(ctrl->error), "No Xbox controller found");
+            ctrl->last_err = XBOX_ERR_NO_DEVICE;
+        }
+        return targets;
+    }
+    ctrl->write_stats.sent += (uint64_t)ctrl->batch_count;
+
+    uint64_t start = xbox_time_ns();
+    int attempts = ctrl->ack.request_ack ? ctrl->ack.max_retransmits + 1 : 1;
+    for (int attempt = 0; attempt < attempts && ctrl->open; attempt++) {
+        for (int i = 0; i < ctrl->batch_count && ctrl->ack.request_ack; i++) {
+            XboxDevice *dev = find_device(ctrl, ctrl->batch[i].device_id);
+            if (!resend[i] || !dev)
+                continue;
+            if (attempt > 0)
+                dev->retransmits++;
+            dev->ack_wait = true;
+        }
+        send_batch(ctrl, resend);
+        if (!ctrl->ack.request_ack)
+            break;
+
+        /* send_batch stamps each frame as it goes out; the last one sent
+           gets the full ack timeout. */
+        uint64_t sent = 0;
+        for (int i = 0; i < ctrl->batch_count; i++) {
+            XboxDevice *dev = find_device(ctrl, ctrl->batch[i].device_id);
+            if (resend[i] && dev && dev->ack_sent_ns > sent)
+                sent = dev->ack_sent_ns;
+        }
+        uint64_t deadline = sent + ctrl->ack.ack_timeout_ms * 1000000ull;
+        while (ctrl->open && batch_unacked(ctrl)) {
+            uint32_t left = remaining_ms(deadline);
+            if (!left)
+                break;
+            xbox_pump(ctrl, left);
+        }
+        for (int i = 0; i < ctrl->batch_count; i++) {
+            XboxDevice *dev = find_device(ctrl, ctrl->batch[i].device_id);
+            resend[i] = dev && dev->ack_wait;
+        }
+    }
+
+    int failed = 0, unacked = 0;
+    unsigned long err = 0;
+    for (int i = 0; i < ctrl->batch_count; i++) {
+        XboxBatchWrite *w = &ctrl->batch[i];
+        XboxDevice *dev = ctrl->open ? find_device(ctrl, w->device_id) : NULL;
+        bool ok = ctrl->open && w->done && w->status == GIP_IO_OK && w->bytes == w->len;
+        if (!ok) {
+            failed++;
+            if (w->done && w->status != GIP_IO_OK)
+                err = (unsigned long)w->error;
+        } else if (dev && dev->ack_wait) {
+            dev->ack_wait = false;
+            dev->ack_timeouts++;
+            unacked++;
+            ok = false;
+        }
+        uint64_t done_ns = 0;
+        if (ok) {
+            done_ns = ctrl->ack.request_ack && dev ? dev->ack_sent_ns + dev->ack_rtt_ns : w->done_ns;
+            if (dev)
+                led_took(dev, w->mode, w->brightness);
+        }
+        for (int j = 0; j < targets; j++) {
+            if (results[j].device_id == w->device_id) {
+                results[j].ok = ok;
+                results[j].done_ns = done_ns;
+            }
+        }
+    }
+
+    uint64_t took = xbox_time_ns() - start;
+    ctrl->write_latency_ns = took;
+    ctrl->write_latency_avg_ns = ctrl->write_latency_avg_ns
+        ? (ctrl->write_latency_avg_ns * 7 + took) / 8
+        : took;
+
+    if (failed) {
+        bool open = ctrl->open;
+        xbox_close(ctrl);
+        if (!open)
+            snprintf(ctrl->error, sizeof(ctrl->error), "Controller lost during broadcast");
+        else
+            snprintf(ctrl->error, sizeof(ctrl->error), "%d of %d writes failed (error %lu)",
+                     failed, ctrl->batch_count, err);
+        ctrl->last_err = XBOX_ERR_SEND;
+    } else if (unacked) {
+        snprintf(ctrl->error, sizeof(ctrl->error), "%d of %d controllers did not acknowledge",
+                 unacked, ctrl->batch_count);
+        ctrl->last_err = XBOX_ERR_NO_ACK;
+    } else {
+        ctrl->last_err = XBOX_OK;
+        ctrl->error[0] = '\0';
+    }
+    ctrl->batch_count = 0;
+    return targets;
+}
+
+/* One value for several controllers; ids NULL (or count 0) targets every
+   present device. Returns -1 when more than XBOX_MAX_DEVICES ids are
+   given. */
+int xbox_set_led_many(XboxController *ctrl, const uint64_t *ids, int count,
+                      uint8_t mode, uint8_t brightness, XboxLedResult *results)
+{
+    XboxLedTarget targets[XBOX_MAX_DEVICES];
+    int n = 0;
+
+    if (!ids || count <= 0) {
+        for (int i = 0; ctrl->open && i < ctrl->device_count; i++) {
+            if (ctrl->devices[i].state == XBOX_DEV_PRESENT)
+                targets[n++].device_id = ctrl->devices[i].device_id;
+        }
+    } else {
+        if (too_many_targets(ctrl, count))
+            return -1;
+        for (int i = 0; i < count; i++)
+            targets[n++].device_id = ids[i];
+    }
+    for (int i = 0; i < n; i++) {
+        targets[i].mode = mode;
+        targets[i].brightness = brightness;
+    }
+    return xbox_set_led_each(ctrl, targets, n, results);
+}
+
 bool xbox_set_brightness(XboxController *ctrl, uint8_t brightness)
 {
     if (brightness == 0)
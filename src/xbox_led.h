@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "gip_transport.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,28 +26,192 @@ extern "C" {
 #define XBOX_ERR_NO_DEVICE   1
 #define XBOX_ERR_OPEN_FAILED 3
 #define XBOX_ERR_SEND        5
+#define XBOX_ERR_NO_ACK      6
+#define XBOX_ERR_TOO_MANY    7
 
 #define LED_BRIGHTNESS_MIN     0
 #define LED_BRIGHTNESS_MAX     47
 #define LED_BRIGHTNESS_DEFAULT 20
 
+#define XBOX_MAX_DEVICES 16
+#define XBOX_READ_SIZE   4096
+
+/* Reads kept posted at once; the depth is adjustable up to the max, and
+   goes to the max once the driver reports dropping a frame. */
+#define XBOX_READ_DEPTH_MAX     8
+#define XBOX_READ_DEPTH_DEFAULT 4
+
+/* Broadcast frames kept in flight at once; adjustable from 1 up to the
+   max, which sends every frame of a broadcast together. */
+#define XBOX_BATCH_WINDOW_MAX XBOX_MAX_DEVICES
+
+#define XBOX_DEV_ABSENT  0
+#define XBOX_DEV_PRESENT 1
+
+#define XBOX_EVENT_ARRIVED 0x01
+#define XBOX_EVENT_LEFT    0x02
+#define XBOX_EVENT_CLOSED  0x04
+
 typedef struct {
-    void    *handle;
-    void    *read_event;
     uint64_t device_id;
+    uint64_t first_seen_ns;
+    uint64_t last_seen_ns;
+    uint64_t arrived_ns;     /* latest transition to present, or unprompted announce
+                                (a reset re-announces without leaving) */
+    uint32_t scan_gen;
+    uint8_t  state;
+
+    /* Sequence numbers run 1..255 per device for the whole session. */
     uint8_t  seq;
-    bool     connected;
-    int      last_err;
-    char     error[128];
+    bool     ack_wait;
+    uint8_t  ack_seq;
+    uint8_t  ack_cmd;
+    uint64_t ack_sent_ns;
+    uint64_t ack_rtt_ns;
+    uint64_t ack_rtt_avg_ns;
+    uint32_t acks;
+    uint32_t retransmits;
+    uint32_t ack_timeouts;
+
+    /* Last LED value the controller took (acknowledged, when acks are
+       requested). Cleared when it announces, since it resets its LED. */
+    bool     led_known;
+    uint8_t  led_mode;
+    uint8_t  led_brightness;
+} XboxDevice;
+
+/* With request_ack set, LED writes ask for an acknowledgement and are sent
+   again (same sequence) when none arrives within ack_timeout_ms. */
+typedef struct {
+    bool     request_ack;
+    uint32_t ack_timeout_ms;
+    uint8_t  max_retransmits;
+} XboxAckPolicy;
+
+/* Asked between waits while xbox_open() and xbox_rescan() look for
+   controllers; returning true ends the search early. Called on the thread
+   doing the search, so pair it with xbox_wake() to end a wait in progress. */
+typedef bool (*XboxInterruptFn)(void *ctx);
+
+#define XBOX_READ_IDLE   0
+#define XBOX_READ_POSTED 1
+#define XBOX_READ_DONE   2
+
+typedef struct {
+    uint8_t  buf[XBOX_READ_SIZE];
+    uint32_t bytes;
+    uint8_t  status;
+    uint8_t  state;
+} XboxRead;
+
+typedef struct {
+    uint64_t completed;
+    uint64_t messages;
+    uint64_t overruns;   /* reads that filled the buffer or cut a message short */
+    uint64_t starved;    /* times the ring ran dry with the session open */
+    uint64_t dropped;    /* inbound frames the driver discarded, where it can tell */
+    uint64_t recoveries; /* reenumerates sent because frames were dropped */
+} XboxReadStats;
+
+typedef struct {
+    uint64_t sent;         /* LED frames written, not counting retransmits */
+    uint64_t suppressed;   /* LED writes dropped: the controller already shows it */
+} XboxWriteStats;
+
+/* One controller's frame in a broadcast; see xbox_set_led_many. */
+typedef struct {
+    uint64_t device_id;
+    uint8_t  buf[64];
+    uint32_t len;
+    uint8_t  mode;
+    uint8_t  brightness;
+    bool     queued;
+    bool     done;
+    uint8_t  status;
+    uint32_t bytes;
+    uint32_t error;
+    uint64_t done_ns;
+} XboxBatchWrite;
+
+typedef struct {
+    uint64_t device_id;
+    uint8_t  mode;
+    uint8_t  brightness;
+} XboxLedTarget;
+
+typedef struct {
+    uint64_t device_id;
+    bool     ok;
+    uint64_t done_ns;   /* write completed, or ack received when asked for */
+} XboxLedResult;
+
+typedef struct {
+    GipTransport transport;
+    bool         open;
+
+    /* Reads are posted and consumed in ring order, so messages are parsed
+       in arrival order even if completions are reported out of order. */
+    XboxRead      reads[XBOX_READ_DEPTH_MAX];
+    int           read_depth;
+    uint32_t      read_head;
+    uint32_t      read_tail;
+    XboxReadStats read_stats;
+    uint64_t      transport_dropped;   /* driver's count when last looked at */
+    uint64_t      recover_after_ns;
+    bool          recover_pending;
+
+    bool         write_done;
+    uint8_t      write_status;
+    uint32_t     write_bytes;
+    uint32_t     write_error;
+    uint8_t      write_buf[64];
+    uint64_t     write_latency_ns;
+    uint64_t     write_latency_avg_ns;
+    XboxWriteStats write_stats;
+
+    XboxBatchWrite batch[XBOX_MAX_DEVICES];
+    int            batch_count;
+    int            batch_window;
+
+    XboxDevice   devices[XBOX_MAX_DEVICES];
+    int          device_count;
+    uint32_t     scan_gen;
+    uint64_t     confirm_deadline_ns;   /* xbox_open_cached(): unannounced IDs expire then */
+
+    XboxAckPolicy ack;
+    XboxInterruptFn interrupt;
+    void           *interrupt_ctx;
+
+    uint64_t     device_id;
+    bool         connected;
+    int          last_err;
+    char         error[128];
 } XboxController;
 
-void xbox_init(XboxController *ctrl);
-bool xbox_open(XboxController *ctrl);
-void xbox_close(XboxController *ctrl);
-void xbox_cleanup(XboxController *ctrl);
-bool xbox_set_led(XboxController *ctrl, uint8_t mode, uint8_t brightness);
-bool xbox_set_brightness(XboxController *ctrl, uint8_t brightness);
-bool xbox_led_off(XboxController *ctrl);
+void     xbox_init(XboxController *ctrl);
+void     xbox_init_with_transport(XboxController *ctrl, GipTransport transport);
+bool     xbox_open(XboxController *ctrl);
+bool     xbox_open_cached(XboxController *ctrl, const uint64_t *ids, int count, uint32_t window_ms);
+bool     xbox_is_open(const XboxController *ctrl);
+bool     xbox_rescan(XboxController *ctrl, uint32_t window_ms);
+unsigned xbox_pump(XboxController *ctrl, uint32_t timeout_ms);
+void     xbox_wake(XboxController *ctrl);
+void     xbox_set_read_depth(XboxController *ctrl, int depth);
+void     xbox_set_ack_policy(XboxController *ctrl, const XboxAckPolicy *policy);
+void     xbox_set_interrupt(XboxController *ctrl, XboxInterruptFn fn, void *ctx);
+void     xbox_set_batch_window(XboxController *ctrl, int frames);
+int      xbox_device_count(const XboxController *ctrl);
+bool     xbox_select_device(XboxController *ctrl, uint64_t device_id);
+void     xbox_close(XboxController *ctrl);
+void     xbox_cleanup(XboxController *ctrl);
+bool     xbox_set_led(XboxController *ctrl, uint8_t mode, uint8_t brightness);
+int      xbox_set_led_many(XboxController *ctrl, const uint64_t *ids, int count,
+                           uint8_t mode, uint8_t brightness, XboxLedResult *results);
+int      xbox_set_led_each(XboxController *ctrl, const XboxLedTarget *targets, int count,
+                           XboxLedResult *results);
+bool     xbox_set_brightness(XboxController *ctrl, uint8_t brightness);
+bool     xbox_led_off(XboxController *ctrl);
+uint64_t xbox_time_ns(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,83 @@
+/*
+ * Acknowledged LED writes against a loopback driver that swallows every
+ * other ack: the write whose ack is lost must be sent once more and
+ * settled by the second ack, with a round trip near the driver's latency.
+ * An ack is not an announce, so one from an unknown id must not add a
+ * controller.
+ */
+#include "gip_loopback.h"
+#include "test_util.h"
+
+#include <cstring>
+
+extern "C" {
+#include "gip_protocol.h"
+#include "xbox_led.h"
+}
+
+static const uint64_t DEVICE = 0x7E5700000001ull;
+static const uint64_t STRANGER = 0x7E57000000FFull;
+static const uint32_t WRITE_LATENCY_US = 2000;
+static const uint32_t READ_LATENCY_US = 1000;
+static const uint32_t ACK_TIMEOUT_MS = 50;
+
+int main()
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = WRITE_LATENCY_US;
+    cfg.read_latency_us = READ_LATENCY_US;
+    cfg.drop_ack_every = 2;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, DEVICE);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+    CHECK(xbox_open(&ctrl));
+    CHECK(xbox_device_count(&ctrl) == 1);
+
+    XboxAckPolicy policy = {};
+    policy.request_ack = true;
+    policy.ack_timeout_ms = ACK_TIMEOUT_MS;
+    policy.max_retransmits = 2;
+    xbox_set_ack_policy(&ctrl, &policy);
+    XboxDevice *dev = &ctrl.devices[0];
+
+    /* First ack gets through. */
+    CHECK(xbox_set_led(&ctrl, LED_MODE_ON, 10));
+    CHECK(dev->acks == 1);
+    CHECK(dev->retransmits == 0);
+
+    /* Second is dropped; the retransmit's ack settles it. */
+    CHECK(xbox_set_led(&ctrl, LED_MODE_ON, 20));
+    GipLoopbackStats ls;
+    gip_loopback_stats(t, &ls);
+    double rtt_ms = (double)dev->ack_rtt_ns / 1e6;
+    printf("%llu acks sent, %llu dropped; %u retransmits, last rtt %.2f ms\n",
+           (unsigned long long)ls.acks, (unsigned long long)ls.dropped_acks,
+           dev->retransmits, rtt_ms);
+    CHECK(ls.dropped_acks == 1);
+    CHECK(dev->acks == 2);
+    CHECK(dev->retransmits == 1);
+    CHECK(dev->ack_timeouts == 0);
+    CHECK(dev->ack_rtt_ns >= READ_LATENCY_US * 1000ull);
+    CHECK(dev->ack_rtt_ns < ACK_TIMEOUT_MS * 1000000ull);
+    uint8_t mode = 0, bright = 0;
+    CHECK(gip_loopback_led_state(t, DEVICE, &mode, &bright));
+    CHECK(bright == 20);
+
+    /* A stray ack from an id that never announced. */
+    std::vector<uint8_t> f(sizeof(GipHeader) + 5);
+    GipHeader h = {};
+    h.deviceId = STRANGER;
+    h.commandId = GIP_CMD_ACKNOWLEDGE;
+    h.length = 5;
+    memcpy(f.data(), &h, sizeof(h));
+    CHECK(gip_loopback_inject(t, f.data(), (uint32_t)f.size()));
+    unsigned ev = 0;
+    for (int i = 0; i < 5; i++)
+        ev |= xbox_pump(&ctrl, 10);
+    CHECK(!(ev & XBOX_EVENT_ARRIVED));
+    CHECK(xbox_device_count(&ctrl) == 1);
+
+    xbox_cleanup(&ctrl);
+    return TestExit();
+}
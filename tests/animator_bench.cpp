@@ -0,0 +1,65 @@
+/*
+ * Runs a breathing animation at the full 100 Hz into a loopback controller
+ * and reports how late ticks fire against their absolute deadlines. Over
+ * the run, ticks fired plus ticks skipped must match the elapsed time, so
+ * a late tick never pushes the schedule back.
+ */
+#include "gip_loopback.h"
+#include "led_animator.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <thread>
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+static const uint64_t DEVICE = 0x7E5700000001ull;
+static const int      RUN_MS = 600;
+
+int main()
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = 300;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, DEVICE);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+    CHECK(xbox_open(&ctrl));
+
+    int failed = 0;
+    LedAnimator anim([&](uint8_t level) { failed += !xbox_set_led(&ctrl, LED_MODE_ON, level); });
+
+    AnimatorConfig ac = {};
+    ac.curve = ANIM_BREATHE;
+    ac.period_ms = 200;
+    ac.rate_hz = LedAnimator::MAX_RATE_HZ;
+    ac.peak = LED_BRIGHTNESS_MAX;
+    uint64_t start = xbox_time_ns();
+    anim.Start(ac);
+    std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MS));
+    anim.Stop();
+    double elapsed_ms = (xbox_time_ns() - start) / 1e6;
+
+    AnimatorStats s = anim.Stats();
+    GipLoopbackStats ls;
+    gip_loopback_stats(t, &ls);
+    printf("%llu ticks, %llu skipped in %.1f ms; lateness p50 %.0f us, p99 %.0f us, max %.0f us; "
+           "%llu frames, %llu written\n",
+           (unsigned long long)s.ticks, (unsigned long long)s.skipped, elapsed_ms, s.p50_us,
+           s.p99_us, s.max_us, (unsigned long long)s.frames, (unsigned long long)ls.writes);
+
+    double expected = elapsed_ms * ac.rate_hz / 1000.0;
+    double scheduled = (double)(s.ticks + s.skipped);
+    CHECK(scheduled >= expected - 2 && scheduled <= expected + 1);
+    CHECK(s.ticks >= scheduled * 0.9);
+    CHECK(failed == 0);
+    CHECK(s.frames > 0 && ls.writes <= s.frames);
+    /* Loose bounds: this runs on shared CI machines. */
+    CHECK(s.p50_us < 2000);
+    CHECK(s.p99_us < 20000);
+
+    xbox_cleanup(&ctrl);
+    return TestExit();
+}
@@ -0,0 +1,169 @@
+/*
+ * UI, tray and animation threads fire commands at the worker queue as fast
+ * as they can while a worker writes them to a loopback controller with a
+ * realistic write latency. The controller must end on the last committed
+ * value, committed applies must reach the worker in order, none may be
+ * refused, and far fewer frames than commands may be written. Closing the
+ * queue must also cut short a worker still looking for a controller.
+ */
+#include "app_config.h"
+#include "command_queue.h"
+#include "gip_loopback.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+static const uint64_t DEVICE = 0x7E5700000001ull;
+static const int      UI_POSTS = 4000;
+static const int      TRAY_POSTS = 500;
+static const int      ANIM_POSTS = 4000;
+static const uint8_t  FINAL_BRIGHTNESS = 33;
+
+static std::mutex              g_wake_mu;
+static std::condition_variable g_wake_cv;
+static bool                    g_woken = false;
+
+static void Wake()
+{
+    std::lock_guard<std::mutex> lock(g_wake_mu);
+    g_woken = true;
+    g_wake_cv.notify_one();
+}
+
+static WorkerCommand Apply(int brightness, bool preview)
+{
+    WorkerCommand wc = {};
+    wc.type = CMD_APPLY;
+    wc.device_id = DEVICE;
+    wc.mode_idx = DEFAULT_MODE;
+    wc.brightness = brightness;
+    wc.preview = preview;
+    return wc;
+}
+
+/* As the app shuts down while discovery waits on an empty bus. */
+static void CloseDuringDiscovery()
+{
+    GipLoopbackConfig cfg = {};
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, gip_loopback_create(&cfg));
+    CommandQueue queue([&] { xbox_wake(&ctrl); });
+    xbox_set_interrupt(&ctrl, [](void *q) { return ((CommandQueue *)q)->Closed(); }, &queue);
+
+    uint64_t start = xbox_time_ns();
+    std::thread closer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.Close();
+    });
+    CHECK(!xbox_open(&ctrl));
+    double open_ms = (xbox_time_ns() - start) / 1e6;
+    closer.join();
+    printf("discovery gave up %.1f ms after start, closed at 50 ms\n", open_ms);
+    CHECK(open_ms < 500);
+    xbox_cleanup(&ctrl);
+}
+
+int main()
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = 200;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, DEVICE);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+    CHECK(xbox_open(&ctrl));
+
+    CommandQueue queue(Wake);
+    int  last_committed = -1;
+    bool in_order = true;
+
+    std::thread worker([&] {
+        while (!queue.Closed()) {
+            {
+                std::unique_lock<std::mutex> lock(g_wake_mu);
+                g_wake_cv.wait(lock, [] { return g_woken; });
+                g_woken = false;
+            }
+            WorkerCommand cmd;
+            while (!queue.Closed() && queue.Take(&cmd)) {
+                if (cmd.type != CMD_APPLY)
+                    continue;
+                /* As RunPreview: a committed apply behind it wins anyway. */
+                if (cmd.preview && queue.HasPending(CMD_APPLY, cmd.device_id))
+                    continue;
+                if (!cmd.preview) {
+                    in_order = in_order && cmd.brightness > last_committed;
+                    last_committed = cmd.brightness;
+                }
+                xbox_set_led(&ctrl, MODES[cmd.mode_idx].value,
+                             (uint8_t)(cmd.brightness % (LED_BRIGHTNESS_MAX + 1)));
+            }
+        }
+    });
+
+    int refused = 0;
+    uint64_t start = xbox_time_ns();
+    std::thread ui([&] {
+        for (int i = 0; i < UI_POSTS; i++)
+            refused += !queue.Post(Apply(i, false));
+    });
+    std::thread tray([&] {
+        WorkerCommand wc = {};
+        wc.type = CMD_REFRESH;
+        for (int i = 0; i < TRAY_POSTS; i++)
+            queue.Post(wc);
+    });
+    std::thread anim([&] {
+        for (int i = 0; i < ANIM_POSTS; i++)
+            queue.Post(Apply(i % (LED_BRIGHTNESS_MAX + 1), true));
+    });
+    ui.join();
+    tray.join();
+    anim.join();
+    double post_s = (xbox_time_ns() - start) / 1e9;
+
+    /* The click that should stick: above every earlier one, and written
+       as FINAL_BRIGHTNESS. */
+    int final_value = (UI_POSTS / (LED_BRIGHTNESS_MAX + 1) + 1) * (LED_BRIGHTNESS_MAX + 1) +
+                      FINAL_BRIGHTNESS;
+    CHECK(queue.Post(Apply(final_value, false)));
+    uint64_t deadline = xbox_time_ns() + 5000000000ull;
+    while (queue.Busy() && xbox_time_ns() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(!queue.Busy());
+    queue.Close();
+    worker.join();
+
+    uint8_t mode = 0, brightness = 0;
+    CHECK(gip_loopback_led_state(t, DEVICE, &mode, &brightness));
+    GipLoopbackStats ls;
+    gip_loopback_stats(t, &ls);
+    CommandQueueStats qs = queue.Stats();
+    printf("%llu posts in %.1f ms (%.0f/s): %llu executed, %llu coalesced, %llu overflowed, "
+           "%llu previews dropped, %llu frames written\n",
+           (unsigned long long)qs.posted, post_s * 1e3, qs.posted / post_s,
+           (unsigned long long)qs.executed, (unsigned long long)qs.coalesced,
+           (unsigned long long)qs.overflowed, (unsigned long long)qs.dropped,
+           (unsigned long long)ls.writes);
+
+    CHECK(mode == LED_MODE_ON);
+    CHECK(brightness == FINAL_BRIGHTNESS);
+    CHECK(refused == 0);
+    CHECK(in_order);
+    CHECK(last_committed == final_value);
+    CHECK(qs.posted == (uint64_t)(UI_POSTS + TRAY_POSTS + ANIM_POSTS + 1));
+    CHECK(qs.executed + qs.coalesced + qs.dropped == qs.posted);
+    CHECK(ls.writes <= qs.executed);
+    CHECK(ls.writes < qs.posted / 10);
+
+    xbox_cleanup(&ctrl);
+    CloseDuringDiscovery();
+    return TestExit();
+}
@@ -0,0 +1,119 @@
+/*
+ * Decoder throughput over a synthetic read buffer shaped like a busy read
+ * from \\.\XboxGIP: mostly input reports, with status, guide and announce
+ * messages mixed in and a truncated message at the end. The walk must find
+ * every message with its fields intact before it is timed.
+ */
+#include "test_util.h"
+
+#include <cstring>
+
+extern "C" {
+#include "gip_decode.h"
+#include "gip_protocol.h"
+#include "xbox_led.h"
+}
+
+static const int PASSES = 20000;
+
+static void Put(std::vector<uint8_t> *buf, uint64_t device_id, uint8_t cmd, uint8_t seq,
+                const uint8_t *payload, uint32_t len, uint32_t claimed)
+{
+    GipHeader h = {};
+    h.deviceId = device_id;
+    h.commandId = cmd;
+    h.sequence = seq;
+    h.length = claimed;
+    const uint8_t *p = (const uint8_t *)&h;
+    buf->insert(buf->end(), p, p + sizeof(h));
+    buf->insert(buf->end(), payload, payload + len);
+}
+
+struct Counts {
+    int input, status, guide, announce, other, truncated;
+    int64_t stick_sum;
+};
+
+static Counts Walk(const std::vector<uint8_t> &buf)
+{
+    Counts c = {};
+    GipDecoder d;
+    GipMsg msg;
+    GipInput in;
+    GipStatus st;
+    GipGuide g;
+    GipAnnounce an;
+    gip_decoder_init(&d, buf.data(), (uint32_t)buf.size());
+    while (gip_decode_next(&d, &msg)) {
+        c.truncated += msg.truncated;
+        if (gip_msg_input(&msg, &in)) {
+            c.input++;
+            c.stick_sum += in.left_x;
+        } else if (gip_msg_status(&msg, &st)) {
+            c.status++;
+        } else if (gip_msg_guide(&msg, &g)) {
+            c.guide += g.pressed;
+        } else if (gip_msg_announce(&msg, &an)) {
+            c.announce += an.vendor_id == 0x045e;
+        } else {
+            c.other++;
+        }
+    }
+    return c;
+}
+
+int main()
+{
+    std::vector<uint8_t> buf;
+    int64_t stick_sum = 0;
+    int inputs = 0;
+    for (int i = 0; i < 100; i++) {
+        uint8_t input[14] = {};
+        int16_t x = (int16_t)(i * 300 - 15000);
+        memcpy(input + 6, &x, sizeof(x));
+        Put(&buf, 0x7E5700000001ull + (uint64_t)(i & 3), GIP_CMD_INPUT, (uint8_t)i, input,
+            sizeof(input), sizeof(input));
+        stick_sum += x;
+        inputs++;
+        if (i % 25 == 0) {
+            uint8_t status[4] = { GIP_STATUS_CONNECTED | 0x07, 0, 0, 0 };
+            Put(&buf, 0x7E5700000001ull, GIP_CMD_STATUS, (uint8_t)i, status, sizeof(status),
+                sizeof(status));
+        }
+        if (i % 50 == 0) {
+            uint8_t guide[2] = { 0x01, 0x5b };
+            Put(&buf, 0x7E5700000001ull, GIP_CMD_GUIDE, (uint8_t)i, guide, sizeof(guide),
+                sizeof(guide));
+            uint8_t announce[28] = { 1, 2, 3, 4, 5, 6, 0, 0, 0x5e, 0x04, 0x12, 0x0b };
+            Put(&buf, 0x7E5700000005ull, GIP_CMD_ANNOUNCE, (uint8_t)i, announce,
+                sizeof(announce), sizeof(announce));
+        }
+    }
+    /* The read cut the last message short. */
+    uint8_t tail[6] = {};
+    Put(&buf, 0x7E5700000001ull, GIP_CMD_INPUT, 0, tail, sizeof(tail), 14);
+
+    Counts c = Walk(buf);
+    CHECK(c.input == inputs);
+    CHECK(c.stick_sum == stick_sum);
+    CHECK(c.status == 4);
+    CHECK(c.guide == 2);
+    CHECK(c.announce == 2);
+    CHECK(c.other == 1);   /* the truncated input is too short for a view */
+    CHECK(c.truncated == 1);
+    int per_pass = c.input + c.status + c.guide + c.announce + c.other;
+
+    int64_t check = 0;
+    uint64_t start = xbox_time_ns();
+    for (int i = 0; i < PASSES; i++)
+        check += Walk(buf).stick_sum;
+    double s = (xbox_time_ns() - start) / 1e9;
+    double rate = (double)per_pass * PASSES / s;
+    printf("%d-byte buffer, %d messages: %.1f M msgs/s, %.0f MB/s\n", (int)buf.size(), per_pass,
+           rate / 1e6, buf.size() * (double)PASSES / s / 1e6);
+
+    CHECK(check == stick_sum * PASSES);
+    /* A controller sends input at most every few ms; this is orders above. */
+    CHECK(rate > 1e6);
+    return TestExit();
+}
@@ -0,0 +1,81 @@
+/*
+ * The compile-time LED frame table against encoding at runtime the way
+ * xbox_set_led used to: zero a stack buffer, fill GipHeader field by field,
+ * copy the payload in. Every (mode, brightness) pair must give the same
+ * bytes either way; then both are timed over the same sequence of values.
+ */
+#include "gip_frames.hpp"
+#include "test_util.h"
+
+#include <cstring>
+
+static const int ITERATIONS = 2000000;
+
+static uint32_t RuntimeEncode(uint8_t *out, uint64_t device_id, uint8_t seq, uint8_t mode,
+                              uint8_t brightness)
+{
+    if (brightness > LED_BRIGHTNESS_MAX)
+        brightness = LED_BRIGHTNESS_MAX;
+    uint8_t payload[] = { 0x00, mode, brightness };
+    uint8_t pkt[sizeof(GipHeader) + sizeof(payload)];
+    memset(pkt, 0, sizeof(pkt));
+    GipHeader *hdr = (GipHeader *)pkt;
+    hdr->deviceId = device_id;
+    hdr->commandId = GIP_CMD_LED;
+    hdr->clientFlags = GIP_OPT_INTERNAL;
+    hdr->sequence = seq;
+    hdr->length = sizeof(payload);
+    memcpy(pkt + sizeof(GipHeader), payload, sizeof(payload));
+    memcpy(out, pkt, sizeof(pkt));
+    return (uint32_t)sizeof(pkt);
+}
+
+template <typename Encode>
+static double NsPerFrame(Encode encode, uint32_t *checksum)
+{
+    uint8_t buf[GIP_LED_FRAME_LEN];
+    uint32_t sum = 0;
+    uint64_t start = xbox_time_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint8_t mode = (uint8_t)(i & 15);
+        uint8_t level = (uint8_t)(i % (LED_BRIGHTNESS_MAX + 1));
+        uint32_t len = encode(buf, 0x7E5700000001ull + (uint64_t)(i & 7), (uint8_t)i, mode, level);
+        sum += len + buf[10] + buf[22];
+    }
+    double ns = (double)(xbox_time_ns() - start) / ITERATIONS;
+    *checksum = sum;
+    return ns;
+}
+
+int main()
+{
+    uint8_t a[GIP_LED_FRAME_LEN], b[GIP_LED_FRAME_LEN];
+    int mismatches = 0;
+    /* Past GIP_LED_MODE_COUNT the table falls back to encode_led; past the
+       maximum brightness both clamp. */
+    for (int mode = 0; mode < GIP_LED_MODE_COUNT + 4; mode++) {
+        for (int level = 0; level <= LED_BRIGHTNESS_MAX + 8; level++) {
+            uint32_t la = gip_led_frame(a, 0x0123456789ABCDEFull, (uint8_t)(mode * 7 + level),
+                                        (uint8_t)mode, (uint8_t)level);
+            uint32_t lb = RuntimeEncode(b, 0x0123456789ABCDEFull, (uint8_t)(mode * 7 + level),
+                                        (uint8_t)mode, (uint8_t)level);
+            mismatches += la != lb || memcmp(a, b, la) != 0;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    uint32_t sum_rt = 0, sum_tab = 0, sum_c = 0;
+    double rt = NsPerFrame(RuntimeEncode, &sum_rt);
+    double tab = NsPerFrame(
+        [](uint8_t *out, uint64_t id, uint8_t seq, uint8_t mode, uint8_t level) {
+            return (uint32_t)gip::write_led(out, id, seq, mode, level);
+        },
+        &sum_tab);
+    double c = NsPerFrame(gip_led_frame, &sum_c);
+    printf("ns per frame: runtime encode %.2f, table %.2f, table via C entry %.2f\n", rt, tab, c);
+
+    CHECK(sum_tab == sum_rt && sum_c == sum_rt);
+    /* Both are a few ns; only a gross regression should fail here. */
+    CHECK(tab < rt * 3 + 5);
+    return TestExit();
+}
@@ -0,0 +1,127 @@
+/*
+ * HotplugTracker against synthetic storms of device notifications on a
+ * simulated clock: a dock replugging, a hub flooding events while a
+ * controller is connected, and a controller plugged in mid-storm. The
+ * number of discoveries and rescans must stay within one per max_delay of
+ * storm, other vendors' devices must never cause one, and a controller
+ * arrival must still be acted on at once. Also checks Classify on the
+ * interface paths involved and reports the cost per event.
+ */
+#include "hotplug.h"
+#include "test_util.h"
+
+#include <ctime>
+#include <random>
+
+static const uint64_t MS = 1000000ull;
+
+static const char *const GIP_PATH =
+    "\\\\?\\USB#VID_045E&PID_02EA&MI_00#7&1a2b3c4d&0&0000#{020bc73c-0dca-4ee3-96d5-ab006ada5938}";
+static const char *const SERIES_PATH =
+    "\\\\?\\USB#VID_045E&PID_0B12#3032363030303130#{a5dcbf10-6530-11d2-901f-00c04fb951ed}";
+static const char *const ADAPTER_PATH =
+    "\\\\?\\usb#vid_045e&pid_02fe#5&2f3e4d&0&3#{a5dcbf10-6530-11d2-901f-00c04fb951ed}";
+static const char *const MS_HUB_PATH =
+    "\\\\?\\USB#VID_045E&PID_07C6#6&3b4c5d&0&1#{f18a0e88-c30c-11d0-8815-00a0c906bed8}";
+static const char *const OTHER_PATH =
+    "\\\\?\\USB#VID_046D&PID_C52B#5&1a2b3c&0&2#{a5dcbf10-6530-11d2-901f-00c04fb951ed}";
+
+struct Storm {
+    const char *name;
+    int         events;
+    uint64_t    gap_ns;
+    bool        present;        /* a controller is connected throughout */
+    int         controller_at;  /* index of a controller arrival, or -1 */
+    bool        other_only;
+};
+
+struct StormResult {
+    HotplugStats stats;
+    uint64_t     span_ns;
+    uint64_t     discover_delay_ns;   /* controller arrival to DISCOVER */
+    double       ns_per_event;
+};
+
+static StormResult Run(const Storm &s)
+{
+    HotplugTracker t;
+    t.SetControllerPresent(s.present);
+    std::mt19937 rng(1);
+    const char *vague[] = { OTHER_PATH, MS_HUB_PATH, nullptr };
+    uint64_t start = 1000 * MS, now = start, controller_ns = 0;
+    StormResult r = {};
+    r.discover_delay_ns = UINT64_MAX;
+
+    clock_t cpu0 = clock();
+    for (int i = 0; i < s.events; i++) {
+        const char *path = i == s.controller_at ? SERIES_PATH
+                         : s.other_only        ? OTHER_PATH
+                                               : vague[rng() % 3];
+        HotplugSource src = HotplugTracker::Classify(path);
+        if (i == s.controller_at) {
+            controller_ns = now;
+            t.Arrival(src, now);
+        } else if (rng() & 1) {
+            t.Removal(src, now);
+        } else {
+            t.Arrival(src, now);
+        }
+        uint64_t arrival = 0;
+        if ((t.Poll(now, &arrival) & HOTPLUG_DISCOVER) && controller_ns && arrival == controller_ns)
+            r.discover_delay_ns = now - controller_ns;
+        now += s.gap_ns;
+    }
+    while (uint64_t due = t.Deadline()) {
+        now = due;
+        uint64_t arrival = 0;
+        t.Poll(now, &arrival);
+    }
+    r.ns_per_event = (double)(clock() - cpu0) / CLOCKS_PER_SEC * 1e9 / s.events;
+    r.span_ns = now - start;
+    r.stats = t.Stats();
+    return r;
+}
+
+int main()
+{
+    CHECK(HotplugTracker::Classify(GIP_PATH) == HOTPLUG_CONTROLLER);
+    CHECK(HotplugTracker::Classify(SERIES_PATH) == HOTPLUG_CONTROLLER);
+    CHECK(HotplugTracker::Classify(ADAPTER_PATH) == HOTPLUG_CONTROLLER);
+    CHECK(HotplugTracker::Classify(MS_HUB_PATH) == HOTPLUG_VENDOR);
+    CHECK(HotplugTracker::Classify(OTHER_PATH) == HOTPLUG_OTHER);
+    CHECK(HotplugTracker::Classify(nullptr) == HOTPLUG_UNKNOWN);
+    CHECK(HotplugTracker::Classify("") == HOTPLUG_UNKNOWN);
+
+    const Storm storms[] = {
+        { "dock replug, no controller", 5000, 1 * MS, false, -1, false },
+        { "hub flood, controller connected", 100000, MS / 20, true, -1, false },
+        { "controller plugged in mid-storm", 5000, MS / 2, false, 2500, false },
+        { "other vendors only", 100000, MS / 20, true, -1, true },
+    };
+    for (const Storm &s : storms) {
+        StormResult r = Run(s);
+        const HotplugStats &st = r.stats;
+        /* Every action covers at least max_delay of storm, bar the
+           immediate one for a controller. */
+        uint64_t bound = r.span_ns / HotplugTracker::DEFAULT_MAX_DELAY_NS + 1 + (s.controller_at >= 0);
+        printf("%s: %llu events over %.1f s -> %llu discovers, %llu rescans "
+               "(%llu filtered, %llu coalesced), %.0f ns CPU per event\n",
+               s.name, (unsigned long long)st.events, r.span_ns / 1e9,
+               (unsigned long long)st.discovers, (unsigned long long)st.rescans,
+               (unsigned long long)st.filtered, (unsigned long long)st.coalesced, r.ns_per_event);
+
+        CHECK(st.events == (uint64_t)s.events);
+        CHECK(st.discovers + st.rescans <= bound);
+        if (s.present)
+            CHECK(st.discovers == 0);   /* the open session sees new controllers itself */
+        else
+            CHECK(st.rescans == 0);     /* nothing to lose */
+        if (s.other_only)
+            CHECK(st.discovers + st.rescans == 0 && st.filtered == st.events);
+        if (s.controller_at >= 0)
+            CHECK(r.discover_delay_ns == 0);
+        /* Gross bound only: Classify is a few short string scans. */
+        CHECK(r.ns_per_event < 20000);
+    }
+    return TestExit();
+}
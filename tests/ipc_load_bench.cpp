@@ -0,0 +1,214 @@
+/*
+ * The daemon's IPC server under load: a LedService on a loopback driver
+ * with four controllers, many clients pipelining SET_LED requests over the
+ * local socket while one more client subscribes to LED events. Reports
+ * commands per second and reply latency. A second run stalls the writes
+ * so one client's burst overruns LedService::MAX_PENDING, which must come
+ * back as IPC_ERR_BUSY rather than queue without bound.
+ */
+#include "gip_loopback.h"
+#include "ipc_server.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+static const uint64_t DEVICE_BASE = 0x7E5700000001ull;
+static const int      DEVICES = 4;
+static const int      CLIENTS = 16;
+static const int      PER_CLIENT = 400;
+static const int      WINDOW = 8;      /* requests in flight per client */
+
+#pragma pack(push, 1)
+struct SetLedMsg {
+    IpcHeader hdr;
+    IpcSetLed set;
+    uint64_t  device;
+};
+
+struct SubscribeMsg {
+    IpcHeader    hdr;
+    IpcSubscribe sub;
+};
+#pragma pack(pop)
+
+static SetLedMsg SetLed(uint32_t id, uint64_t device, uint8_t brightness)
+{
+    SetLedMsg m = {};
+    m.hdr.length = sizeof(m);
+    m.hdr.id = id;
+    m.hdr.op = IPC_OP_SET_LED;
+    m.set.mode = LED_MODE_ON;
+    m.set.brightness = brightness;
+    m.set.count = 1;
+    m.device = device;
+    return m;
+}
+
+/* Reads one reply; false on a broken connection. */
+static bool ReadReply(IpcChannel *ch, IpcHeader *hdr)
+{
+    uint8_t body[IPC_MAX_MESSAGE];
+    if (!ch->Read(hdr, sizeof(*hdr)) || hdr->length < sizeof(*hdr) || hdr->length > IPC_MAX_MESSAGE)
+        return false;
+    return hdr->length == sizeof(*hdr) || ch->Read(body, hdr->length - sizeof(*hdr));
+}
+
+static GipTransport Loopback(uint32_t write_latency_us)
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = write_latency_us;
+    GipTransport t = gip_loopback_create(&cfg);
+    for (int i = 0; i < DEVICES; i++)
+        gip_loopback_add_device(t, DEVICE_BASE + (uint64_t)i);
+    return t;
+}
+
+static void Load(const std::string &name)
+{
+    LedService service(Loopback(100));
+    IpcServer server(&service);
+    std::string err;
+    CHECK(server.Start(name, &err));
+    service.Start();
+    /* Let the controllers announce. */
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    IpcChannel *sub = IpcConnect(name.c_str(), &err);
+    CHECK(sub != nullptr);
+    if (!sub)
+        return;
+    SubscribeMsg subscribe = { { sizeof(SubscribeMsg), 1, IPC_OP_SUBSCRIBE, 0 }, { IPC_EVENT_LED } };
+    CHECK(sub->Write(&subscribe, sizeof(subscribe)));
+    IpcHeader hdr;
+    CHECK(ReadReply(sub, &hdr) && hdr.id == 1 && hdr.status == IPC_OK);
+    int events = 0;
+    std::thread subscriber([&] {
+        IpcHeader ev;
+        while (ReadReply(sub, &ev))
+            events += ev.op == IPC_OP_EVENT;
+    });
+
+    std::mutex mu;
+    std::vector<double> latency_us;
+    int errors = 0;
+    uint64_t start = xbox_time_ns();
+    std::vector<std::thread> clients;
+    for (int ci = 0; ci < CLIENTS; ci++) {
+        clients.emplace_back([&, ci] {
+            std::string cerr;
+            IpcChannel *ch = IpcConnect(name.c_str(), &cerr);
+            if (!ch) {
+                std::lock_guard<std::mutex> lock(mu);
+                errors++;
+                return;
+            }
+            std::vector<uint64_t> sent(PER_CLIENT + 1);
+            std::vector<double> mine;
+            int failed = 0, next = 0, done = 0;
+            while (done < PER_CLIENT) {
+                std::vector<SetLedMsg> burst;
+                while (next < PER_CLIENT && next - done < WINDOW) {
+                    next++;
+                    burst.push_back(SetLed((uint32_t)next, DEVICE_BASE + (uint64_t)((ci + next) % DEVICES),
+                                           (uint8_t)(next % (LED_BRIGHTNESS_MAX + 1))));
+                    sent[next] = xbox_time_ns();
+                }
+                if (!burst.empty() && !ch->Write(burst.data(), burst.size() * sizeof(SetLedMsg))) {
+                    failed++;
+                    break;
+                }
+                IpcHeader reply;
+                if (!ReadReply(ch, &reply) || reply.id == 0 || reply.id > (uint32_t)PER_CLIENT) {
+                    failed++;
+                    break;
+                }
+                failed += reply.status != IPC_OK;
+                mine.push_back((xbox_time_ns() - sent[reply.id]) / 1e3);
+                done++;
+            }
+            delete ch;
+            std::lock_guard<std::mutex> lock(mu);
+            errors += failed;
+            latency_us.insert(latency_us.end(), mine.begin(), mine.end());
+        });
+    }
+    for (std::thread &t : clients)
+        t.join();
+    double s = (xbox_time_ns() - start) / 1e9;
+
+    LedServiceStats ls = service.Stats();
+    size_t total = latency_us.size();
+    double p50 = Percentile(latency_us, 50), p99 = Percentile(latency_us, 99);
+    printf("%d clients x %d requests, %d in flight each: %.0f cmd/s, p50 %.0f us, p99 %.0f us; "
+           "%llu batches, %llu writes, %d LED events\n",
+           CLIENTS, PER_CLIENT, WINDOW, total / s, p50, p99, (unsigned long long)ls.batches,
+           (unsigned long long)ls.writes, events);
+
+    CHECK(errors == 0);
+    CHECK(total == (size_t)CLIENTS * PER_CLIENT);
+    CHECK(ls.rejected == 0);
+    CHECK(ls.batches < total);   /* requests queued during a write share the next one */
+    CHECK(events > 0);
+
+    sub->Shutdown();
+    subscriber.join();
+    delete sub;
+    server.Stop();
+    service.Stop();
+}
+
+/* Writes take 100 ms, so one burst of requests piles up in the service. */
+static void Overload(const std::string &name)
+{
+    LedService service(Loopback(100000));
+    IpcServer server(&service);
+    std::string err;
+    CHECK(server.Start(name, &err));
+    service.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    IpcChannel *ch = IpcConnect(name.c_str(), &err);
+    CHECK(ch != nullptr);
+    if (!ch)
+        return;
+    const int burst = (int)LedService::MAX_PENDING * 2;
+    std::vector<SetLedMsg> msgs;
+    for (int i = 1; i <= burst; i++)
+        msgs.push_back(SetLed((uint32_t)i, DEVICE_BASE, (uint8_t)(i % (LED_BRIGHTNESS_MAX + 1))));
+    CHECK(ch->Write(msgs.data(), msgs.size() * sizeof(SetLedMsg)));
+    int ok = 0, busy = 0, other = 0;
+    for (int i = 0; i < burst; i++) {
+        IpcHeader reply;
+        if (!ReadReply(ch, &reply)) {
+            other++;
+            break;
+        }
+        ok += reply.status == IPC_OK;
+        busy += reply.status == IPC_ERR_BUSY;
+        other += reply.status != IPC_OK && reply.status != IPC_ERR_BUSY;
+    }
+    LedServiceStats ls = service.Stats();
+    printf("burst of %d with writes stalled: %d ok, %d busy, %llu rejected by the service\n",
+           burst, ok, busy, (unsigned long long)ls.rejected);
+    CHECK(other == 0);
+    CHECK(busy > 0);
+    CHECK(ok + busy == burst);
+    CHECK(ls.rejected == (uint64_t)busy);
+
+    delete ch;
+    server.Stop();
+    service.Stop();
+}
+
+int main()
+{
+    std::string name = "/tmp/xbled-ipc-test-" + std::to_string(getpid()) + ".sock";
+    Load(name);
+    Overload(name);
+    unlink(name.c_str());
+    return TestExit();
+}
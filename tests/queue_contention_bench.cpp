@@ -0,0 +1,164 @@
+/*
+ * Worker channel under contention from 1 to 8 producer threads. The bare
+ * ring must hand every value to the consumer once, in each producer's
+ * order. Through CommandQueue, each producer streams previews and committed
+ * applies for its own device: committed values must reach the worker in
+ * order, none may be refused, and each device must end on the last value
+ * its producer posted. Close() must reach a waiting worker promptly.
+ * Reports posts per second for both.
+ */
+#include "command_queue.h"
+#include "test_util.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+static const int RING_PER_PRODUCER = 200000;
+static const int QUEUE_PER_PRODUCER = 100000;
+static const int COMMIT_EVERY = 8;   /* the rest are previews */
+
+static double RingRun(int producers)
+{
+    MpscRing<uint64_t, 256> ring;
+    std::vector<std::thread> threads;
+    uint64_t start = xbox_time_ns();
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&ring, p] {
+            for (uint64_t i = 1; i <= (uint64_t)RING_PER_PRODUCER; i++) {
+                while (!ring.Push(((uint64_t)p << 32) | i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<uint64_t> last(producers, 0);
+    uint64_t total = (uint64_t)producers * RING_PER_PRODUCER, taken = 0;
+    bool ordered = true;
+    while (taken < total) {
+        uint64_t v;
+        if (!ring.Pop(&v)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = (int)(v >> 32);
+        uint64_t seq = v & 0xFFFFFFFFull;
+        ordered = ordered && p < producers && seq == last[p] + 1;
+        if (p < producers)
+            last[p] = seq;
+        taken++;
+    }
+    double s = (xbox_time_ns() - start) / 1e9;
+    for (std::thread &t : threads)
+        t.join();
+    CHECK(ordered);
+    return total / s / 1e6;
+}
+
+static double QueueRun(int producers, CommandQueueStats *stats)
+{
+    std::mutex mu;
+    std::condition_variable cv;
+    bool woken = false;
+    CommandQueue queue([&] {
+        std::lock_guard<std::mutex> lock(mu);
+        woken = true;
+        cv.notify_one();
+    });
+
+    std::atomic<int> done{0};
+    std::atomic<int> refused{0};
+    std::vector<std::thread> threads;
+    uint64_t start = xbox_time_ns();
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (int i = 1; i <= QUEUE_PER_PRODUCER; i++) {
+                WorkerCommand c = {};
+                c.type = CMD_APPLY;
+                c.device_id = (uint64_t)p;
+                c.brightness = i;
+                c.preview = i % COMMIT_EVERY != 0 && i != QUEUE_PER_PRODUCER;
+                if (!queue.Post(c) && !c.preview)
+                    refused++;
+            }
+            done++;
+        });
+    }
+
+    std::vector<int> last(producers, 0);
+    bool ordered = true;
+    for (;;) {
+        bool finished = done.load() == producers;
+        WorkerCommand c;
+        while (queue.Take(&c)) {
+            if (c.preview)
+                continue;
+            int p = (int)c.device_id;
+            ordered = ordered && c.brightness > last[p];
+            last[p] = c.brightness;
+        }
+        if (finished)
+            break;
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait_for(lock, std::chrono::milliseconds(1), [&] { return woken; });
+        woken = false;
+    }
+    double s = (xbox_time_ns() - start) / 1e9;
+    for (std::thread &t : threads)
+        t.join();
+
+    CHECK(ordered);
+    CHECK(refused == 0);
+    CHECK(!queue.Busy());
+    for (int p = 0; p < producers; p++)
+        CHECK(last[p] == QUEUE_PER_PRODUCER);
+    *stats = queue.Stats();
+    return (double)producers * QUEUE_PER_PRODUCER / s / 1e6;
+}
+
+/* From Close() on another thread to the worker seeing Closed(). */
+static double CloseLatencyMs()
+{
+    std::mutex mu;
+    std::condition_variable cv;
+    bool woken = false;
+    CommandQueue queue([&] {
+        std::lock_guard<std::mutex> lock(mu);
+        woken = true;
+        cv.notify_one();
+    });
+    std::atomic<uint64_t> closed_at{0};
+    std::thread worker([&] {
+        while (!queue.Closed()) {
+            std::unique_lock<std::mutex> lock(mu);
+            cv.wait(lock, [&] { return woken; });
+            woken = false;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    closed_at = xbox_time_ns();
+    queue.Close();
+    worker.join();
+    return (xbox_time_ns() - closed_at) / 1e6;
+}
+
+int main()
+{
+    for (int producers : { 1, 2, 4, 8 }) {
+        CommandQueueStats qs;
+        double ring = RingRun(producers);
+        double queue = QueueRun(producers, &qs);
+        printf("%d producer(s): ring %.1f M pushes/s; queue %.1f M posts/s, %llu executed, "
+               "%llu coalesced, %llu previews dropped, %llu overflowed\n",
+               producers, ring, queue, (unsigned long long)qs.executed,
+               (unsigned long long)qs.coalesced, (unsigned long long)qs.dropped,
+               (unsigned long long)qs.overflowed);
+    }
+    double close_ms = CloseLatencyMs();
+    printf("Close() to worker exit: %.3f ms\n", close_ms);
+    CHECK(close_ms < 50);
+    return TestExit();
+}
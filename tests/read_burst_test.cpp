@@ -0,0 +1,176 @@
+/*
+ * Bursts injected into a loopback driver whose inbound backlog is capped,
+ * as the real driver drops frames nobody is reading. Every frame that the
+ * posted reads plus the backlog could hold must come through, so a deeper
+ * read ring loses fewer, and the drops must be seen by the engine; a hub
+ * with more controllers than that announcing at once must all be found,
+ * the lost ones through the reenumerate the drops set off; steady input
+ * must come through whole while the worker reads; and several messages
+ * packed into one read must all be parsed.
+ */
+#include "gip_loopback.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+#include "gip_protocol.h"
+#include "xbox_led.h"
+}
+
+static const uint64_t DEVICE = 0x7E5700000001ull;
+static const uint32_t INBOUND_LIMIT = 8;
+static const uint32_t BURST = 200;
+
+static std::vector<uint8_t> Frame(uint64_t device_id, uint8_t cmd, uint32_t payload_len)
+{
+    std::vector<uint8_t> f(sizeof(GipHeader) + payload_len);
+    GipHeader h = {};
+    h.deviceId = device_id;
+    h.commandId = cmd;
+    h.length = payload_len;
+    memcpy(f.data(), &h, sizeof(h));
+    return f;
+}
+
+/* Until a pump completes no read and sends no reenumerate. */
+static void PumpIdle(XboxController *ctrl)
+{
+    uint64_t completed, recoveries;
+    do {
+        completed = ctrl->read_stats.completed;
+        recoveries = ctrl->read_stats.recoveries;
+        xbox_pump(ctrl, 20);
+    } while (ctrl->read_stats.completed != completed ||
+             ctrl->read_stats.recoveries != recoveries);
+}
+
+/* Messages received out of a burst the worker was too busy to read. */
+static void InputBurst(int depth)
+{
+    GipLoopbackConfig cfg = {};
+    cfg.inbound_limit = INBOUND_LIMIT;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, DEVICE);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+    xbox_set_read_depth(&ctrl, depth);
+    CHECK(xbox_open(&ctrl));
+    PumpIdle(&ctrl);
+
+    uint64_t before = ctrl.read_stats.messages;
+    GipLoopbackStats ls0;
+    gip_loopback_stats(t, &ls0);
+    std::vector<uint8_t> input = Frame(DEVICE, GIP_CMD_INPUT, 14);
+    CHECK(gip_loopback_inject_burst(t, input.data(), (uint32_t)input.size(), BURST));
+    PumpIdle(&ctrl);
+
+    GipLoopbackStats ls;
+    gip_loopback_stats(t, &ls);
+    /* Each reenumerate the drops set off brings one more announce. */
+    uint64_t received = ctrl.read_stats.messages - before - ctrl.read_stats.recoveries;
+    uint64_t dropped = ls.dropped_frames - ls0.dropped_frames;
+    printf("read depth %d: %llu of %u received, %llu dropped by the driver, %llu overruns\n",
+           depth, (unsigned long long)received, BURST, (unsigned long long)dropped,
+           (unsigned long long)ctrl.read_stats.overruns);
+    CHECK(received + dropped == BURST);
+    CHECK(received == (uint64_t)depth + INBOUND_LIMIT);
+    CHECK(ctrl.read_stats.dropped == dropped);
+    CHECK(ctrl.read_stats.recoveries == 1);
+    CHECK(ctrl.read_stats.overruns == 0);
+    xbox_cleanup(&ctrl);
+}
+
+int main()
+{
+    InputBurst(1);
+    InputBurst(XBOX_READ_DEPTH_DEFAULT);
+    InputBurst(XBOX_READ_DEPTH_MAX);
+
+    /* A hub reset: more controllers than the default ring and the backlog
+       hold announce in the same instant. */
+    {
+        GipLoopbackConfig cfg = {};
+        cfg.inbound_limit = INBOUND_LIMIT;
+        GipTransport t = gip_loopback_create(&cfg);
+        gip_loopback_add_device(t, DEVICE);
+        XboxController ctrl;
+        xbox_init_with_transport(&ctrl, t);
+        CHECK(xbox_open(&ctrl));
+        PumpIdle(&ctrl);
+        const int hub = XBOX_MAX_DEVICES;
+        CHECK(hub > XBOX_READ_DEPTH_DEFAULT + (int)INBOUND_LIMIT);
+        for (int i = 1; i < hub; i++)
+            gip_loopback_add_device(t, DEVICE + (uint64_t)i);
+        PumpIdle(&ctrl);
+        GipLoopbackStats ls;
+        gip_loopback_stats(t, &ls);
+        printf("hub of %d: %llu announces dropped, %d present after %llu reenumerates\n", hub,
+               (unsigned long long)ls.dropped_frames, xbox_device_count(&ctrl),
+               (unsigned long long)ctrl.read_stats.recoveries);
+        CHECK(ls.dropped_frames > 0);
+        CHECK(ctrl.read_stats.dropped == ls.dropped_frames);
+        CHECK(ctrl.read_stats.recoveries > 0);
+        CHECK(xbox_device_count(&ctrl) == hub);
+        xbox_cleanup(&ctrl);
+    }
+
+    /* Input at 2 kHz while the worker keeps reading: nothing may drop. */
+    {
+        GipLoopbackConfig cfg = {};
+        cfg.inbound_limit = INBOUND_LIMIT;
+        GipTransport t = gip_loopback_create(&cfg);
+        gip_loopback_add_device(t, DEVICE);
+        XboxController ctrl;
+        xbox_init_with_transport(&ctrl, t);
+        CHECK(xbox_open(&ctrl));
+        PumpIdle(&ctrl);
+        uint64_t before = ctrl.read_stats.messages;
+        std::vector<uint8_t> input = Frame(DEVICE, GIP_CMD_INPUT, 14);
+        const int reports = 400;
+        std::thread feeder([&] {
+            for (int i = 0; i < reports; i++) {
+                gip_loopback_inject(t, input.data(), (uint32_t)input.size());
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        });
+        uint64_t until = xbox_time_ns() + 5000000000ull;
+        while (ctrl.read_stats.messages - before < (uint64_t)reports && xbox_time_ns() < until)
+            xbox_pump(&ctrl, 20);
+        feeder.join();
+        GipLoopbackStats ls;
+        gip_loopback_stats(t, &ls);
+        printf("%d reports at 2 kHz: %llu received, %llu dropped\n", reports,
+               (unsigned long long)(ctrl.read_stats.messages - before),
+               (unsigned long long)ls.dropped_frames);
+        CHECK(ctrl.read_stats.messages - before == (uint64_t)reports);
+        CHECK(ls.dropped_frames == 0);
+        xbox_cleanup(&ctrl);
+    }
+
+    /* Several messages in one read. */
+    {
+        GipLoopbackConfig cfg = {};
+        GipTransport t = gip_loopback_create(&cfg);
+        gip_loopback_add_device(t, DEVICE);
+        XboxController ctrl;
+        xbox_init_with_transport(&ctrl, t);
+        CHECK(xbox_open(&ctrl));
+        PumpIdle(&ctrl);
+        std::vector<uint8_t> packed;
+        for (int i = 0; i < 3; i++) {
+            std::vector<uint8_t> f = Frame(DEVICE, GIP_CMD_INPUT, 14);
+            packed.insert(packed.end(), f.begin(), f.end());
+        }
+        uint64_t before = ctrl.read_stats.messages;
+        uint64_t completed = ctrl.read_stats.completed;
+        CHECK(gip_loopback_inject(t, packed.data(), (uint32_t)packed.size()));
+        PumpIdle(&ctrl);
+        CHECK(ctrl.read_stats.completed == completed + 1);
+        CHECK(ctrl.read_stats.messages == before + 3);
+        xbox_cleanup(&ctrl);
+    }
+    return TestExit();
+}
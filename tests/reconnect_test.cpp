@@ -0,0 +1,209 @@
+/*
+ * A hub reset through LedService on a loopback driver: sixteen controllers
+ * with their own LED values drop off and announce again at once. Every
+ * controller must get its own value back, the most recently active one
+ * first, and a wider concurrency limit must finish the storm sooner.
+ * Reports the storm time and the time-to-apply histogram. Also covers a
+ * controller replugged while a write to another one is in flight, and a
+ * request naming more ids than one broadcast holds.
+ */
+#include "gip_loopback.h"
+#include "led_service.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static const uint64_t DEVICE_BASE = 0xABC000;
+static const int      DEVICES = 16;
+
+static int Present(LedService &s)
+{
+    int n = 0;
+    for (const LedDeviceState &d : s.Snapshot())
+        n += d.present;
+    return n;
+}
+
+static bool WaitPresent(LedService &s, int count)
+{
+    uint64_t until = xbox_time_ns() + 5000000000ull;
+    while (Present(s) != count && xbox_time_ns() < until)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return Present(s) == count;
+}
+
+static void Set(LedService &s, uint64_t id, uint8_t mode, uint8_t brightness)
+{
+    std::mutex mu;
+    std::condition_variable cv;
+    bool done = false;
+    LedRequest r;
+    r.devices = { id };
+    r.mode = mode;
+    r.brightness = brightness;
+    r.done = [&](int, int) {
+        std::lock_guard<std::mutex> lock(mu);
+        done = true;
+        cv.notify_one();
+    };
+    CHECK(s.Submit(std::move(r)));
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [&] { return done; });
+}
+
+/* Returns the storm time in ms. */
+static double Storm(int concurrency)
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = 4000;
+    cfg.read_latency_us = 200;
+    GipTransport t = gip_loopback_create(&cfg);
+    for (int i = 0; i < DEVICES; i++)
+        gip_loopback_add_device(t, DEVICE_BASE + (uint64_t)i);
+    LedService s(t);
+    s.SetReconnectConcurrency(concurrency);
+    int sub = s.Bus().Subscribe(BUS_MASK(BUS_HOTPLUG), nullptr);
+    s.Start();
+    CHECK(WaitPresent(s, DEVICES));
+
+    /* Written in order, so the last controller is the most recently active. */
+    for (int i = 0; i < DEVICES; i++)
+        Set(s, DEVICE_BASE + (uint64_t)i, LED_MODE_BLINK_SLOW, (uint8_t)(i + 2));
+    for (int i = 0; i < DEVICES; i++)
+        gip_loopback_remove_device(t, DEVICE_BASE + (uint64_t)i);
+    CHECK(WaitPresent(s, 0));
+
+    BusEvent ev;
+    while (s.Bus().Poll(sub, &ev)) {
+    }
+    for (int i = 0; i < DEVICES; i++)
+        gip_loopback_add_device(t, DEVICE_BASE + (uint64_t)i);
+    std::vector<int> order;
+    uint64_t until = xbox_time_ns() + 5000000000ull;
+    while ((int)order.size() < DEVICES && xbox_time_ns() < until) {
+        if (s.Bus().Poll(sub, &ev))
+            order.push_back((int)(ev.device_id - DEVICE_BASE));
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    int wrong = 0;
+    for (int i = 0; i < DEVICES; i++) {
+        uint8_t mode = 0, brightness = 0;
+        gip_loopback_led_state(t, DEVICE_BASE + (uint64_t)i, &mode, &brightness);
+        wrong += mode != LED_MODE_BLINK_SLOW || brightness != i + 2;
+    }
+    s.Stop();
+    ReconnectStats rs = s.Stats().reconnect;
+
+    printf("concurrency %2d: storm %.1f ms, %llu applied, %d wrong; first %d; apply times:",
+           concurrency, rs.last_storm_ns / 1e6, (unsigned long long)rs.applied, wrong,
+           order.empty() ? -1 : order[0]);
+    uint32_t histogram = 0;
+    for (int b = 0; b < RECONNECT_HIST_BUCKETS; b++) {
+        histogram += rs.apply_hist[b];
+        if (rs.apply_hist[b])
+            printf(" <%ums: %u", 1u << b, rs.apply_hist[b]);
+    }
+    printf("\n");
+
+    CHECK((int)order.size() == DEVICES);
+    CHECK(wrong == 0);
+    CHECK(rs.applied == (uint64_t)DEVICES);
+    CHECK(rs.failed == 0);
+    CHECK(histogram == (uint32_t)DEVICES);
+    CHECK(rs.last_storm_devices == (uint32_t)DEVICES);
+    CHECK(!order.empty() && order[0] >= DEVICES - concurrency);
+    return rs.last_storm_ns / 1e6;
+}
+
+/* A controller goes and comes back within one pump, during a slow write
+   to another controller: it must still get its value back. */
+static void QuickReplug()
+{
+    GipLoopbackConfig cfg = {};
+    cfg.write_latency_us = 20000;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, DEVICE_BASE);
+    gip_loopback_add_device(t, DEVICE_BASE + 1);
+    LedService s(t);
+    s.Start();
+    CHECK(WaitPresent(s, 2));
+    Set(s, DEVICE_BASE, LED_MODE_ON, 40);
+
+    LedRequest r;
+    r.devices = { DEVICE_BASE + 1 };
+    r.mode = LED_MODE_ON;
+    r.brightness = 5;
+    CHECK(s.Submit(std::move(r)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    gip_loopback_remove_device(t, DEVICE_BASE);
+    gip_loopback_add_device(t, DEVICE_BASE);
+
+    uint8_t mode = 0, brightness = 0;
+    uint64_t until = xbox_time_ns() + 2000000000ull;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        gip_loopback_led_state(t, DEVICE_BASE, &mode, &brightness);
+    } while (brightness != 40 && xbox_time_ns() < until);
+    s.Stop();
+    printf("replugged during a write: mode %u brightness %u\n", mode, brightness);
+    CHECK(mode == LED_MODE_ON && brightness == 40);
+}
+
+/* An unknown id ahead of a full hub must not push a controller out. */
+static void LongTargetList()
+{
+    GipLoopbackConfig cfg = {};
+    GipTransport t = gip_loopback_create(&cfg);
+    for (int i = 0; i < DEVICES; i++)
+        gip_loopback_add_device(t, DEVICE_BASE + (uint64_t)i);
+    LedService s(t);
+    s.Start();
+    CHECK(WaitPresent(s, DEVICES));
+
+    std::mutex mu;
+    std::condition_variable cv;
+    int applied = -2, failed = -2;
+    LedRequest r;
+    r.devices.push_back(DEVICE_BASE - 1);
+    for (int i = 0; i < DEVICES; i++)
+        r.devices.push_back(DEVICE_BASE + (uint64_t)i);
+    r.mode = LED_MODE_ON;
+    r.brightness = 33;
+    r.done = [&](int a, int f) {
+        std::lock_guard<std::mutex> lock(mu);
+        applied = a;
+        failed = f;
+        cv.notify_one();
+    };
+    CHECK(s.Submit(std::move(r)));
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&] { return applied != -2; });
+    }
+    int wrong = 0;
+    for (int i = 0; i < DEVICES; i++) {
+        uint8_t mode = 0, brightness = 0;
+        gip_loopback_led_state(t, DEVICE_BASE + (uint64_t)i, &mode, &brightness);
+        wrong += brightness != 33;
+    }
+    s.Stop();
+    printf("%d ids: %d applied, %d failed, %d wrong\n", DEVICES + 1, applied, failed, wrong);
+    CHECK(applied == DEVICES);
+    CHECK(failed == 1);
+    CHECK(wrong == 0);
+}
+
+int main()
+{
+    double serial = Storm(1);
+    double wide = Storm(ReconnectScheduler::DEFAULT_CONCURRENCY);
+    CHECK(wide < serial);
+    QuickReplug();
+    LongTargetList();
+    return TestExit();
+}
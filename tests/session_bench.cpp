@@ -0,0 +1,50 @@
+/*
+ * Time per LED command when every command opens the session, enumerates
+ * and closes again, against one session kept open, both over a loopback
+ * driver that answers the enumeration after a realistic delay.
+ */
+#include "gip_loopback.h"
+#include "test_util.h"
+
+extern "C" {
+#include "xbox_led.h"
+}
+
+static const uint32_t ANNOUNCE_US = 2000;
+static const uint32_t WRITE_US = 200;
+static const int      COMMANDS = 50;
+
+static double MeanMs(bool keep_open)
+{
+    GipLoopbackConfig cfg = {};
+    cfg.announce_latency_us = ANNOUNCE_US;
+    cfg.write_latency_us = WRITE_US;
+    GipTransport t = gip_loopback_create(&cfg);
+    gip_loopback_add_device(t, 0x7E5700000001ull);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+
+    uint64_t start = xbox_time_ns();
+    for (int i = 0; i < COMMANDS; i++) {
+        CHECK(xbox_open(&ctrl));
+        /* A new value each time, so no write is suppressed. */
+        CHECK(xbox_set_led(&ctrl, LED_MODE_ON, (uint8_t)(i % LED_BRIGHTNESS_MAX)));
+        if (!keep_open)
+            xbox_close(&ctrl);
+    }
+    double ms = (xbox_time_ns() - start) / 1e6 / COMMANDS;
+    xbox_cleanup(&ctrl);
+    return ms;
+}
+
+int main()
+{
+    double reopen = MeanMs(false);
+    double kept = MeanMs(true);
+    printf("per command: reopen + enumerate %.3f ms, persistent session %.3f ms (%.1fx)\n",
+           reopen, kept, kept > 0 ? reopen / kept : 0.0);
+    /* Reopening waits for the announce every time; a kept session never does. */
+    CHECK(kept < reopen);
+    CHECK(reopen >= ANNOUNCE_US / 1000.0);
+    return TestExit();
+}
@@ -0,0 +1,153 @@
+/*
+ * Shared-memory status page under a writer that never stops: every update
+ * gives all sixteen devices the same brightness, with the device ids
+ * derived from it, so a snapshot that mixes two updates shows up as soon
+ * as two entries disagree. Readers run as threads and as a second process
+ * mapping the page by name; none may see a torn snapshot. Reports
+ * snapshots per second per reader.
+ */
+#include "status_page.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+static const int    READERS = 4;
+static const double RUN_S = 0.4;
+static const uint64_t DEVICE_BASE = 0x7E57000000000000ull;
+
+/* Fails the snapshot if it mixes two updates. */
+static bool Consistent(const StatusSnapshot &s)
+{
+    if (s.count != STATUS_MAX_DEVICES)
+        return false;
+    for (uint32_t i = 0; i < s.count; i++) {
+        const StatusDevice &d = s.devices[i];
+        if (d.brightness != s.devices[0].brightness || d.mode != s.devices[0].mode ||
+            d.device_id != DEVICE_BASE + ((uint64_t)d.brightness << 8) + i)
+            return false;
+    }
+    return true;
+}
+
+struct ReaderResult {
+    uint64_t snapshots;
+    uint64_t failed;
+    uint64_t torn;
+};
+
+static ReaderResult Read(const std::string &name, double seconds)
+{
+    ReaderResult r = {};
+    StatusReader reader;
+    std::string err;
+    if (!reader.Open(name.c_str(), &err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        r.failed = 1;
+        return r;
+    }
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    StatusSnapshot snap;
+    while (std::chrono::steady_clock::now() < end) {
+        for (int k = 0; k < 256; k++) {
+            if (!reader.Snapshot(&snap)) {
+                r.failed++;
+                continue;
+            }
+            r.snapshots++;
+            r.torn += !Consistent(snap);
+        }
+    }
+    return r;
+}
+
+int main()
+{
+    std::string name = "/xbled-status-test-" + std::to_string(getpid());
+    StatusPublisher pub;
+    std::string err;
+    if (!pub.Create(name.c_str(), &err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+    StatusDevice devices[STATUS_MAX_DEVICES] = {};
+    auto fill = [&devices](uint8_t level) {
+        for (int i = 0; i < STATUS_MAX_DEVICES; i++) {
+            devices[i].device_id = DEVICE_BASE + ((uint64_t)level << 8) + (uint64_t)i;
+            devices[i].present = 1;
+            devices[i].mode = (uint8_t)(level & 1 ? 1 : 3);
+            devices[i].brightness = level;
+        }
+    };
+    fill(0);
+    pub.Publish(devices, STATUS_MAX_DEVICES);
+
+    /* An unchanged table is not republished. */
+    {
+        StatusReader reader;
+        StatusSnapshot a, b;
+        CHECK(reader.Open(name.c_str(), &err));
+        CHECK(reader.Snapshot(&a));
+        pub.Publish(devices, STATUS_MAX_DEVICES);
+        CHECK(reader.Snapshot(&b));
+        CHECK(a.generation == b.generation);
+        CHECK(a.writer_pid == (uint32_t)getpid());
+        CHECK(Consistent(a));
+    }
+
+    /* Forked before any thread starts. */
+    pid_t child = fork();
+    if (child == 0) {
+        ReaderResult r = Read(name, RUN_S);
+        printf("reader process: %.2f M snapshots/s, %llu failed, %llu torn\n",
+               r.snapshots / RUN_S / 1e6, (unsigned long long)r.failed,
+               (unsigned long long)r.torn);
+        fflush(stdout);
+        _exit(r.torn || !r.snapshots ? 1 : 0);
+    }
+
+    std::atomic<bool> stop{false};
+    uint64_t updates = 0;
+    std::thread writer([&] {
+        uint8_t level = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            level = (uint8_t)((level + 1) % 48);
+            fill(level);
+            pub.Publish(devices, STATUS_MAX_DEVICES);
+            updates++;
+        }
+    });
+
+    ReaderResult results[READERS];
+    std::vector<std::thread> readers;
+    for (int i = 0; i < READERS; i++)
+        readers.emplace_back([&, i] { results[i] = Read(name, RUN_S); });
+    for (std::thread &t : readers)
+        t.join();
+    stop = true;
+    writer.join();
+
+    int status = 0;
+    CHECK(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    ReaderResult total = {};
+    for (const ReaderResult &r : results) {
+        total.snapshots += r.snapshots;
+        total.failed += r.failed;
+        total.torn += r.torn;
+        CHECK(r.snapshots > 0);
+    }
+    printf("%d reader threads against %.2f M updates/s: %.2f M snapshots/s each, "
+           "%llu failed, %llu torn\n",
+           READERS, updates / RUN_S / 1e6, total.snapshots / RUN_S / 1e6 / READERS,
+           (unsigned long long)total.failed, (unsigned long long)total.torn);
+    CHECK(total.torn == 0);
+
+    pub.Close();
+    return TestExit();
+}
@@ -0,0 +1,41 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+/*
+ * Minimal checks for the tests and benchmarks under tests/. A failed CHECK
+ * prints where and carries on; TestExit() turns the count into the exit
+ * status CTest looks at.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static int g_test_failures = 0;
+
+#define CHECK(cond)                                                                \
+    do {                                                                           \
+        if (!(cond)) {                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++;                                                     \
+        }                                                                          \
+    } while (0)
+
+static inline int TestExit()
+{
+    if (g_test_failures)
+        fprintf(stderr, "%d check(s) failed\n", g_test_failures);
+    return g_test_failures ? 1 : 0;
+}
+
+/* p in [0, 100]; sorts v. */
+static inline double Percentile(std::vector<double> &v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p / 100.0 * (double)(v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+#endif /* TEST_UTIL_H */
@@ -0,0 +1,155 @@
+/*
+ * The io_uring raw-GIP backend over socketpairs standing in for four
+ * controllers. LED frames must reach each peer in the 4-byte raw framing,
+ * packets split across reads or packed into one must be reassembled, and a
+ * peer hanging up must read as the controller leaving, and closing with
+ * reads in flight must reap every request first. Reports io_uring
+ * syscalls per LED update, for one controller and for a broadcast.
+ */
+#include "test_util.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "gip_protocol.h"
+#include "gip_transport.h"
+#include "xbox_led.h"
+}
+
+static const int DEVICES = 4;
+static const int UPDATES = 2000;
+
+static int g_peer[DEVICES];
+
+/* Everything the peer has been sent so far. */
+static std::vector<uint8_t> Drain(int fd)
+{
+    std::vector<uint8_t> out;
+    uint8_t buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        out.insert(out.end(), buf, buf + n);
+    return out;
+}
+
+static void Pump(XboxController *ctrl, int rounds)
+{
+    for (int i = 0; i < rounds; i++)
+        xbox_pump(ctrl, 5);
+}
+
+int main()
+{
+    int fds[DEVICES];
+    for (int i = 0; i < DEVICES; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+            perror("socketpair");
+            return 1;
+        }
+        fds[i] = sv[0];
+        g_peer[i] = sv[1];
+    }
+
+    GipTransport t = gip_transport_uring_create(fds, DEVICES);
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, t);
+    if (!xbox_open(&ctrl)) {
+        /* Containers often filter io_uring out. */
+        printf("io_uring unavailable: %s; skipped\n", ctrl.error);
+        xbox_cleanup(&ctrl);
+        return 77;
+    }
+    CHECK(xbox_device_count(&ctrl) == DEVICES);
+
+    /* LED frames in raw framing: command, flags, sequence, length, payload. */
+    XboxLedResult results[XBOX_MAX_DEVICES];
+    int n = xbox_set_led_many(&ctrl, nullptr, 0, LED_MODE_BLINK_FAST, 20, results);
+    CHECK(n == DEVICES);
+    for (int i = 0; i < n; i++)
+        CHECK(results[i].ok);
+    for (int i = 0; i < DEVICES; i++) {
+        std::vector<uint8_t> raw = Drain(g_peer[i]);
+        CHECK(raw.size() == 7);
+        if (raw.size() == 7) {
+            CHECK(raw[0] == GIP_CMD_LED);
+            CHECK(raw[3] == 3);
+            CHECK(raw[5] == LED_MODE_BLINK_FAST);
+            CHECK(raw[6] == 20);
+        }
+    }
+
+    /* Input split over two writes, then two packets in one. */
+    uint8_t input[4 + 14] = { GIP_CMD_INPUT, 0, 1, 14 };
+    uint64_t messages = ctrl.read_stats.messages;
+    CHECK(write(g_peer[0], input, 6) == 6);
+    Pump(&ctrl, 2);
+    CHECK(write(g_peer[0], input + 6, sizeof(input) - 6) == (ssize_t)sizeof(input) - 6);
+    Pump(&ctrl, 2);
+    CHECK(ctrl.read_stats.messages == messages + 1);
+    uint8_t two[2 * sizeof(input)];
+    memcpy(two, input, sizeof(input));
+    memcpy(two + sizeof(input), input, sizeof(input));
+    CHECK(write(g_peer[1], two, sizeof(two)) == (ssize_t)sizeof(two));
+    Pump(&ctrl, 2);
+    CHECK(ctrl.read_stats.messages == messages + 3);
+
+    /* Syscalls per update. */
+    GipUringStats s0, s1, s2;
+    gip_uring_stats(t, &s0);
+    uint64_t start = xbox_time_ns();
+    for (int i = 0; i < UPDATES; i++) {
+        CHECK(xbox_set_led(&ctrl, LED_MODE_ON, (uint8_t)(i % 2 ? 10 : 30)));
+        if (i % 64 == 63)
+            Drain(g_peer[0]);
+    }
+    double single_us = (xbox_time_ns() - start) / 1e3 / UPDATES;
+    gip_uring_stats(t, &s1);
+    for (int i = 0; i < UPDATES; i++) {
+        n = xbox_set_led_many(&ctrl, nullptr, 0, LED_MODE_ON, (uint8_t)(i % 2 ? 10 : 30), results);
+        CHECK(n == DEVICES);
+        if (i % 16 == 15) {
+            for (int k = 0; k < DEVICES; k++)
+                Drain(g_peer[k]);
+        }
+    }
+    gip_uring_stats(t, &s2);
+    double single = (double)(s1.syscalls - s0.syscalls) / (double)(s1.led_writes - s0.led_writes);
+    double broadcast = (double)(s2.syscalls - s1.syscalls) / (double)(s2.led_writes - s1.led_writes);
+    printf("syscalls per LED update: %.2f to one controller (%.1f us each), "
+           "%.2f in a broadcast to %d\n", single, single_us, broadcast, DEVICES);
+    CHECK(s1.led_writes - s0.led_writes == (uint64_t)UPDATES);
+    CHECK(s2.led_writes - s1.led_writes == (uint64_t)UPDATES * DEVICES);
+    /* Submit and wait share one io_uring_enter; a broadcast shares it
+       between controllers. */
+    CHECK(single <= 1.05);
+    CHECK(broadcast < single);
+
+    /* A controller unplugged: its descriptor hangs up. */
+    close(g_peer[3]);
+    g_peer[3] = -1;
+    unsigned events = 0;
+    for (int i = 0; i < 10 && !(events & XBOX_EVENT_LEFT); i++)
+        events |= xbox_pump(&ctrl, 5);
+    CHECK(events & XBOX_EVENT_LEFT);
+    CHECK(xbox_device_count(&ctrl) == DEVICES - 1);
+
+    /* Reads on the live sockets are still in flight at close. */
+    xbox_close(&ctrl);
+    GipUringStats closed;
+    gip_uring_stats(t, &closed);
+    CHECK(closed.cqes == closed.sqes);
+    CHECK(xbox_open(&ctrl));
+    CHECK(xbox_device_count(&ctrl) == DEVICES - 1);
+
+    xbox_cleanup(&ctrl);
+    for (int i = 0; i < DEVICES; i++) {
+        close(fds[i]);
+        if (g_peer[i] >= 0)
+            close(g_peer[i]);
+    }
+    return TestExit();
+}
@@ -0,0 +1,183 @@
+/*
+ * The xone backend against a fake /sys/class/leds in a temp directory:
+ * only gip* nodes are controllers, brightness is scaled to each node's
+ * max_brightness, a node without a mode attribute still takes brightness,
+ * a rescan drops removed nodes and picks up new ones, writes go to
+ * descriptors opened once, and a node removed between scans is reported
+ * unplugged. Ends with writes per second to one device.
+ */
+#include "test_util.h"
+
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include "gip_protocol.h"
+#include "gip_transport.h"
+#include "xbox_led.h"
+}
+
+static const int BENCH_WRITES = 20000;
+
+static std::string g_root;
+
+static void WriteFile(const std::string &path, const char *text)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    CHECK(f != nullptr);
+    if (f) {
+        fputs(text, f);
+        fclose(f);
+    }
+}
+
+/* The first line: a regular file is not truncated by pwrite, so a short
+   value leaves the tail of a longer one behind. */
+static std::string ReadFile(const std::string &node, const char *attr)
+{
+    char buf[32] = {};
+    FILE *f = fopen((g_root + "/" + node + "/" + attr).c_str(), "r");
+    if (!f)
+        return "";
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    std::string line = buf;
+    return line.substr(0, line.find('\n') + 1);
+}
+
+static void AddNode(const char *name, const char *max_brightness, bool mode)
+{
+    std::string dir = g_root + "/" + name;
+    mkdir(dir.c_str(), 0755);
+    WriteFile(dir + "/brightness", "0\n");
+    WriteFile(dir + "/max_brightness", max_brightness);
+    if (mode)
+        WriteFile(dir + "/mode", "0\n");
+}
+
+static void RemoveNode(const char *name)
+{
+    std::string dir = g_root + "/" + name;
+    for (const char *attr : { "brightness", "max_brightness", "mode" })
+        unlink((dir + "/" + attr).c_str());
+    rmdir(dir.c_str());
+}
+
+static bool Has(const XboxController *ctrl, uint64_t id)
+{
+    for (int i = 0; i < ctrl->device_count; i++) {
+        if (ctrl->devices[i].device_id == id && ctrl->devices[i].state == XBOX_DEV_PRESENT)
+            return true;
+    }
+    return false;
+}
+
+/* The present device whose LED lands on this node. */
+static uint64_t NodeDevice(XboxController *ctrl, const char *node)
+{
+    for (int i = 0; i < ctrl->device_count; i++) {
+        uint64_t id = ctrl->devices[i].device_id;
+        XboxLedResult r[XBOX_MAX_DEVICES];
+        xbox_set_led_many(ctrl, nullptr, 0, LED_MODE_OFF, 0, r);
+        if (xbox_select_device(ctrl, id) && xbox_set_led(ctrl, LED_MODE_ON, 1) &&
+            ReadFile(node, "brightness") != "0\n")
+            return id;
+    }
+    return 0;
+}
+
+int main()
+{
+    char tmpl[] = "/tmp/xbled-xone-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    g_root = tmpl;
+    AddNode("gip0:white:status", "255\n", true);
+    AddNode("gip1:white:status", "47\n", false);
+    AddNode("input3::capslock", "1\n", false);
+
+    XboxController ctrl;
+    xbox_init_with_transport(&ctrl, gip_transport_xone_create(g_root.c_str()));
+    CHECK(xbox_open(&ctrl));
+    CHECK(xbox_device_count(&ctrl) == 2);
+
+    XboxLedResult results[XBOX_MAX_DEVICES];
+    int n = xbox_set_led_many(&ctrl, nullptr, 0, LED_MODE_BLINK_SLOW, 30, results);
+    CHECK(n == 2);
+    for (int i = 0; i < n; i++)
+        CHECK(results[i].ok);
+    CHECK(ReadFile("gip0:white:status", "brightness") == "163\n");   /* 30 of 47 on 255 */
+    CHECK(ReadFile("gip0:white:status", "mode") == std::to_string(LED_MODE_BLINK_SLOW) + "\n");
+    CHECK(ReadFile("gip1:white:status", "brightness") == "30\n");
+    CHECK(ReadFile("input3::capslock", "brightness") == "0\n");
+
+    n = xbox_set_led_many(&ctrl, nullptr, 0, LED_MODE_OFF, 30, results);
+    CHECK(n == 2);
+    CHECK(ReadFile("gip0:white:status", "brightness") == "0\n");
+    CHECK(ReadFile("gip1:white:status", "brightness") == "0\n");
+
+    /* One controller unplugged, another plugged in. */
+    uint64_t gip0 = NodeDevice(&ctrl, "gip0:white:status");
+    uint64_t gip1 = NodeDevice(&ctrl, "gip1:white:status");
+    CHECK(gip0 && gip1 && gip0 != gip1);
+    RemoveNode("gip1:white:status");
+    AddNode("gip2:white:status", "47\n", true);
+    CHECK(xbox_rescan(&ctrl, 50));
+    CHECK(xbox_device_count(&ctrl) == 2);
+    CHECK(Has(&ctrl, gip0));
+    CHECK(!Has(&ctrl, gip1));
+    uint64_t gip2 = NodeDevice(&ctrl, "gip2:white:status");
+    CHECK(gip2 && gip2 != gip0);
+
+    CHECK(xbox_select_device(&ctrl, gip0));
+    uint64_t start = xbox_time_ns();
+    int failed = 0;
+    for (int i = 0; i < BENCH_WRITES; i++)
+        failed += !xbox_set_led(&ctrl, LED_MODE_ON, (uint8_t)(i % 2 ? 10 : 20));
+    double s = (xbox_time_ns() - start) / 1e9;
+    CHECK(failed == 0);
+    printf("%d LED writes to one device in %.1f ms: %.0f writes/s (%.2f us each)\n", BENCH_WRITES,
+           s * 1e3, BENCH_WRITES / s, s * 1e6 / BENCH_WRITES);
+
+    /* Both controllers per call. */
+    start = xbox_time_ns();
+    for (int i = 0; i < BENCH_WRITES / 2; i++) {
+        n = xbox_set_led_many(&ctrl, nullptr, 0, LED_MODE_ON, (uint8_t)(i % 2 ? 10 : 20), results);
+        for (int k = 0; k < n; k++)
+            failed += !results[k].ok;
+    }
+    double s2 = (xbox_time_ns() - start) / 1e9;
+    CHECK(failed == 0);
+    printf("%d broadcasts to 2 devices in %.1f ms: %.0f writes/s per device\n", BENCH_WRITES / 2,
+           s2 * 1e3, BENCH_WRITES / 2 / s2);
+
+    /* The descriptors are opened once per node, not per write: with the
+       file replaced underneath, writes still go to the old one. */
+    std::string path = g_root + "/gip0:white:status/brightness";
+    unlink(path.c_str());
+    WriteFile(path, "0\n");
+    CHECK(xbox_set_led(&ctrl, LED_MODE_ON, 47));
+    CHECK(ReadFile("gip0:white:status", "brightness") == "0\n");
+
+    /* Unplugged with the session open: the next reenumerate reports it. */
+    RemoveNode("gip2:white:status");
+    CHECK(ctrl.transport.ops->ioctl(ctrl.transport.self, GIP_REENUMERATE));
+    unsigned ev = 0;
+    for (int i = 0; i < 10 && Has(&ctrl, gip2); i++)
+        ev |= xbox_pump(&ctrl, 10);
+    CHECK(!Has(&ctrl, gip2));
+    CHECK(ev & XBOX_EVENT_LEFT);
+    CHECK(xbox_device_count(&ctrl) == 1);
+
+    xbox_cleanup(&ctrl);
+    RemoveNode("gip0:white:status");
+    RemoveNode("gip1:white:status");
+    RemoveNode("gip2:white:status");
+    RemoveNode("input3::capslock");
+    rmdir(g_root.c_str());
+    return TestExit();
+}